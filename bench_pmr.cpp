@@ -0,0 +1,98 @@
+#include "yalloc/yalloc.h"
+#include "yalloc/yalloc_pmr.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory_resource>
+#include <unordered_map>
+#include <vector>
+
+/*
+Compares standard containers on a yalloc pool with the default memory resource.
+
+Resources:
+
+ - new/delete: std::pmr::new_delete_resource() (the system allocator)
+ - yalloc: yalloc::pool_resource on a pool with the default policy
+ - yalloc+cache: std::pmr::unsynchronized_pool_resource on top of yalloc::pool_resource (caching blocks of up to 256 bytes)
+ - yalloc scratch: yalloc::scratch_resource (a monotonic buffer that returns its memory to the pool after every round)
+
+Workloads (every round starts with empty containers and ends with destroying them):
+
+ - vector: push_back of VECTOR_SIZE ints into a std::pmr::vector without reserving
+ - unordered_map: insert MAP_SIZE keys into a std::pmr::unordered_map, erase every second one and insert them again
+
+Reported is the time per container operation, averaged over all rounds.
+*/
+
+#define POOL_SIZE MAX_POOL_SIZE
+#define ROUNDS 2000
+#define VECTOR_SIZE 4096
+#define MAP_SIZE 512
+
+static std::uint32_t pool[POOL_SIZE / 4];
+
+static void vector_round(std::pmr::memory_resource * resource)
+{
+  std::pmr::vector<int> v(resource);
+  for (int i = 0; i < VECTOR_SIZE; ++i)
+    v.push_back(i);
+}
+
+static void map_round(std::pmr::memory_resource * resource)
+{
+  std::pmr::unordered_map<int, int> m(resource);
+  for (int i = 0; i < MAP_SIZE; ++i)
+    m.emplace(i, i);
+  for (int i = 0; i < MAP_SIZE; i += 2)
+    m.erase(i);
+  for (int i = 0; i < MAP_SIZE; i += 2)
+    m.emplace(i, i);
+}
+
+// runs the rounds of a workload with a fresh resource, returns ns per operation
+static double run(std::function<void(std::pmr::memory_resource*)> const & round, std::size_t opsPerRound, char const * resourceName)
+{
+  yalloc_init(pool, sizeof(pool));
+  std::chrono::steady_clock::duration elapsed{};
+  {
+    yalloc::pool_resource yallocResource(pool);
+    std::pmr::unsynchronized_pool_resource cache({16, 256}, &yallocResource); // small chunks, the pool is small
+    yalloc::scratch_resource scratch(pool);
+    std::pmr::memory_resource * resource = std::pmr::new_delete_resource();
+    if (!std::strcmp(resourceName, "yalloc"))
+      resource = &yallocResource;
+    else if (!std::strcmp(resourceName, "yalloc+cache"))
+      resource = &cache;
+    else if (!std::strcmp(resourceName, "yalloc scratch"))
+      resource = &scratch;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < ROUNDS; ++r)
+    {
+      round(resource);
+      scratch.release();
+    }
+    elapsed = std::chrono::steady_clock::now() - start;
+  }
+  yalloc_deinit(pool);
+  return std::chrono::duration<double, std::nano>(elapsed).count() / ((double)ROUNDS * opsPerRound);
+}
+
+int main()
+{
+  char const * resources[] = {"new/delete", "yalloc", "yalloc+cache", "yalloc scratch"};
+
+  std::printf("%-16s %14s %14s\n", "resource", "vector ns/op", "map ns/op");
+  for (char const * name : resources)
+  {
+    double vectorNs = run(vector_round, VECTOR_SIZE, name);
+    double mapNs = run(map_round, MAP_SIZE * 2, name);
+    std::printf("%-16s %14.2f %14.2f\n", name, vectorNs, mapNs);
+  }
+  return 0;
+}
@@ -0,0 +1,483 @@
+#include "yalloc/yalloc.h"
+#include "yalloc/yalloc_mt.h"
+#include "yalloc/yalloc_striped.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/*
+Compares the ways to share yalloc between threads on 1..N threads.
+
+ - symmetric: Every thread has its own slots. In each step a pseudorandom slot
+   is picked: If it holds an allocation that is freed, otherwise a new block is
+   allocated for it. Blocks never change the thread.
+ - producer/consumer: The threads form a ring. In each step a thread allocates
+   a block and passes it to the next thread (through a single-producer
+   single-consumer queue), which frees it. So every block is freed by another
+   thread (by the same one if there is only one).
+
+The sizes are 4 to 64 bytes, every 16th allocation is 65 to 256 bytes.
+
+Reported per allocator, workload and number of threads:
+
+ - Mops/s: allocations and deallocations of all threads per microsecond
+ - p99 ns: 99th percentile of the time of a single yalloc_alloc()/yalloc_free()
+   (every 16th operation is timed)
+ - pool used: bytes of the pool that are not free at the end of the run, while
+   the blocks of the workload are still allocated (includes blocks that are
+   cached by threads and the prefixes of the thread-safe front-end, n/a for
+   the system allocator)
+ - fails: allocations that failed because the pool was full
+
+Usage: bench-threads [-t maxThreads] [-n stepsPerThread]
+*/
+
+#define SLOTS 128
+#define RING_SIZE 64
+#define SAMPLE_INTERVAL 16
+#define MAX_THREADS YALLOC_MT_MAX_THREADS
+
+typedef struct
+{
+  char const * name;
+  int (*init)(void);
+  void (*deinit)(void);
+  void * (*thread_init)(void); // returns the state of the calling thread
+  void (*thread_deinit)(void * state);
+  void * (*alloc)(void * state, size_t size);
+  void (*free)(void * state, void * p);
+  size_t (*used)(void); // bytes of the pool that are in use, SIZE_MAX if unknown
+} Allocator;
+
+static uint32_t poolMemory[MAX_POOL_SIZE / 4];
+
+// ---- one pool behind a mutex ----
+
+static pthread_mutex_t poolLock = PTHREAD_MUTEX_INITIALIZER;
+
+static int locked_init(void)
+{
+  return yalloc_init(poolMemory, sizeof(poolMemory));
+}
+
+static void locked_deinit(void)
+{
+  yalloc_deinit(poolMemory);
+}
+
+static void * no_thread_init(void)
+{
+  return NULL;
+}
+
+static void no_thread_deinit(void * state)
+{
+  (void)state;
+}
+
+static void * locked_alloc(void * state, size_t size)
+{
+  (void)state;
+  pthread_mutex_lock(&poolLock);
+  void * p = yalloc_alloc(poolMemory, size);
+  pthread_mutex_unlock(&poolLock);
+  return p;
+}
+
+static void locked_free(void * state, void * p)
+{
+  (void)state;
+  pthread_mutex_lock(&poolLock);
+  yalloc_free(poolMemory, p);
+  pthread_mutex_unlock(&poolLock);
+}
+
+static size_t locked_used(void)
+{
+  return sizeof(poolMemory) - yalloc_count_free(poolMemory);
+}
+
+// ---- thread-safe front-end (yalloc_mt.h) ----
+
+static YallocMt mt;
+
+static int mt_init(void)
+{
+  return yalloc_init(poolMemory, sizeof(poolMemory)) || yalloc_mt_init(&mt, poolMemory);
+}
+
+static void mt_deinit(void)
+{
+  yalloc_mt_deinit(&mt);
+  yalloc_deinit(poolMemory);
+}
+
+static void * mt_thread_init(void)
+{
+  YallocMtThread * thread = malloc(sizeof(YallocMtThread));
+  if (yalloc_mt_thread_init(&mt, thread))
+    abort();
+  return thread;
+}
+
+static void mt_thread_deinit(void * state)
+{
+  yalloc_mt_thread_deinit(state);
+  free(state);
+}
+
+static void * mt_alloc(void * state, size_t size)
+{
+  return yalloc_mt_alloc(state, size);
+}
+
+static void mt_free(void * state, void * p)
+{
+  yalloc_mt_free(state, p);
+}
+
+static size_t mt_used(void)
+{
+  return sizeof(poolMemory) - yalloc_mt_count_free(&mt);
+}
+
+// ---- striped pool (yalloc_striped.h) with the same memory ----
+
+static YallocStriped striped;
+
+static int striped_init(void)
+{
+  return yalloc_striped_init(&striped, poolMemory, sizeof(poolMemory), 8, 0);
+}
+
+static void striped_deinit(void)
+{
+  yalloc_striped_deinit(&striped);
+}
+
+static void * striped_alloc(void * state, size_t size)
+{
+  (void)state;
+  return yalloc_striped_alloc(&striped, size);
+}
+
+static void striped_free(void * state, void * p)
+{
+  (void)state;
+  yalloc_striped_free(&striped, p);
+}
+
+static size_t striped_used(void)
+{
+  return striped.numStripes * striped.stripeSize - yalloc_striped_count_free(&striped);
+}
+
+// ---- system allocator ----
+
+static int system_init(void)
+{
+  return 0;
+}
+
+static void system_deinit(void)
+{
+}
+
+static void * system_alloc(void * state, size_t size)
+{
+  (void)state;
+  return malloc(size);
+}
+
+static void system_free(void * state, void * p)
+{
+  (void)state;
+  free(p);
+}
+
+static size_t system_used(void)
+{
+  return SIZE_MAX;
+}
+
+static Allocator const allocators[] =
+{
+  {"mutex + pool", locked_init, locked_deinit, no_thread_init, no_thread_deinit, locked_alloc, locked_free, locked_used},
+  {"yalloc_mt", mt_init, mt_deinit, mt_thread_init, mt_thread_deinit, mt_alloc, mt_free, mt_used},
+  {"yalloc_striped", striped_init, striped_deinit, no_thread_init, no_thread_deinit, striped_alloc, striped_free, striped_used},
+  {"system malloc", system_init, system_deinit, no_thread_init, no_thread_deinit, system_alloc, system_free, system_used},
+};
+
+// ---- workloads ----
+
+typedef struct
+{
+  void * slots[RING_SIZE];
+  _Atomic unsigned head; // written by the consumer
+  _Atomic unsigned tail; // written by the producer
+} Ring;
+
+typedef struct
+{
+  Allocator const * allocator;
+  int producerConsumer;
+  int numThreads;
+  long steps;
+  pthread_barrier_t barrier;
+  atomic_int doneProducing; // number of threads that produced all of their blocks
+  Ring rings[MAX_THREADS];
+} Run;
+
+typedef struct
+{
+  Run * run;
+  int index;
+  uint32_t rngState;
+  uint32_t * samples; // timed operations in ns
+  size_t numSamples;
+  long ops;
+  long fails;
+  double start; // time of the first step
+  double end; // time after the last step
+  void * slots[SLOTS];
+} Worker;
+
+static uint32_t rng(Worker * w)
+{
+  // xorshift32
+  w->rngState ^= w->rngState << 13;
+  w->rngState ^= w->rngState >> 17;
+  w->rngState ^= w->rngState << 5;
+  return w->rngState;
+}
+
+static double now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static size_t random_size(Worker * w)
+{
+  uint32_t r = rng(w);
+  return r % 16 ? 4 + r / 16 % 61 : 65 + r / 16 % 192;
+}
+
+static void * timed_alloc(Worker * w, void * state, size_t size)
+{
+  void * p;
+  if (w->ops++ % SAMPLE_INTERVAL)
+    p = w->run->allocator->alloc(state, size);
+  else
+  {
+    double start = now();
+    p = w->run->allocator->alloc(state, size);
+    w->samples[w->numSamples++] = (uint32_t)(now() - start);
+  }
+
+  if (!p)
+    ++w->fails;
+  return p;
+}
+
+static void timed_free(Worker * w, void * state, void * p)
+{
+  if (w->ops++ % SAMPLE_INTERVAL)
+    w->run->allocator->free(state, p);
+  else
+  {
+    double start = now();
+    w->run->allocator->free(state, p);
+    w->samples[w->numSamples++] = (uint32_t)(now() - start);
+  }
+}
+
+// frees what the previous thread produced (keeping a few blocks, so the pool holds something at the end), returns the number of freed blocks
+static int consume(Worker * w, void * state, Ring * in)
+{
+  int n = 0;
+  unsigned head = atomic_load_explicit(&in->head, memory_order_relaxed);
+  while (atomic_load_explicit(&in->tail, memory_order_acquire) - head > RING_SIZE / 2)
+  {
+    timed_free(w, state, in->slots[head % RING_SIZE]);
+    atomic_store_explicit(&in->head, ++head, memory_order_release);
+    ++n;
+  }
+  return n;
+}
+
+static void * worker(void * arg)
+{
+  Worker * w = arg;
+  Run * run = w->run;
+  void * state = run->allocator->thread_init();
+  Ring * in = &run->rings[w->index];
+  Ring * out = &run->rings[(w->index + 1) % run->numThreads];
+  pthread_barrier_wait(&run->barrier);
+  w->start = now();
+
+  for (long step = 0; step < run->steps; ++step)
+  {
+    if (!run->producerConsumer)
+    {
+      void ** slot = &w->slots[rng(w) % SLOTS];
+      if (*slot)
+      {
+        timed_free(w, state, *slot);
+        *slot = NULL;
+      }
+      else
+        *slot = timed_alloc(w, state, random_size(w));
+      continue;
+    }
+
+    // produce one block (consuming while the next thread has no room for it)
+    unsigned tail = atomic_load_explicit(&out->tail, memory_order_relaxed);
+    while (tail - atomic_load_explicit(&out->head, memory_order_acquire) == RING_SIZE)
+    {
+      if (!consume(w, state, in))
+        sched_yield();
+    }
+
+    void * p = timed_alloc(w, state, random_size(w));
+    if (p)
+    {
+      out->slots[tail % RING_SIZE] = p;
+      atomic_store_explicit(&out->tail, tail + 1, memory_order_release);
+    }
+    consume(w, state, in);
+  }
+
+  if (run->producerConsumer)
+  { // the previous thread may still wait for room
+    atomic_fetch_add(&run->doneProducing, 1);
+    while (atomic_load(&run->doneProducing) < run->numThreads)
+    {
+      if (!consume(w, state, in))
+        sched_yield();
+    }
+  }
+
+  // the main thread measures the memory in use between these barriers
+  w->end = now();
+  pthread_barrier_wait(&run->barrier);
+  pthread_barrier_wait(&run->barrier);
+
+  for (int i = 0; i < SLOTS; ++i)
+    run->allocator->free(state, w->slots[i]);
+  for (unsigned head = atomic_load(&in->head); head != atomic_load(&in->tail); ++head)
+    run->allocator->free(state, in->slots[head % RING_SIZE]);
+
+  run->allocator->thread_deinit(state);
+  return NULL;
+}
+
+static int compare_samples(void const * a, void const * b)
+{
+  uint32_t x = *(uint32_t const *)a;
+  uint32_t y = *(uint32_t const *)b;
+  return x < y ? -1 : x > y;
+}
+
+static Run theRun;
+
+static void run(Allocator const * allocator, int producerConsumer, int numThreads, long steps)
+{
+  Run * run = &theRun;
+  memset(run, 0, sizeof(*run));
+  run->allocator = allocator;
+  run->producerConsumer = producerConsumer;
+  run->numThreads = numThreads;
+  run->steps = steps;
+  pthread_barrier_init(&run->barrier, NULL, numThreads + 1);
+  if (allocator->init())
+  {
+    printf("can not initialize %s\n", allocator->name);
+    exit(1);
+  }
+
+  size_t samplesPerThread = (size_t)steps * 2 / SAMPLE_INTERVAL + RING_SIZE; // every step allocates once and frees once on average
+  uint32_t * samples = malloc(samplesPerThread * numThreads * sizeof(uint32_t));
+  Worker * workers = calloc(numThreads, sizeof(Worker));
+  pthread_t threads[MAX_THREADS];
+  for (int i = 0; i < numThreads; ++i)
+  {
+    workers[i].run = run;
+    workers[i].index = i;
+    workers[i].rngState = 0x12345678u + i;
+    workers[i].samples = samples + samplesPerThread * i;
+    pthread_create(&threads[i], NULL, worker, &workers[i]);
+  }
+
+  pthread_barrier_wait(&run->barrier);
+  pthread_barrier_wait(&run->barrier);
+  size_t used = allocator->used();
+  pthread_barrier_wait(&run->barrier);
+  for (int i = 0; i < numThreads; ++i)
+    pthread_join(threads[i], NULL);
+
+  // gather the samples of all threads at the front
+  long ops = 0;
+  long fails = 0;
+  size_t numSamples = 0;
+  double start = workers[0].start;
+  double end = workers[0].end;
+  for (int i = 0; i < numThreads; ++i)
+  {
+    start = workers[i].start < start ? workers[i].start : start;
+    end = workers[i].end > end ? workers[i].end : end;
+    memmove(samples + numSamples, workers[i].samples, workers[i].numSamples * sizeof(uint32_t));
+    numSamples += workers[i].numSamples;
+    ops += workers[i].ops;
+    fails += workers[i].fails;
+  }
+  qsort(samples, numSamples, sizeof(uint32_t), compare_samples);
+
+  char usedText[32] = "n/a";
+  if (used != SIZE_MAX)
+    snprintf(usedText, sizeof(usedText), "%zu", used);
+  printf("%-18s %-18s %7d %8.2f %8u %10s %8ld\n", producerConsumer ? "producer/consumer" : "symmetric", allocator->name, numThreads,
+         ops / (end - start) * 1e3, numSamples ? samples[numSamples * 99 / 100] : 0, usedText, fails);
+
+  allocator->deinit();
+  pthread_barrier_destroy(&run->barrier);
+  free(workers);
+  free(samples);
+}
+
+int main(int argc, char ** argv)
+{
+  int maxThreads = 8;
+  long steps = 200000;
+  for (int i = 1; i + 1 < argc; i += 2)
+  {
+    if (!strcmp(argv[i], "-t"))
+      maxThreads = atoi(argv[i + 1]);
+    else if (!strcmp(argv[i], "-n"))
+      steps = atol(argv[i + 1]);
+  }
+
+  if (maxThreads < 1 || maxThreads > MAX_THREADS || steps < 1)
+  {
+    printf("usage: %s [-t maxThreads (1 to %d)] [-n stepsPerThread]\n", argv[0], MAX_THREADS);
+    return 1;
+  }
+
+  printf("%-18s %-18s %7s %8s %8s %10s %8s\n", "workload", "allocator", "threads", "Mops/s", "p99 ns", "pool used", "fails");
+  for (int producerConsumer = 0; producerConsumer < 2; ++producerConsumer)
+  {
+    for (int threads = 1; threads <= maxThreads; threads *= 2)
+    {
+      for (size_t a = 0; a < sizeof(allocators) / sizeof(allocators[0]); ++a)
+        run(&allocators[a], producerConsumer, threads, steps);
+    }
+  }
+  return 0;
+}
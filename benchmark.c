@@ -0,0 +1,286 @@
+#include "yalloc/yalloc.h"
+#include "yalloc/yalloc_internals.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef __linux__
+# include <linux/perf_event.h>
+# include <sys/ioctl.h>
+# include <sys/syscall.h>
+# include <unistd.h>
+#endif
+
+#ifndef YALLOC_WORK_COUNTERS
+#error "The benchmark must be compiled with YALLOC_WORK_COUNTERS defined"
+#endif
+
+/*
+Compares the allocation policies of yalloc on synthetic workloads.
+
+Every workload is a fixed set of slots. In each step a pseudorandom slot is
+picked: If it holds an allocation that is freed (with the probability of its
+lifetime class), otherwise a new block is allocated for it. FIFO workloads
+instead visit the slots round robin and replace the allocation of the slot
+(the oldest one) with a new one, like a message queue does. When an allocation
+fails the pool is defragmented and the allocation is retried.
+
+Reported per policy and workload:
+
+ - ns/op: average time of yalloc_alloc()/yalloc_free() (excluding defragmentation)
+ - visits/alloc: free-list nodes (bitmap words for the bitmap engine) visited per allocation (see YALLOC_WORK_COUNTERS)
+ - sim miss/op: misses per operation of a simulated 32k direct mapped cache that
+   sees every metadata access of yalloc_alloc()/yalloc_free() (see
+   YALLOC_WORK_COUNTERS), which shows how many cache lines the metadata is
+   spread over
+ - L1 miss/op: L1 data cache read misses per operation of the whole benchmark
+   loop measured by the CPU (only on Linux when perf events are available,
+   otherwise n/a)
+ - defrags: how often the pool had to be defragmented because an allocation failed
+ - frag: 1 - (largest free block / all free space), averaged over the run
+*/
+
+#define POOL_SIZE 65536
+#define STEPS 2000000
+#define SAMPLE_INTERVAL 1000
+
+typedef struct
+{
+  char const * name;
+  unsigned flags;
+  int hints; // allocate long-lived blocks with YALLOC_LONG_LIVED (only run for workloads that have them)
+} Policy;
+
+typedef struct
+{
+  char const * name;
+  int numSlots;
+  int longLivedPercent; // percentage of slots that hold long-lived blocks
+  int minSize;
+  int maxSize;
+  int longLivedMinSize;
+  int longLivedMaxSize;
+  int fifo; // replace the oldest allocation in every step
+} Workload;
+
+static Policy const policies[] =
+{
+  {"LIFO first fit", 0, 0},
+  {"address ordered", YALLOC_ADDRESS_ORDERED, 0},
+  {"next fit", YALLOC_NEXT_FIT, 0},
+  {"next fit ordered", YALLOC_NEXT_FIT | YALLOC_ADDRESS_ORDERED, 0},
+  {"best fit", YALLOC_BEST_FIT, 0},
+  {"adaptive", YALLOC_ADAPTIVE, 0},
+  {"LIFO + hints", 0, 1},
+  {"ordered + hints", YALLOC_ADDRESS_ORDERED, 1},
+  {"bitmap", YALLOC_BITMAP, 0},
+  {"bitmap out of band", YALLOC_BITMAP | YALLOC_OUT_OF_BAND, 0},
+};
+
+static Workload const workloads[] =
+{
+  {"uniform 4..256", 700, 0, 4, 256, 0, 0, 0},
+  {"small 4..32", 3000, 0, 4, 32, 0, 0, 0},
+  {"mixed lifetimes", 1000, 10, 4, 64, 64, 256, 0},
+  {"fifo 4..256", 350, 0, 4, 256, 0, 0, 1},
+};
+
+static uint32_t pool[POOL_SIZE / 4];
+
+static uint32_t rngState;
+
+static uint32_t rng()
+{
+  // xorshift32
+  rngState ^= rngState << 13;
+  rngState ^= rngState >> 17;
+  rngState ^= rngState << 5;
+  return rngState;
+}
+
+static double now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// opens a counter for the L1 data cache read misses of this thread, returns -1 if that is not available
+static int open_miss_counter()
+{
+#ifdef __linux__
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.type = PERF_TYPE_HW_CACHE;
+  attr.size = sizeof(attr);
+  attr.config = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+  attr.disabled = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  int fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+  if (fd >= 0)
+  {
+    ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+    ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+  }
+  return fd;
+#else
+  return -1;
+#endif
+}
+
+// returns the misses counted by a counter of open_miss_counter() and closes it
+static uint64_t close_miss_counter(int fd)
+{
+  uint64_t misses = 0;
+#ifdef __linux__
+  ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+  if (read(fd, &misses, sizeof(misses)) != sizeof(misses))
+    misses = 0;
+  close(fd);
+#else
+  (void)fd;
+#endif
+  return misses;
+}
+
+// 1 - (largest free block / all free space)
+static double fragmentation(void * pool_)
+{
+  Control * ctrl = getControl(pool_);
+  Header * pool = getRoot(pool_, ctrl);
+  size_t total = 0;
+  size_t largest = 0;
+  if (ctrl && (ctrl->flags & YALLOC_BITMAP))
+  { // runs of free granules
+    uint32_t * bitmap = getBitmap(ctrl);
+    size_t run = 0;
+    for (size_t i = 0; i <= ctrl->numGranules; ++i)
+    {
+      if (i < ctrl->numGranules && !(bitmap[i / 32] >> (i % 32) & 1))
+      {
+        ++run;
+        continue;
+      }
+
+      total += run * 4;
+      if (run * 4 > largest)
+        largest = run * 4;
+      run = 0;
+    }
+    return total ? 1.0 - (double)largest / total : 0.0;
+  }
+
+  for (Header * cur = pool; !isNil(cur->next); cur = HDR_PTR(cur->next))
+  {
+    if (isFree(cur))
+    {
+      size_t size = (char*)HDR_PTR(cur->next) - (char*)cur;
+      total += size;
+      if (size > largest)
+        largest = size;
+    }
+  }
+  return total ? 1.0 - (double)largest / total : 0.0;
+}
+
+static void run(Policy const * policy, Workload const * w)
+{
+  if (policy->hints && !w->longLivedPercent)
+    return;
+
+  void ** slots = (void**)calloc(w->numSlots, sizeof(void*));
+  if (yalloc_init_ex(pool, sizeof(pool), policy->flags))
+  {
+    printf("can not initialize pool\n");
+    exit(1);
+  }
+
+  rngState = 12345;
+  memset(&yalloc_work, 0, sizeof(yalloc_work));
+
+  double ns = 0;
+  size_t ops = 0;
+  size_t allocs = 0;
+  size_t defrags = 0;
+  size_t freeListVisits = 0;
+  double fragSum = 0;
+  size_t fragSamples = 0;
+  int missCounter = open_miss_counter();
+
+  for (int step = 0; step < STEPS; ++step)
+  {
+    int i = w->fifo ? step % w->numSlots : (int)(rng() % w->numSlots);
+    int longLived = i * 100 < w->numSlots * w->longLivedPercent;
+    int wasUsed = slots[i] != NULL;
+    if (wasUsed)
+    {
+      if (longLived && rng() % 50)
+        continue; // long-lived blocks survive most of the times they are picked
+
+      double t0 = now();
+      yalloc_free(pool, slots[i]);
+      ns += now() - t0;
+      ++ops;
+      slots[i] = NULL;
+    }
+
+    if (!wasUsed || w->fifo)
+    {
+      int minSize = longLived ? w->longLivedMinSize : w->minSize;
+      int maxSize = longLived ? w->longLivedMaxSize : w->maxSize;
+      size_t size = minSize + rng() % (maxSize - minSize + 1);
+      unsigned hint = policy->hints && longLived ? YALLOC_LONG_LIVED : YALLOC_SHORT_LIVED;
+
+      size_t visits = yalloc_work.freeListVisits;
+      double t0 = now();
+      void * p = yalloc_alloc_hint(pool, size, hint);
+      ns += now() - t0;
+      ++ops;
+      ++allocs;
+      freeListVisits += yalloc_work.freeListVisits - visits;
+
+      if (!p)
+      {
+        ++defrags;
+        yalloc_defrag_start(pool);
+        for (int j = 0; j < w->numSlots; ++j)
+          slots[j] = yalloc_defrag_address(pool, slots[j]);
+        yalloc_defrag_commit(pool);
+        p = yalloc_alloc_hint(pool, size, hint); // may still fail when the pool is simply full
+      }
+
+      slots[i] = p;
+    }
+
+    if (step % SAMPLE_INTERVAL == 0)
+    {
+      fragSum += fragmentation(pool);
+      ++fragSamples;
+    }
+  }
+
+  char hwMisses[16] = "n/a";
+  if (missCounter >= 0)
+    snprintf(hwMisses, sizeof(hwMisses), "%.2f", (double)close_miss_counter(missCounter) / ops);
+
+  printf("%-18s %-18s %8.1f %14.2f %12.2f %11s %8zu %8.3f\n", w->name, policy->name, ns / ops, (double)freeListVisits / allocs,
+         (double)yalloc_work.cacheMisses / ops, hwMisses, defrags, fragSum / fragSamples);
+
+  yalloc_deinit(pool);
+  free(slots);
+}
+
+int main()
+{
+  printf("%-18s %-18s %8s %14s %12s %11s %8s %8s\n", "workload", "policy", "ns/op", "visits/alloc", "sim miss/op", "L1 miss/op", "defrags", "frag");
+  for (size_t w = 0; w < sizeof(workloads) / sizeof(workloads[0]); ++w)
+  {
+    for (size_t p = 0; p < sizeof(policies) / sizeof(policies[0]); ++p)
+      run(&policies[p], &workloads[w]);
+  }
+  return 0;
+}
@@ -0,0 +1,11 @@
+#! /usr/bin/sh
+
+# This script compares standard containers on a yalloc pool with the default memory resource (see bench_pmr.cpp).
+
+set -e
+
+gcc -O2 -DNDEBUG -c yalloc/yalloc.c -o yalloc-bench-pmr.o
+g++ -std=c++17 -O2 -DNDEBUG bench_pmr.cpp yalloc-bench-pmr.o -o bench-pmr-binary
+./bench-pmr-binary
+
+echo "All fine!"
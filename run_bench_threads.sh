@@ -0,0 +1,10 @@
+#! /usr/bin/sh
+
+# This script compares the ways to share a pool between threads on 1..N threads (see bench_threads.c).
+
+set -e
+
+gcc -O2 -DNDEBUG bench_threads.c yalloc/yalloc.c yalloc/yalloc_mt.c yalloc/yalloc_striped.c -lpthread -o bench-threads-binary
+./bench-threads-binary "$@"
+
+echo "All fine!"
@@ -0,0 +1,10 @@
+#! /usr/bin/sh
+
+# This script compares the allocation policies of yalloc on synthetic workloads (see benchmark.c).
+
+set -e
+
+gcc -O2 -DNDEBUG -DYALLOC_WORK_COUNTERS benchmark.c yalloc/yalloc.c -o bench-binary
+./bench-binary
+
+echo "All fine!"
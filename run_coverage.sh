@@ -5,7 +5,7 @@
 
 set -e
 
-clang test_coverage.c yalloc/yalloc.c -fprofile-instr-generate -g -fcoverage-mapping -o test-binary
+clang test_coverage.c yalloc/yalloc.c yalloc/yalloc_trace.c yalloc/yalloc_slab.c yalloc/yalloc_arena.c yalloc/yalloc_containers.c yalloc/yalloc_mt.c yalloc/yalloc_striped.c yalloc/yalloc_persist.c yalloc/yalloc_shm.c -lpthread -fprofile-instr-generate -g -fcoverage-mapping -o test-binary
 ./test-binary
 
 llvm-profdata merge -sparse *.profraw -o default.profdata
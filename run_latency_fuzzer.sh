@@ -0,0 +1,17 @@
+#! /usr/bin/sh
+
+# This script uses libfuzzer to search for inputs that maximize the work of single yalloc operations for 60 seconds (adjust -max_total_time).
+# Every new worst case is written to corpus_latency_worst/, the file name contains the metric and its cost.
+# Those files are rechecked at the end, they can be kept as latency regression tests.
+
+set -e
+
+mkdir -p corpus_latency corpus_latency_worst
+
+clang test_latency_fuzzer.c yalloc/yalloc.c -DUSE_LIBFUZZER -DYALLOC_WORK_COUNTERS -DNDEBUG -g -O1 -fsanitize=fuzzer -o test-binary
+
+# Larger inputs than for run_libfuzzer.sh because long sequences are needed to build up bad fragmentation.
+./test-binary corpus_latency/ -max_total_time=60 -timeout=10 -jobs=8 -max_len=4096 -use_value_profile=1
+
+clang test_latency_fuzzer.c yalloc/yalloc.c -DYALLOC_WORK_COUNTERS -g -O1 -o test-binary
+./test-binary -check corpus_latency_worst/*
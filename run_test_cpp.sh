@@ -0,0 +1,9 @@
+#! /usr/bin/sh
+
+# This script tests the C++ headers of yalloc (see test_cpp.cpp).
+
+set -e
+
+gcc -g -O0 -c yalloc/yalloc.c -o yalloc-test-cpp.o
+g++ -std=c++17 -g -O0 -Wall -Wextra test_cpp.cpp yalloc-test-cpp.o -o test-cpp-binary
+./test-cpp-binary
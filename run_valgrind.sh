@@ -10,11 +10,11 @@ gcc -g -O2 test_valgrind.c yalloc/yalloc.c -DYALLOC_VALGRIND -o test-binary
 valgrind --log-fd=-1 ./test-binary
 
 echo "Testing covarge with valgrind integration (unoptimized)"
-gcc -g -O0 test_coverage.c yalloc/yalloc.c -DYALLOC_VALGRIND -o test-binary
+gcc -g -O0 test_coverage.c yalloc/yalloc.c yalloc/yalloc_trace.c yalloc/yalloc_slab.c yalloc/yalloc_arena.c yalloc/yalloc_containers.c yalloc/yalloc_mt.c yalloc/yalloc_striped.c yalloc/yalloc_persist.c yalloc/yalloc_shm.c -lpthread -DYALLOC_VALGRIND -o test-binary
 valgrind ./test-binary
 
 echo "Testing covarge with valgrind integration (optimized)"
-gcc -g -O2 test_coverage.c yalloc/yalloc.c -DYALLOC_VALGRIND -o test-binary
+gcc -g -O2 test_coverage.c yalloc/yalloc.c yalloc/yalloc_trace.c yalloc/yalloc_slab.c yalloc/yalloc_arena.c yalloc/yalloc_containers.c yalloc/yalloc_mt.c yalloc/yalloc_striped.c yalloc/yalloc_persist.c yalloc/yalloc_shm.c -lpthread -DYALLOC_VALGRIND -o test-binary
 valgrind ./test-binary
 
 echo "Testing with valgrind integration and random testcases (unoptimized)"
@@ -5,6 +5,22 @@
 #include <assert.h>
 
 #include "test_util.h"
+#include "yalloc/yalloc_internals.h"
+#include "yalloc/yalloc_trace.h"
+#include "yalloc/yalloc_slab.h"
+#include "yalloc/yalloc_arena.h"
+#include "yalloc/yalloc_containers.h"
+#include "yalloc/yalloc_mt.h"
+#include "yalloc/yalloc_striped.h"
+#include "yalloc/yalloc_persist.h"
+#include "yalloc/yalloc_shm.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
 
 // carefully crafted test sequence that covers all paths of the allocation function
@@ -19,6 +35,7 @@ static void test_alloc_coverage()
   assert(!yalloc_init(pool, MAX_POOL_SIZE)); // maximum pool size
 
   assert(!checked_alloc(pool, 0)); // allocating zero bytes should return NULL
+  assert(!checked_alloc(pool, (size_t)-1)); // rounding the size up would overflow
   checked_free(pool, NULL); // freeing NULL should be ignored
 
   {
@@ -392,6 +409,2141 @@ void test_defragmentation()
   yalloc_deinit(pool);
 }
 
+void test_offsets()
+{
+  static uint32_t pool[MAX_POOL_SIZE / 4];
+  unsigned const flags[] = {0, YALLOC_ADDRESS_ORDERED | YALLOC_TAGGED, YALLOC_BITMAP | YALLOC_OUT_OF_BAND};
+  for (size_t f = 0; f < sizeof(flags) / sizeof(flags[0]); ++f)
+  {
+    assert(!yalloc_init_ex(pool, sizeof(pool), flags[f]));
+    assert(yalloc_ptr_to_off(pool, NULL) == YALLOC_NULL_OFFSET);
+    assert(!yalloc_off_to_ptr(pool, YALLOC_NULL_OFFSET));
+
+    // the first allocation (even without a header in front of it) and the last word of the pool have offsets
+    uint32_t * a = checked_alloc(pool, 8);
+    assert(yalloc_ptr_to_off(pool, a) != YALLOC_NULL_OFFSET);
+    assert(yalloc_off_to_ptr(pool, yalloc_ptr_to_off(pool, a)) == a);
+    assert(yalloc_off_to_ptr(pool, yalloc_ptr_to_off(pool, a + 1)) == a + 1); // addresses inside of allocations too
+    YallocOffset last = yalloc_ptr_to_off(pool, pool + MAX_POOL_SIZE / 4 - 1);
+    assert(last == MAX_POOL_SIZE / 4 - 1);
+
+    uint32_t * b = checked_alloc(pool, 40);
+    uint32_t * c = checked_alloc(pool, 12);
+    YallocOffset offsets[] = {yalloc_ptr_to_off(pool, b), yalloc_ptr_to_off(pool, c), YALLOC_NULL_OFFSET};
+    checked_free(pool, a);
+    yalloc_defrag_start(pool);
+    for (int i = 0; i < 3; ++i)
+    {
+      void * p = yalloc_off_to_ptr(pool, offsets[i]);
+      offsets[i] = yalloc_defrag_offset(pool, offsets[i]);
+      assert(yalloc_off_to_ptr(pool, offsets[i]) == (p ? yalloc_defrag_address(pool, p) : NULL));
+    }
+    yalloc_defrag_commit(pool);
+    assert(offsets[2] == YALLOC_NULL_OFFSET);
+    assert(offsets[0] < yalloc_ptr_to_off(pool, b)); // b moved to the front
+    checked_free(pool, yalloc_off_to_ptr(pool, offsets[0]));
+    checked_free(pool, yalloc_off_to_ptr(pool, offsets[1]));
+    yalloc_deinit(pool);
+  }
+}
+
+void test_address_ordered()
+{
+  uint32_t pool[MAX_POOL_SIZE / 4];
+
+  assert(yalloc_init_ex(pool, sizeof(pool), 0x8000)); // unknown flag
+  assert(yalloc_init_ex(pool, 16, YALLOC_ADDRESS_ORDERED)); // no space for the control block
+  assert(!yalloc_init_ex(pool, 256, 0)); // no flags is a plain pool
+  assert(yalloc_count_free(pool) == 256 - 8);
+  yalloc_deinit(pool);
+
+  for (int addressOrdered = 0; addressOrdered < 2; ++addressOrdered)
+  {
+    assert(!yalloc_init_ex(pool, 256, addressOrdered ? YALLOC_ADDRESS_ORDERED : 0));
+
+    void * p[5];
+    for (int i = 0; i < 5; ++i)
+      p[i] = checked_alloc(pool, 8);
+
+    checked_free(pool, p[1]);
+    checked_free(pool, p[3]);
+
+    // LIFO reuses the most recently freed block, address order the lowest one
+    void * x = checked_alloc(pool, 8);
+    assert(x == (addressOrdered ? p[1] : p[3]));
+    checked_free(pool, x);
+
+    for (int i = 0; i < 5; i += 2)
+      checked_free(pool, p[i]);
+
+    assert(yalloc_count_free(pool) == 256 - 8 - (addressOrdered ? sizeof(Control) + 3 * 2 + 2 : 0)); // three 128 byte address ranges (padded)
+    yalloc_deinit(pool);
+  }
+
+  { // many blocks spread over all address ranges of a big pool
+    assert(!yalloc_init_ex(pool, sizeof(pool), YALLOC_ADDRESS_ORDERED));
+    void * first = yalloc_first_used(pool);
+    assert(!first);
+
+    enum { N = 64 };
+    void * p[N];
+    size_t size = (yalloc_count_free(pool) / N - 4) / 4 * 4;
+    for (int i = 0; i < N; ++i)
+    {
+      p[i] = checked_alloc(pool, size);
+      assert(p[i]);
+      assert(i == 0 || p[i] > p[i - 1]);
+    }
+
+    // free in an order that inserts in front of, between and behind existing free blocks of other ranges
+    int order[] = {40, 10, 50, 5, 30, 20, 60, 62, 0, 2, 4, 33, 35, 34};
+    for (size_t i = 0; i < sizeof(order) / sizeof(order[0]); ++i)
+    {
+      checked_free(pool, p[order[i]]);
+      p[order[i]] = NULL;
+    }
+
+    // first fit now takes the lowest free block
+    void * x = checked_alloc(pool, size);
+    assert(x == (char*)pool + sizeof(Control) + 256 * 2 + 4); // 256 address ranges of 512 bytes
+    checked_free(pool, x);
+
+    // small allocations split the lowest free block
+    void * y = checked_alloc(pool, 4);
+    void * z = checked_alloc(pool, 4);
+    assert(y == x && (char*)z == (char*)y + 8);
+    checked_free(pool, y);
+    checked_free(pool, z);
+
+    yalloc_defrag_start(pool);
+    for (int i = 0; i < N; ++i)
+      p[i] = yalloc_defrag_address(pool, p[i]);
+    yalloc_defrag_commit(pool);
+
+    for (int i = 0; i < N; ++i)
+      checked_free(pool, p[i]);
+
+    // defragmenting an empty pool
+    yalloc_defrag_start(pool);
+    yalloc_defrag_commit(pool);
+    void * all = checked_alloc(pool, yalloc_count_free(pool));
+    assert(all);
+    checked_free(pool, all);
+    yalloc_deinit(pool);
+  }
+
+  { // isolated frees find their position through the address ranges, the others through their free neighbours
+    void * p[2048 / 12];
+    assert(!yalloc_init_ex(pool, 2048, YALLOC_ADDRESS_ORDERED));
+    size_t freeBytes = yalloc_count_free(pool);
+    int n = 0;
+    while ((p[n] = checked_alloc(pool, 8)))
+      ++n;
+
+    srand(1);
+    for (int pass = 0; pass < 2; ++pass)
+    { // first every other block (in random order), then the ones between them
+      for (int i = pass; i < n; i += 2)
+      {
+        int j = pass + rand() % ((n - pass + 1) / 2) * 2;
+        void * t = p[i];
+        p[i] = p[j];
+        p[j] = t;
+      }
+      for (int i = pass; i < n; i += 2)
+        checked_free(pool, p[i]);
+    }
+
+    assert(yalloc_count_free(pool) == freeBytes);
+    yalloc_deinit(pool);
+  }
+}
+
+void test_next_fit()
+{
+  uint32_t pool[64];
+  unsigned const variants[] = {YALLOC_NEXT_FIT, YALLOC_NEXT_FIT | YALLOC_ADDRESS_ORDERED};
+  for (size_t v = 0; v < sizeof(variants) / sizeof(variants[0]); ++v)
+  {
+    assert(!yalloc_init_ex(pool, sizeof(pool), variants[v]));
+    size_t freeBytes = yalloc_count_free(pool);
+
+    { // the search resumes behind the previous allocation instead of taking the first block that fits
+      void * a = checked_alloc(pool, 8);
+      void * b = checked_alloc(pool, 8);
+      checked_free(pool, a);
+      void * c = checked_alloc(pool, 8);
+      assert(c == (char*)b + 12);
+      checked_free(pool, b);
+      checked_free(pool, c);
+      assert(yalloc_count_free(pool) == freeBytes);
+    }
+
+    void * a = checked_alloc(pool, 64);
+    void * b = checked_alloc(pool, 8);
+    void * c = checked_alloc(pool, yalloc_count_free(pool) - 16); // leaves a 16 byte free block behind c
+    checked_free(pool, a);
+
+    // the block behind c is too small, so the search wraps around to the front of the free list
+    void * x = checked_alloc(pool, 32);
+    assert(x == a);
+    assert(!yalloc_alloc(pool, 100)); // nothing fits: the search stops where it started
+
+    checked_free(pool, x); // joins the block where the next search would start
+    void * y = checked_alloc(pool, 64);
+    assert(y == a);
+
+    checked_free(pool, y);
+    checked_free(pool, b);
+    checked_free(pool, c);
+    assert(yalloc_count_free(pool) == freeBytes);
+    yalloc_deinit(pool);
+  }
+}
+
+void test_alloc_hint()
+{
+  uint32_t pool[64];
+  for (int addressOrdered = 0; addressOrdered < 2; ++addressOrdered)
+  {
+    assert(!yalloc_init_ex(pool, sizeof(pool), addressOrdered ? YALLOC_ADDRESS_ORDERED : 0));
+    char * root = (char*)pool + (addressOrdered ? sizeof(Control) + 3 * 2 + 2 : 0);
+    char * top = (char*)pool + sizeof(pool) - 4;
+    size_t freeBytes = yalloc_count_free(pool);
+
+    // long-lived blocks are carved from the top of a free block, short-lived ones from the bottom
+    void * a = checked_alloc_hint(pool, 8, YALLOC_LONG_LIVED);
+    assert(a == top - 8);
+    void * b = checked_alloc_hint(pool, 8, YALLOC_SHORT_LIVED);
+    assert(b == root + 4);
+    void * c = checked_alloc_hint(pool, 6, YALLOC_LONG_LIVED);
+    assert(c == (char*)a - 12);
+
+    void * s[3];
+    for (int i = 0; i < 3; ++i)
+      s[i] = checked_alloc_hint(pool, 8, YALLOC_SHORT_LIVED);
+
+    // free blocks that can not be split are used completely
+    void * d = checked_alloc_hint(pool, yalloc_count_free(pool) - 4, YALLOC_LONG_LIVED); // leaves 4 bytes which become padding
+    assert(d == (char*)s[2] + 12);
+
+    // long-lived blocks use the highest free block that fits
+    checked_free(pool, s[1]);
+    checked_free(pool, b);
+    assert(!checked_alloc_hint(pool, 12, YALLOC_LONG_LIVED)); // nothing fits
+    void * e = checked_alloc_hint(pool, 8, YALLOC_LONG_LIVED); // fits exactly
+    assert(e == s[1]);
+    s[1] = NULL;
+
+    // freeing joins the free space again
+    checked_free(pool, d);
+    checked_free(pool, c);
+    checked_free(pool, a);
+    checked_free(pool, e);
+    for (int i = 0; i < 3; ++i)
+      checked_free(pool, s[i]);
+    assert(yalloc_count_free(pool) == freeBytes);
+    yalloc_deinit(pool);
+  }
+}
+
+void test_adaptive()
+{
+  uint32_t pool[1024];
+  assert(yalloc_init_ex(pool, sizeof(pool), YALLOC_NEXT_FIT | YALLOC_BEST_FIT)); // contradicting policies
+
+  assert(!yalloc_init(pool, 256)); // plain pools always use first fit
+  assert(yalloc_policy(pool) == YALLOC_POLICY_FIRST_FIT);
+  assert(!yalloc_policy_switches(pool));
+  assert(!yalloc_defrag_suggested(pool));
+  yalloc_deinit(pool);
+
+  { // best fit takes the smallest block that fits
+    assert(!yalloc_init_ex(pool, 256, YALLOC_BEST_FIT));
+    assert(yalloc_policy(pool) == YALLOC_POLICY_BEST_FIT);
+    size_t sizes[] = {32, 4, 8, 4, 16, 4};
+    void * p[6];
+    for (int i = 0; i < 6; ++i)
+      p[i] = checked_alloc(pool, sizes[i]);
+    for (int i = 0; i < 6; i += 2)
+      checked_free(pool, p[i]);
+
+    void * x = checked_alloc(pool, 8); // fits exactly
+    assert(x == p[2]);
+    void * y = checked_alloc(pool, 12);
+    assert(y == p[4]);
+    void * z = checked_alloc(pool, 40); // only the free space behind the blocks fits
+    assert(z == (char*)p[5] + 8);
+
+    checked_free(pool, x);
+    checked_free(pool, y);
+    checked_free(pool, z);
+    for (int i = 1; i < 6; i += 2)
+      checked_free(pool, p[i]);
+    assert(!yalloc_policy_switches(pool)); // not adaptive
+    yalloc_deinit(pool);
+  }
+
+  assert(!yalloc_init_ex(pool, sizeof(pool), YALLOC_ADAPTIVE));
+  assert(yalloc_policy(pool) == YALLOC_POLICY_FIRST_FIT);
+
+  { // long searches switch to next fit, which is kept as long as the free space is not fragmented
+    void * p[20];
+    for (int i = 0; i < 20; ++i)
+      p[i] = checked_alloc(pool, 8);
+    for (int i = 0; i < 20; i += 2)
+      checked_free(pool, p[i]); // small free blocks at the front of the free list
+
+    // the first window also contains the allocations above, the second one only long searches
+    void * q[3 * ADAPT_WINDOW];
+    for (int i = 0; i < 2 * ADAPT_WINDOW; ++i)
+      q[i] = checked_alloc(pool, 16);
+    assert(yalloc_policy(pool) == YALLOC_POLICY_NEXT_FIT);
+    assert(yalloc_policy_switches(pool) == 1);
+    assert(!yalloc_defrag_suggested(pool));
+
+    for (int i = 2 * ADAPT_WINDOW; i < 3 * ADAPT_WINDOW; ++i)
+      q[i] = checked_alloc(pool, 4);
+    assert(yalloc_policy(pool) == YALLOC_POLICY_NEXT_FIT);
+
+    for (int i = 1; i < 20; i += 2)
+      checked_free(pool, p[i]);
+    for (int i = 0; i < 3 * ADAPT_WINDOW; ++i)
+      checked_free(pool, q[i]);
+  }
+
+  { // fragmented free space switches to best fit and suggests defragmentation
+    enum { N = sizeof(pool) / 12 };
+    void * p[N];
+    int n = 0;
+    // the smaller blocks fill the end of the pool (an 8 byte block would get 4 bytes padding when 16 bytes are left)
+    while ((p[n] = checked_alloc(pool, yalloc_count_free(pool) == 12 ? 4 : 8)) || (p[n] = checked_alloc(pool, 4)))
+      ++n;
+    for (int i = 0; i < n; i += 2)
+    {
+      checked_free(pool, p[i]);
+      p[i] = NULL;
+    }
+
+    for (int i = 0; i < ADAPT_WINDOW; ++i)
+      assert(!yalloc_alloc(pool, 12)); // there is enough free space, but no free block is big enough
+    assert(yalloc_policy(pool) == YALLOC_POLICY_BEST_FIT);
+    assert(yalloc_policy_switches(pool) == 2);
+    assert(yalloc_defrag_suggested(pool));
+
+    yalloc_defrag_start(pool);
+    for (int i = 0; i < n; ++i)
+      p[i] = yalloc_defrag_address(pool, p[i]);
+    yalloc_defrag_commit(pool);
+    assert(!yalloc_defrag_suggested(pool));
+
+    // without fragmentation and with short searches first fit is used again
+    void * q[ADAPT_WINDOW];
+    for (int i = 0; i < ADAPT_WINDOW; ++i)
+      q[i] = checked_alloc(pool, 4);
+    assert(yalloc_policy(pool) == YALLOC_POLICY_FIRST_FIT);
+    assert(yalloc_policy_switches(pool) == 3);
+
+    for (int i = 0; i < ADAPT_WINDOW; ++i)
+      checked_free(pool, q[i]);
+    for (int i = 0; i < n; ++i)
+      checked_free(pool, p[i]);
+  }
+
+  assert(yalloc_count_free(pool) == sizeof(pool) - sizeof(Control) - 8);
+  yalloc_deinit(pool);
+}
+
+void test_slab_limit()
+{
+  // the biggest objects
+  static uint32_t pool[MAX_POOL_SIZE / 4];
+  void * slabs[1];
+  YallocSlabCache cache;
+  assert(!yalloc_init(pool, sizeof(pool)));
+  size_t freeBytes = yalloc_count_free(pool);
+  assert(!yalloc_slab_init(&cache, pool, 0xFFFC, 1, slabs, 1));
+  assert(cache.objectSize == 0xFFFC);
+  void * p = yalloc_slab_alloc(&cache);
+  assert(p);
+  memset(p, 1, 0xFFFC);
+  assert(!yalloc_slab_alloc(&cache));
+  assert(yalloc_count_free(pool) < freeBytes - 0xFFFC);
+  yalloc_slab_free(&cache, p);
+  yalloc_slab_deinit(&cache);
+  assert(yalloc_count_free(pool) == freeBytes);
+  yalloc_deinit(pool);
+}
+
+void test_slab()
+{
+  uint32_t pool[1024];
+  void * slabs[4];
+  YallocSlabCache cache;
+  assert(!yalloc_init(pool, sizeof(pool)));
+  size_t freeBytes = yalloc_count_free(pool);
+
+  assert(yalloc_slab_init(&cache, pool, 0, 16, slabs, 4)); // objects need a size
+  assert(yalloc_slab_init(&cache, pool, 4, 0, slabs, 4)); // slabs need objects
+  assert(yalloc_slab_init(&cache, pool, 4, 0xFFFF, slabs, 4)); // too many objects per slab
+  assert(yalloc_slab_init(&cache, pool, 4, 16, slabs, 0x10000)); // too many slabs
+  assert(yalloc_slab_init(&cache, pool, MAX_POOL_SIZE, 1, slabs, 4)); // slabs do not fit into a pool
+  assert(yalloc_slab_init(&cache, pool, 0xFFFD, 1, slabs, 4)); // the rounded size does not fit into 16 bits
+  assert(yalloc_slab_init(&cache, pool, 70000, 1, slabs, 4));
+  assert(!yalloc_slab_init(&cache, pool, 3, 16, slabs, 4));
+  assert(cache.objectSize == 4);
+
+  // objects are packed without headers
+  enum { N = 40 };
+  uint32_t * p[N];
+  for (int i = 0; i < N; ++i)
+  {
+    p[i] = (uint32_t*)yalloc_slab_alloc(&cache);
+    assert(p[i]);
+    *p[i] = i;
+  }
+  assert(cache.numSlabs == 3 && cache.numUsed == N);
+  assert(p[1] == p[0] + 1 && p[15] == p[0] + 15);
+  assert(yalloc_count_free(pool) == freeBytes - 3 * (4 + 12 + 16 * 4));
+
+  // freed objects are reused
+  yalloc_slab_free(&cache, p[5]);
+  yalloc_slab_free(&cache, p[7]);
+  yalloc_slab_free(&cache, NULL);
+  assert(yalloc_slab_alloc(&cache) == p[7]);
+  assert(yalloc_slab_alloc(&cache) == p[5]);
+
+  // a slab that gets empty is returned to the pool, unless it is the only one with free objects
+  for (int i = 16; i < 32; ++i)
+  {
+    yalloc_slab_free(&cache, p[i]);
+    p[i] = NULL;
+  }
+  assert(cache.numSlabs == 2);
+  for (int i = 32; i < N; ++i)
+  {
+    yalloc_slab_free(&cache, p[i]);
+    p[i] = NULL;
+  }
+  assert(cache.numSlabs == 2); // the last slab stays for the next allocations
+  for (int i = 16; i < N; ++i)
+  {
+    p[i] = (uint32_t*)yalloc_slab_alloc(&cache);
+    *p[i] = i;
+  }
+  assert(cache.numSlabs == 3);
+
+  // slabs are limited by the pool and by the slab array
+  void * big = yalloc_alloc(pool, yalloc_count_free(pool) - 50);
+  uint32_t * q[N];
+  int n = 0;
+  while ((q[n] = (uint32_t*)yalloc_slab_alloc(&cache)))
+    ++n;
+  assert(n == 8 && cache.numSlabs == 3); // the rest of the last slab
+  yalloc_free(pool, big);
+  while ((q[n] = (uint32_t*)yalloc_slab_alloc(&cache)))
+    ++n;
+  assert(n == 8 + 16 && cache.numSlabs == 4);
+  for (int i = 0; i < n; ++i)
+    yalloc_slab_free(&cache, q[i]);
+  assert(cache.numSlabs == 3);
+
+  { // slabs are moved as a whole by defragmentation
+    for (int i = 0; i < 16; ++i)
+    {
+      yalloc_slab_free(&cache, p[i]); // the first slab is returned to the pool
+      p[i] = NULL;
+    }
+    assert(cache.numSlabs == 2);
+    yalloc_slab_free(&cache, p[17]); // both slabs have free objects now
+    p[17] = NULL;
+
+    uint32_t * moved[N];
+    yalloc_defrag_start(pool);
+    for (int i = 0; i < N; ++i)
+      moved[i] = (uint32_t*)yalloc_slab_defrag_address(&cache, p[i]);
+    yalloc_slab_defrag(&cache);
+    yalloc_defrag_commit(pool);
+
+    assert(moved[16] < p[16]);
+    for (int i = 16; i < N; ++i)
+      assert(!moved[i] || *moved[i] == (uint32_t)i);
+
+    // the list of slabs with free objects is intact (the slab at the end of the list is emptied first)
+    for (int i = 0; i < N; ++i)
+      yalloc_slab_free(&cache, moved[i]);
+    for (int i = 0; i < N; ++i)
+      assert((p[i] = (uint32_t*)yalloc_slab_alloc(&cache)));
+  }
+
+  yalloc_slab_deinit(&cache);
+  assert(!cache.numSlabs);
+  assert(yalloc_count_free(pool) == freeBytes);
+  yalloc_deinit(pool);
+}
+
+void test_arena()
+{
+  uint32_t pool[256];
+  assert(!yalloc_init(pool, sizeof(pool)));
+  size_t freeBytes = yalloc_count_free(pool);
+
+  YallocArena arena;
+  assert(yalloc_arena_init(&arena, pool, sizeof(pool))); // the region does not fit into the pool
+  yalloc_arena_deinit(&arena); // nothing to free
+
+  void * x = checked_alloc(pool, 16); // a block in front of the region, which leaves a gap for defragmentation
+  assert(!yalloc_arena_init(&arena, pool, 101));
+  assert(arena.size == 104);
+  assert(yalloc_count_free(pool) == freeBytes - 20 - 108);
+
+  // allocations are packed without headers
+  char * a = (char*)yalloc_arena_alloc(&arena, 5);
+  char * b = (char*)yalloc_arena_alloc(&arena, 4);
+  assert(a == arena.region);
+  assert(b == a + 8);
+  assert(!yalloc_arena_alloc(&arena, 0));
+  memset(a, 0xAA, 8);
+  memset(b, 0xBB, 4);
+
+  size_t mark = yalloc_arena_mark(&arena);
+  char * c = (char*)yalloc_arena_alloc(&arena, 80);
+  assert(c == b + 4);
+  assert(!yalloc_arena_alloc(&arena, 16)); // exhausted
+  assert(yalloc_arena_alloc(&arena, 12));
+  yalloc_arena_release(&arena, mark);
+  assert(yalloc_arena_alloc(&arena, 4) == c); // everything behind the mark was released
+
+  // the region moves as a whole during defragmentation
+  checked_free(pool, x);
+  yalloc_defrag_start(pool);
+  assert(!yalloc_arena_defrag_address(&arena, NULL));
+  a = (char*)yalloc_arena_defrag_address(&arena, a);
+  b = (char*)yalloc_arena_defrag_address(&arena, b);
+  yalloc_arena_defrag(&arena);
+  yalloc_defrag_commit(pool);
+  assert(a == arena.region);
+  assert(a == (char*)x);
+  assert(b == a + 8);
+  assert(a[0] == (char)0xAA && a[7] == (char)0xAA && b[0] == (char)0xBB);
+
+  yalloc_arena_release(&arena, 0);
+  assert(yalloc_arena_alloc(&arena, 4) == a);
+  yalloc_arena_deinit(&arena);
+  assert(yalloc_count_free(pool) == freeBytes);
+  yalloc_deinit(pool);
+}
+
+// used blocks and free space of a pool, to compare the state of a pool before and after a rollback
+typedef struct
+{
+  size_t numUsed;
+  void * used[512];
+  size_t sizes[512];
+  size_t freeBytes;
+} PoolState;
+
+static void get_pool_state(void * pool, PoolState * state)
+{
+  state->numUsed = 0;
+  for (void * p = yalloc_first_used(pool); p; p = yalloc_next_used(pool, p))
+  {
+    assert(state->numUsed < 512);
+    state->used[state->numUsed] = p;
+    state->sizes[state->numUsed++] = yalloc_block_size(pool, p);
+  }
+  state->freeBytes = yalloc_count_free(pool);
+}
+
+static void assert_pool_state(void * pool, PoolState * expected)
+{
+  PoolState state;
+  get_pool_state(pool, &state);
+  assert(state.numUsed == expected->numUsed);
+  assert(!memcmp(state.used, expected->used, state.numUsed * sizeof(void*)));
+  assert(!memcmp(state.sizes, expected->sizes, state.numUsed * sizeof(size_t)));
+  assert(state.freeBytes == expected->freeBytes);
+}
+
+// allocates and frees random blocks, live holds up to 32 allocations (NULL for unused entries)
+static void random_steps(void * pool, void ** live, int numSteps)
+{
+  for (int i = 0; i < numSteps; ++i)
+  {
+    void ** x = &live[rand() % 32];
+    if (*x)
+    {
+      yalloc_free(pool, *x);
+      *x = NULL;
+    }
+    else
+      *x = yalloc_alloc_hint(pool, 1 + rand() % 300, rand() % 4 ? YALLOC_SHORT_LIVED : YALLOC_LONG_LIVED);
+  }
+}
+
+void test_checkpoint()
+{
+  uint32_t pool[10000];
+  assert(yalloc_init_ex(pool, sizeof(pool), YALLOC_BITMAP | YALLOC_UNDO_LOG(64))); // the bitmap engine has no undo log
+  assert(yalloc_init_ex(pool, sizeof(pool), YALLOC_UNDO_LOG(8129))); // too many entries
+  assert(yalloc_init_ex(pool, sizeof(Control) + 384 + 8, YALLOC_UNDO_LOG(64))); // no space left for blocks
+
+  assert(!yalloc_init(pool, sizeof(pool)));
+  assert(!yalloc_checkpoint(pool)); // plain pools have no undo log
+  yalloc_deinit(pool);
+
+  unsigned variants[] = {0, YALLOC_ADDRESS_ORDERED, YALLOC_NEXT_FIT, YALLOC_ADDRESS_ORDERED | YALLOC_BEST_FIT, YALLOC_ADAPTIVE | YALLOC_NEXT_FIT};
+  for (size_t v = 0; v < sizeof(variants) / sizeof(variants[0]); ++v)
+  {
+    srand(v);
+    assert(!yalloc_init_ex(pool, sizeof(pool), variants[v] | YALLOC_UNDO_LOG(4096)));
+    void * live[32] = {NULL};
+    random_steps(pool, live, 100);
+
+    // a block that is neither freed nor reallocated keeps its content
+    void * kept = yalloc_alloc(pool, 16);
+    memset(kept, 0x5A, 16);
+
+    PoolState atFirst;
+    get_pool_state(pool, &atFirst);
+    void * liveAtFirst[32];
+    memcpy(liveAtFirst, live, sizeof(live));
+    size_t first = yalloc_checkpoint(pool);
+    assert(first);
+    random_steps(pool, live, 100);
+
+    // nested checkpoint
+    PoolState atSecond;
+    get_pool_state(pool, &atSecond);
+    void * liveAtSecond[32];
+    memcpy(liveAtSecond, live, sizeof(live));
+    size_t second = yalloc_checkpoint(pool);
+    random_steps(pool, live, 100);
+    assert(!yalloc_rollback(pool, second));
+    assert_pool_state(pool, &atSecond);
+
+    // the checkpoints stay valid and the allocations of the checkpoint can be freed again
+    memcpy(live, liveAtSecond, sizeof(live));
+    random_steps(pool, live, 50);
+    assert(!yalloc_rollback(pool, second));
+    assert_pool_state(pool, &atSecond);
+    memcpy(live, liveAtSecond, sizeof(live));
+    random_steps(pool, live, 50);
+    assert(!yalloc_rollback(pool, first));
+    assert_pool_state(pool, &atFirst);
+    for (int i = 0; i < 16; ++i)
+      assert(((unsigned char*)kept)[i] == 0x5A);
+
+    yalloc_checkpoint_release(pool, second);
+    yalloc_checkpoint_release(pool, first);
+
+    // nothing is recorded without checkpoints, so the log does not overflow
+    memcpy(live, liveAtFirst, sizeof(live));
+    random_steps(pool, live, 2000);
+    first = yalloc_checkpoint(pool);
+    assert(first == 1);
+
+    // a reset frees everything and releases all checkpoints
+    yalloc_reset(pool);
+    assert(!yalloc_first_used(pool));
+    assert(yalloc_count_free(pool) == sizeof(pool) - sizeof(Control) - 4096 * sizeof(UndoEntry) - (variants[v] & YALLOC_ADDRESS_ORDERED ? 157 * 2 + 2 : 0) - 8); // 157 address ranges of 256 bytes
+    assert(yalloc_checkpoint(pool) == 1);
+    yalloc_checkpoint_release(pool, 1);
+    yalloc_deinit(pool);
+  }
+
+  // an overflow of the log invalidates the checkpoints until the last one is released
+  assert(!yalloc_init_ex(pool, sizeof(pool), YALLOC_ADDRESS_ORDERED | YALLOC_UNDO_LOG(1)));
+  size_t cp = yalloc_checkpoint(pool);
+  for (int i = 0; i < 16; ++i)
+    assert(yalloc_alloc(pool, 4));
+  assert(yalloc_rollback(pool, cp));
+  size_t nested = yalloc_checkpoint(pool);
+  assert(yalloc_rollback(pool, nested));
+  yalloc_checkpoint_release(pool, nested);
+  yalloc_checkpoint_release(pool, cp);
+  PoolState before;
+  get_pool_state(pool, &before);
+  cp = yalloc_checkpoint(pool);
+  void * x = yalloc_alloc(pool, 4);
+  yalloc_free(pool, x);
+  assert(!yalloc_rollback(pool, cp));
+  assert_pool_state(pool, &before);
+
+  // defragmentation invalidates the checkpoints
+  yalloc_free(pool, before.used[3]);
+  yalloc_defrag_start(pool);
+  yalloc_defrag_commit(pool);
+  assert(yalloc_rollback(pool, cp));
+  yalloc_checkpoint_release(pool, cp);
+  yalloc_deinit(pool);
+
+  // resetting the other kinds of pools
+  unsigned resetVariants[] = {0, YALLOC_BITMAP, YALLOC_BITMAP | YALLOC_OUT_OF_BAND};
+  for (size_t v = 0; v < sizeof(resetVariants) / sizeof(resetVariants[0]); ++v)
+  {
+    assert(!yalloc_init_ex(pool, 1000, resetVariants[v]));
+    size_t freeBytes = yalloc_count_free(pool);
+    assert(yalloc_alloc(pool, 100));
+    assert(yalloc_alloc(pool, 200));
+    yalloc_reset(pool);
+    assert(!yalloc_first_used(pool));
+    assert(yalloc_count_free(pool) == freeBytes);
+    yalloc_deinit(pool);
+  }
+}
+
+void test_tags()
+{
+  uint32_t pool[1024];
+  assert(yalloc_init_ex(pool, sizeof(pool), YALLOC_BITMAP | YALLOC_TAGGED)); // the bitmap engine has no tags
+
+  // plain pools ignore tags
+  assert(!yalloc_init(pool, sizeof(pool)));
+  void * x = checked_alloc(pool, 8);
+  checked_free(pool, x);
+  x = yalloc_alloc_tagged(pool, 8, 3);
+  assert(!yalloc_tag_of(pool, x));
+  assert(!yalloc_tag_bytes(pool, 3) && !yalloc_tag_blocks(pool, 3));
+  yalloc_free(pool, x);
+  yalloc_deinit(pool);
+
+  for (int addressOrdered = 0; addressOrdered < 2; ++addressOrdered)
+  {
+    assert(!yalloc_init_ex(pool, sizeof(pool), YALLOC_TAGGED | (addressOrdered ? YALLOC_ADDRESS_ORDERED : 0)));
+    size_t freeBytes = yalloc_count_free(pool);
+    assert(freeBytes == sizeof(pool) - sizeof(Control) - (addressOrdered ? 33 * 2 + 2 : 0) - YALLOC_NUM_TAGS * sizeof(TagStats) - sizeof(pool) / 16 - 4 - 8);
+
+    void * a = checked_alloc(pool, 8); // tag 0
+    void * b = yalloc_alloc_tagged(pool, 13, 1);
+    void * c = yalloc_alloc_tagged(pool, 4, 2);
+    void * d = yalloc_alloc_tagged(pool, 20, 1);
+    assert(yalloc_tag_of(pool, a) == 0 && yalloc_tag_of(pool, b) == 1 && yalloc_tag_of(pool, c) == 2 && yalloc_tag_of(pool, d) == 1);
+    assert(yalloc_tag_bytes(pool, 0) == 8 && yalloc_tag_blocks(pool, 0) == 1);
+    assert(yalloc_tag_bytes(pool, 1) == 16 + 20 && yalloc_tag_blocks(pool, 1) == 2);
+    assert(yalloc_tag_bytes(pool, 2) == 4 && yalloc_tag_blocks(pool, 2) == 1);
+
+    // a padded block counts with its usable size
+    yalloc_free(pool, b);
+    void * e = yalloc_alloc_tagged(pool, 12, 3);
+    assert(e == b);
+    assert(yalloc_block_size(pool, e) == 12);
+    assert(yalloc_tag_bytes(pool, 1) == 20 && yalloc_tag_blocks(pool, 1) == 1);
+    assert(yalloc_tag_bytes(pool, 3) == 12 && yalloc_tag_blocks(pool, 3) == 1);
+
+    // quotas
+    yalloc_set_tag_quota(pool, 2, 20);
+    assert(!yalloc_alloc_tagged(pool, 20, 2)); // 4 bytes are already used
+    void * f = yalloc_alloc_tagged(pool, 16, 2);
+    assert(f);
+    assert(!yalloc_alloc_tagged(pool, 1, 2));
+    assert(yalloc_alloc_hint(pool, 100, YALLOC_LONG_LIVED)); // other tags are not limited
+    assert(yalloc_tag_bytes(pool, 0) == 108);
+
+    // the tags move with the blocks
+    yalloc_free(pool, a);
+    yalloc_defrag_start(pool);
+    c = yalloc_defrag_address(pool, c);
+    d = yalloc_defrag_address(pool, d);
+    e = yalloc_defrag_address(pool, e);
+    f = yalloc_defrag_address(pool, f);
+    yalloc_defrag_commit(pool);
+    assert(yalloc_tag_of(pool, c) == 2 && yalloc_tag_of(pool, d) == 1 && yalloc_tag_of(pool, e) == 3 && yalloc_tag_of(pool, f) == 2);
+    assert(yalloc_tag_bytes(pool, 0) == 100 && yalloc_tag_blocks(pool, 0) == 1);
+
+    // the quotas survive a reset
+    yalloc_reset(pool);
+    assert(yalloc_count_free(pool) == freeBytes);
+    for (unsigned i = 0; i < YALLOC_NUM_TAGS; ++i)
+      assert(!yalloc_tag_bytes(pool, i) && !yalloc_tag_blocks(pool, i));
+    assert(!yalloc_alloc_tagged(pool, 24, 2));
+    yalloc_set_tag_quota(pool, 2, 0);
+    assert(yalloc_alloc_tagged(pool, 24, 2));
+    yalloc_deinit(pool);
+  }
+
+  // the statistics are rolled back
+  assert(!yalloc_init_ex(pool, sizeof(pool), YALLOC_TAGGED | YALLOC_UNDO_LOG(64)));
+  x = yalloc_alloc_tagged(pool, 8, 4);
+  size_t cp = yalloc_checkpoint(pool);
+  yalloc_free(pool, x);
+  assert(yalloc_alloc_tagged(pool, 4, 5));
+  assert(yalloc_alloc_tagged(pool, 12, 4));
+  assert(!yalloc_rollback(pool, cp));
+  assert(yalloc_tag_of(pool, x) == 4);
+  assert(yalloc_tag_bytes(pool, 4) == 8 && yalloc_tag_blocks(pool, 4) == 1);
+  assert(!yalloc_tag_bytes(pool, 5) && !yalloc_tag_blocks(pool, 5));
+  yalloc_checkpoint_release(pool, cp);
+  yalloc_deinit(pool);
+}
+
+// allocates the same random blocks with random tags in two pools, so freeing them in different ways can be compared
+static size_t alloc_tagged_blocks(void * a, void * b, void ** inA, void ** inB, unsigned * tags, size_t max)
+{
+  size_t n = 0;
+  for (size_t i = 0; i < max; ++i)
+  {
+    size_t size = 1 + rand() % 64;
+    unsigned hint = rand() % 4 ? YALLOC_SHORT_LIVED : YALLOC_LONG_LIVED;
+    unsigned tag = rand() % 4;
+    inA[n] = tag ? yalloc_alloc_tagged(a, size, tag) : yalloc_alloc_hint(a, size, hint);
+    inB[n] = tag ? yalloc_alloc_tagged(b, size, tag) : yalloc_alloc_hint(b, size, hint);
+    assert(!inA[n] == !inB[n]);
+    tags[n] = tag;
+    if (!inA[n])
+      break;
+
+    if (n && rand() % 3 == 0)
+    { // free a random block, so there are free blocks between the tagged ones
+      size_t j = rand() % n;
+      yalloc_free(a, inA[j]);
+      yalloc_free(b, inB[j]);
+      inA[j] = inA[n];
+      inB[j] = inB[n];
+      tags[j] = tags[n];
+    }
+    else
+      ++n;
+  }
+  return n;
+}
+
+void test_free_all()
+{
+  static uint32_t a[4096];
+  static uint32_t b[4096];
+  void * inA[512];
+  void * inB[512];
+  unsigned tags[512];
+
+  unsigned variants[] = {0, YALLOC_TAGGED, YALLOC_TAGGED | YALLOC_ADDRESS_ORDERED, YALLOC_TAGGED | YALLOC_NEXT_FIT, YALLOC_TAGGED | YALLOC_BEST_FIT};
+  for (size_t v = 0; v < sizeof(variants) / sizeof(variants[0]); ++v)
+  {
+    srand(v);
+    assert(!yalloc_init_ex(a, sizeof(a), variants[v]));
+    assert(!yalloc_init_ex(b, sizeof(b), variants[v]));
+    size_t n = alloc_tagged_blocks(a, b, inA, inB, tags, 512);
+    if (!variants[v])
+      memset(tags, 0, sizeof(tags)); // plain pools have no tags
+
+    // freeing all blocks of a tag at once leaves the same blocks and free space as freeing them one by one
+    for (unsigned tag = 1; tag <= 4; tag = tag == 1 ? 3 : tag + 1)
+    {
+      yalloc_free_all(a, tag % 4);
+      for (size_t i = 0; i < n; ++i)
+      {
+        if (inB[i] && tags[i] == tag % 4)
+        {
+          yalloc_free(b, inB[i]);
+          inB[i] = NULL;
+        }
+      }
+
+      PoolState expected;
+      get_pool_state(b, &expected);
+      for (size_t i = 0; i < expected.numUsed; ++i)
+        expected.used[i] = (char*)a + ((char*)expected.used[i] - (char*)b);
+      assert_pool_state(a, &expected);
+      assert(!yalloc_tag_bytes(a, tag % 4) && !yalloc_tag_blocks(a, tag % 4));
+    }
+
+    yalloc_deinit(a);
+    yalloc_deinit(b);
+  }
+
+  // a rollback brings the blocks back
+  assert(!yalloc_init_ex(a, sizeof(a), YALLOC_TAGGED | YALLOC_UNDO_LOG(2048)));
+  assert(!yalloc_init_ex(b, sizeof(b), YALLOC_TAGGED));
+  alloc_tagged_blocks(a, b, inA, inB, tags, 64);
+  PoolState before;
+  get_pool_state(a, &before);
+  size_t cp = yalloc_checkpoint(a);
+  yalloc_free_all(a, 1);
+  assert(yalloc_count_free(a) > before.freeBytes);
+  assert(!yalloc_rollback(a, cp));
+  assert_pool_state(a, &before);
+  yalloc_checkpoint_release(a, cp);
+  yalloc_deinit(a);
+  yalloc_deinit(b);
+
+  // the blocks of the bitmap engine all have tag 0
+  assert(!yalloc_init_ex(a, sizeof(a), YALLOC_BITMAP));
+  size_t freeBytes = yalloc_count_free(a);
+  assert(yalloc_alloc(a, 10));
+  yalloc_free_all(a, 1);
+  assert(yalloc_first_used(a));
+  yalloc_free_all(a, 0);
+  assert(!yalloc_first_used(a));
+  assert(yalloc_count_free(a) == freeBytes);
+  yalloc_deinit(a);
+}
+
+static int is_zero(void * p, size_t size)
+{
+  for (size_t i = 0; i < size; ++i)
+  {
+    if (((char*)p)[i])
+      return 0;
+  }
+  return 1;
+}
+
+void test_calloc()
+{
+  static uint32_t a[1024];
+  unsigned variants[] = {YALLOC_MEMORY_IS_ZERO, YALLOC_MEMORY_IS_ZERO | YALLOC_ADDRESS_ORDERED, YALLOC_MEMORY_IS_ZERO | YALLOC_BITMAP, YALLOC_MEMORY_IS_ZERO | YALLOC_BITMAP | YALLOC_OUT_OF_BAND};
+  for (size_t v = 0; v < sizeof(variants) / sizeof(variants[0]); ++v)
+  {
+    memset(a, 0, sizeof(a));
+    assert(!yalloc_init_ex(a, sizeof(a), variants[v]));
+    char * root = (char*)a + getControl(a)->size;
+
+    // fresh memory comes back zeroed, reused memory is cleared
+    char * p = yalloc_calloc(a, 10, 4);
+    char * q = yalloc_calloc(a, 3, 5);
+    assert(p && q && is_zero(p, 40) && is_zero(q, 15));
+    memset(p, 0xFF, 40);
+    memset(q, 0xFF, 15);
+    yalloc_free(a, p);
+    p = yalloc_calloc(a, 40, 1);
+    assert(p && is_zero(p, 40));
+    memset(p, 0xFF, 40);
+
+    // memory behind the zero mark is trusted, so it is not cleared again (which the application must not break)
+    char * zero = root + getControl(a)->zeroFrom * 4;
+    assert(zero >= q + 15);
+    char * r = yalloc_alloc_hint(a, 16, YALLOC_LONG_LIVED);
+    assert(r && r >= zero);
+    memset(r, 0xFF, 16);
+    assert(root + getControl(a)->zeroFrom * 4 >= r + 16);
+    if (!(variants[v] & YALLOC_BITMAP))
+    { // the long lived block is at the end of the pool, so the mark moved to the end
+      zero = root + getControl(a)->zeroFrom * 4;
+      yalloc_free(a, r);
+      r = yalloc_calloc(a, 16, 1);
+      assert(r && is_zero(r, 16));
+    }
+
+    // defragmentation clears the memory the blocks moved away from
+    yalloc_free(a, p);
+    yalloc_defrag_start(a);
+    q = yalloc_defrag_address(a, q);
+    r = yalloc_defrag_address(a, r);
+    yalloc_defrag_commit(a);
+    zero = root + getControl(a)->zeroFrom * 4;
+    assert(zero > r);
+    assert(is_zero(zero, (char*)(a + 1024) - zero - 4)); // except the end Header of linked pools
+    p = yalloc_calloc(a, 100, 1);
+    assert(p && is_zero(p, 100));
+
+    // the tail of a pool that is completely free is zero after defragmentation
+    yalloc_free(a, p);
+    yalloc_free(a, q);
+    yalloc_free(a, r);
+    yalloc_defrag_start(a);
+    yalloc_defrag_commit(a);
+    assert(getControl(a)->zeroFrom <= 2);
+
+    // a reset does not clear the memory
+    p = yalloc_calloc(a, 100, 1);
+    memset(p, 0xFF, 100);
+    yalloc_reset(a);
+    p = yalloc_calloc(a, 100, 1);
+    assert(p && is_zero(p, 100));
+    yalloc_free_all(a, 0);
+    p = yalloc_calloc(a, 100, 1);
+    assert(p && is_zero(p, 100));
+
+    yalloc_deinit(a);
+  }
+
+  // pools without the flag always clear the memory
+  memset(a, 0xFF, sizeof(a));
+  assert(!yalloc_init(a, sizeof(a)));
+  char * p = yalloc_calloc(a, 25, 4);
+  assert(p && is_zero(p, 100));
+  yalloc_free(a, p);
+  assert(!yalloc_init_ex(a, sizeof(a), YALLOC_ADDRESS_ORDERED));
+  p = yalloc_calloc(a, 25, 4);
+  assert(p && is_zero(p, 100));
+
+  // sizes that overflow are rejected, and so are sizes that do not fit
+  assert(!yalloc_calloc(a, (size_t)-1 / 2, 4));
+  assert(!yalloc_calloc(a, 1024, 4));
+  assert(!yalloc_calloc(a, 0, 4));
+  yalloc_free(a, p);
+  yalloc_deinit(a);
+
+  assert(yalloc_init_ex(a, sizeof(a), YALLOC_BITMAP | YALLOC_MEMORY_IS_ZERO | YALLOC_TAGGED));
+}
+
+void test_bitmap()
+{
+  uint32_t pool[256];
+  assert(yalloc_init_ex(pool, sizeof(pool), YALLOC_BITMAP | YALLOC_ADDRESS_ORDERED)); // the free list policies do not apply
+  assert(yalloc_init_ex(pool, sizeof(Control) + 8, YALLOC_BITMAP)); // too small
+
+  assert(!yalloc_init_ex(pool, sizeof(Control) + 12, YALLOC_BITMAP)); // one bitmap word and two granules
+  assert(yalloc_count_free(pool) == 4);
+  void * single = checked_alloc(pool, 4);
+  assert(single);
+  assert(!yalloc_alloc(pool, 4));
+  checked_free(pool, single);
+  assert(!yalloc_alloc(pool, (size_t)-1)); // rounding the size up would overflow
+  yalloc_deinit(pool);
+
+  assert(!yalloc_init_ex(pool, sizeof(pool), YALLOC_BITMAP));
+  Control * ctrl = getControl(pool);
+  size_t freeBytes = yalloc_count_free(pool);
+  assert(freeBytes == (ctrl->numGranules - 1) * 4u);
+  assert(!yalloc_first_used(pool));
+  assert(!yalloc_alloc(pool, 0));
+  assert(!yalloc_alloc(pool, freeBytes + 1));
+
+  { // blocks are packed behind each other and freed granules are reused by first fit
+    void * a = checked_alloc(pool, 5);
+    void * b = checked_alloc(pool, 4);
+    void * c = checked_alloc(pool, 40);
+    assert(a == (char*)ctrl + ctrl->size + 4);
+    assert(yalloc_block_size(pool, a) == 8);
+    assert(b == (char*)a + 12);
+    assert(c == (char*)b + 8);
+    assert(yalloc_first_used(pool) == a);
+    assert(yalloc_next_used(pool, a) == b);
+    assert(yalloc_next_used(pool, b) == c);
+    assert(!yalloc_next_used(pool, c));
+
+    checked_free(pool, b);
+    assert(yalloc_next_used(pool, a) == c);
+    void * d = checked_alloc(pool, 8); // does not fit into the granules of b
+    assert(d == (char*)c + 44);
+    void * e = checked_alloc(pool, 4);
+    assert(e == b);
+
+    checked_free(pool, a);
+    checked_free(pool, c);
+    checked_free(pool, d);
+    checked_free(pool, e);
+    assert(yalloc_count_free(pool) == freeBytes);
+  }
+
+  { // completely used words of the bitmap are skipped
+    void * x = checked_alloc(pool, 4);
+    void * y = checked_alloc(pool, 256); // covers the rest of the first word, the second word and a part of the third
+    checked_free(pool, x);
+    void * z = checked_alloc(pool, 8); // does not fit in front of y
+    assert(z == (char*)y + 260);
+    checked_free(pool, y);
+    checked_free(pool, z);
+  }
+
+  { // the search starts behind the completely used words at the front
+    void * x = checked_alloc(pool, 124); // the first word
+    void * y = checked_alloc(pool, 4);
+    void * z = checked_alloc(pool, 4);
+    checked_free(pool, y);
+    void * w = checked_alloc(pool, 4);
+    assert(w == y);
+    checked_free(pool, x);
+    checked_free(pool, w);
+    checked_free(pool, z);
+  }
+
+  { // fill the pool, fragment it and defragment it
+    enum { N = 128 };
+    void * p[N];
+    int n = 0;
+    while (n < N && (p[n] = checked_alloc(pool, 4 + n % 3 * 4)))
+      ++n;
+    assert(n < N);
+    assert(yalloc_count_free(pool) < 12);
+
+    for (int i = 0; i < n; i += 2)
+    {
+      checked_free(pool, p[i]);
+      p[i] = NULL;
+    }
+    size_t fragmentedFree = yalloc_count_free(pool);
+    assert(fragmentedFree >= 40);
+    assert(!yalloc_alloc(pool, 40)); // there is enough free space, but no run of free granules is long enough
+
+    yalloc_defrag_start(pool);
+    assert(yalloc_defrag_in_progress(pool));
+    for (int i = 0; i < n; ++i)
+      p[i] = yalloc_defrag_address(pool, p[i]);
+    yalloc_defrag_commit(pool);
+    assert(!yalloc_defrag_in_progress(pool));
+    assert(yalloc_count_free(pool) == fragmentedFree);
+    assert(yalloc_first_used(pool) == p[1]); // the blocks are moved to the front of the pool
+    assert(p[1] == (char*)ctrl + ctrl->size + 4);
+
+    void * big = checked_alloc(pool, 40);
+    assert(big);
+    checked_free(pool, big);
+    for (int i = 0; i < n; ++i)
+      checked_free(pool, p[i]);
+  }
+
+  assert(yalloc_count_free(pool) == freeBytes);
+  void * all = checked_alloc(pool, freeBytes);
+  assert(all);
+  checked_free(pool, all);
+  yalloc_deinit(pool);
+}
+
+void test_out_of_band()
+{
+  uint32_t pool[256];
+  assert(yalloc_init_ex(pool, sizeof(pool), YALLOC_OUT_OF_BAND)); // needs the bitmap engine
+  assert(yalloc_init_ex(pool, sizeof(Control) + 16, YALLOC_BITMAP | YALLOC_OUT_OF_BAND)); // the metadata leaves space for one granule only
+  assert(!yalloc_init_ex(pool, sizeof(pool), YALLOC_BITMAP | YALLOC_OUT_OF_BAND));
+  Control * ctrl = getControl(pool);
+  size_t freeBytes = yalloc_count_free(pool);
+  assert(freeBytes == ctrl->numGranules * 4u); // no header needed
+
+  // blocks have no headers, so they are packed back-to-back
+  void * a = checked_alloc(pool, 5);
+  void * b = checked_alloc(pool, 4);
+  void * c = checked_alloc(pool, 40);
+  assert(a == (char*)ctrl + ctrl->size);
+  assert(yalloc_block_size(pool, a) == 8);
+  assert(yalloc_block_size(pool, b) == 4);
+  assert(b == (char*)a + 8);
+  assert(c == (char*)b + 4);
+  assert(yalloc_first_used(pool) == a);
+  assert(yalloc_next_used(pool, a) == b);
+  assert(yalloc_next_used(pool, b) == c);
+  assert(!yalloc_next_used(pool, c));
+
+  checked_free(pool, b);
+  void * d = checked_alloc(pool, 8);
+  assert(d == (char*)c + 40);
+  void * e = checked_alloc(pool, 4);
+  assert(e == b);
+  assert(yalloc_next_used(pool, a) == e); // the end of a separates it from e
+
+  // the post-defragmentation-address is the number of used granules in front of a block
+  void * f = checked_alloc(pool, 200); // crosses words of the bitmaps
+  void * g = checked_alloc(pool, 4);
+  checked_free(pool, a);
+  checked_free(pool, c);
+  yalloc_defrag_start(pool);
+  e = yalloc_defrag_address(pool, e);
+  d = yalloc_defrag_address(pool, d);
+  f = yalloc_defrag_address(pool, f);
+  g = yalloc_defrag_address(pool, g);
+  yalloc_defrag_commit(pool);
+  assert(e == (char*)ctrl + ctrl->size);
+  assert(d == (char*)e + 4);
+  assert(f == (char*)d + 8);
+  assert(g == (char*)f + 200);
+  assert(yalloc_block_size(pool, f) == 200);
+
+  checked_free(pool, d);
+  checked_free(pool, e);
+  checked_free(pool, f);
+  checked_free(pool, g);
+  assert(yalloc_count_free(pool) == freeBytes);
+  void * all = checked_alloc(pool, freeBytes);
+  assert(all);
+  checked_free(pool, all);
+  yalloc_deinit(pool);
+}
+
+enum { MT_THREADS = 4, MT_BLOCKS = 200 };
+
+typedef struct
+{
+  YallocMt * mt;
+  pthread_barrier_t * barrier;
+  uint8_t * blocks[MT_THREADS][MT_BLOCKS]; // shared by all threads
+} MtShared;
+
+typedef struct
+{
+  MtShared * shared;
+  int index;
+} MtArg;
+
+static void mt_free_blocks(YallocMtThread * t, MtShared * shared, int owner, int from, int to)
+{
+  for (int i = from; i < to; ++i)
+  {
+    uint8_t * p = shared->blocks[owner][i];
+    assert(p[0] == (uint8_t)(owner * MT_BLOCKS + i) && p[i % 80] == (uint8_t)(owner * MT_BLOCKS + i));
+    yalloc_mt_free(t, p);
+  }
+}
+
+static void * mt_thread(void * arg_)
+{
+  MtArg * arg = arg_;
+  MtShared * shared = arg->shared;
+  int me = arg->index;
+  int neighbour = (me + 1) % MT_THREADS;
+  YallocMtThread t;
+  assert(!yalloc_mt_thread_init(shared->mt, &t));
+
+  for (int i = 0; i < MT_BLOCKS; ++i)
+  {
+    uint8_t * p = yalloc_mt_alloc(&t, i % 80 + 1);
+    assert(p);
+    memset(p, (uint8_t)(me * MT_BLOCKS + i), i % 80 + 1);
+    shared->blocks[me][i] = p;
+  }
+  pthread_barrier_wait(shared->barrier);
+
+  // free the first half of the blocks of the neighbour (which go through its queue) while it is allocating
+  mt_free_blocks(&t, shared, neighbour, 0, MT_BLOCKS / 2);
+  for (int i = 0; i < 100; ++i)
+    yalloc_mt_free(&t, yalloc_mt_alloc(&t, i % 80 + 1));
+  pthread_barrier_wait(shared->barrier);
+
+  // the odd threads leave, the even threads free blocks of them, then they come back and free blocks of the even ones
+  if (me % 2)
+    yalloc_mt_thread_deinit(&t);
+  pthread_barrier_wait(shared->barrier);
+  if (!(me % 2))
+    mt_free_blocks(&t, shared, neighbour, MT_BLOCKS / 2, MT_BLOCKS);
+  pthread_barrier_wait(shared->barrier);
+  if (me % 2)
+  {
+    assert(!yalloc_mt_thread_init(shared->mt, &t));
+    mt_free_blocks(&t, shared, neighbour, MT_BLOCKS / 2, MT_BLOCKS);
+  }
+  pthread_barrier_wait(shared->barrier);
+
+  yalloc_mt_thread_deinit(&t);
+  return NULL;
+}
+
+typedef struct
+{
+  YallocListNode node;
+  uint32_t value;
+} ListElement;
+
+void test_vector_limit()
+{
+  // size and capacity of a vector are 16 bits
+  static uint32_t pool[MAX_POOL_SIZE / 4];
+  assert(!yalloc_init(pool, sizeof(pool)));
+  size_t freeBytes = yalloc_count_free(pool);
+  YallocVector vector;
+  yalloc_vector_init(&vector, 1);
+  assert(yalloc_vector_reserve(pool, &vector, 70000) && !vector.capacity && yalloc_count_free(pool) == freeBytes);
+  assert(yalloc_vector_reserve(pool, &vector, 0x10000) && !vector.capacity);
+  assert(!yalloc_vector_reserve(pool, &vector, 0xFFFF) && vector.capacity == 0xFFFF);
+  yalloc_vector_deinit(pool, &vector);
+
+  // growing stops at the limit instead of wrapping around
+  assert(!yalloc_vector_reserve(pool, &vector, 0x8000)); // the next step would be 0x10000
+  for (uint32_t i = 0; i < 0xFFFF; ++i)
+  {
+    uint8_t byte = (uint8_t)i;
+    assert(yalloc_vector_push(pool, &vector, &byte));
+  }
+  assert(vector.size == 0xFFFF && vector.capacity == 0xFFFF);
+  assert(!yalloc_vector_push(pool, &vector, NULL) && vector.size == 0xFFFF);
+  assert(*(uint8_t*)yalloc_vector_at(pool, &vector, 0xFFFE) == 0xFE);
+  yalloc_vector_deinit(pool, &vector);
+  assert(yalloc_count_free(pool) == freeBytes);
+  yalloc_deinit(pool);
+}
+
+void test_containers()
+{
+  uint32_t pool[4096];
+  assert(!yalloc_init_ex(pool, sizeof(pool), YALLOC_ADDRESS_ORDERED));
+  size_t freeBytes = yalloc_count_free(pool);
+
+  // containers that can not grow stay as they are
+  YallocVector huge;
+  yalloc_vector_init(&huge, MAX_POOL_SIZE / 2);
+  assert(!yalloc_vector_push(pool, &huge, NULL) && !huge.capacity);
+  YallocMap empty;
+  yalloc_map_init(&empty);
+  size_t position = 0;
+  uint32_t key;
+  assert(!yalloc_map_next(pool, &empty, &position, &key));
+  void * rest = yalloc_alloc(pool, freeBytes);
+  assert(yalloc_map_put(pool, &empty, 1, 1) && !empty.count);
+  yalloc_free(pool, rest);
+
+  // vectors grow by copying their elements
+  YallocVector vector;
+  yalloc_vector_init(&vector, 4);
+  for (uint32_t i = 0; i < 100; ++i)
+    assert(yalloc_vector_push(pool, &vector, &i));
+  assert(vector.size == 100 && vector.capacity == 128);
+  *(uint32_t*)yalloc_vector_push(pool, &vector, NULL) = 100;
+  yalloc_vector_pop(&vector);
+  for (uint32_t i = 0; i < 100; ++i)
+    assert(*(uint32_t*)yalloc_vector_at(pool, &vector, i) == i);
+  assert(!yalloc_vector_reserve(pool, &vector, 10));
+  assert(yalloc_vector_reserve(pool, &vector, MAX_POOL_SIZE)); // too big for any pool
+  assert(yalloc_vector_reserve(pool, &vector, 5000)); // too big for this pool
+  assert(vector.capacity == 128);
+
+  // maps
+  YallocMap map;
+  yalloc_map_init(&map);
+  assert(!yalloc_map_get(pool, &map, 1) && !yalloc_map_remove(pool, &map, 1));
+  for (uint32_t i = 0; i < 200; ++i)
+    assert(!yalloc_map_put(pool, &map, i * 16, i));
+  assert(map.count == 200 && map.capacityShift == 9);
+  assert(!yalloc_map_put(pool, &map, 16, 1000)); // replaces the value
+  assert(*yalloc_map_get(pool, &map, 16) == 1000 && map.count == 200);
+  assert(!yalloc_map_get(pool, &map, 17) && !yalloc_map_remove(pool, &map, 17));
+  for (uint32_t i = 0; i < 200; i += 2)
+    assert(yalloc_map_remove(pool, &map, i * 16));
+  for (uint32_t i = 0; i < 200; ++i)
+    assert(!yalloc_map_get(pool, &map, i * 16) == (i % 2 == 0)); // the entries behind removed ones are still found
+  size_t entries = 0;
+  position = 0;
+  for (uint32_t * value; (value = yalloc_map_next(pool, &map, &position, &key)); ++entries)
+    assert(key % 32 == 16 && (*value == key / 16 || key == 16));
+  assert(entries == 100 && !yalloc_map_next(pool, &map, &position, &key));
+
+  // removing entries from a crowded table moves the entries behind them back
+  for (uint32_t r = 0; r < 6; ++r)
+  {
+    YallocMap small;
+    yalloc_map_init(&small);
+    for (uint32_t i = 0; i < 6; ++i)
+      assert(!yalloc_map_put(pool, &small, i, i));
+    assert(small.capacityShift == 3);
+    assert(yalloc_map_remove(pool, &small, r));
+    for (uint32_t i = 0; i < 6; ++i)
+      assert(!yalloc_map_get(pool, &small, i) == (i == r));
+    yalloc_map_deinit(pool, &small);
+  }
+
+  // intrusive lists
+  YallocList list;
+  yalloc_list_init(&list);
+  assert(!yalloc_list_first(pool, &list));
+  ListElement * elements[4];
+  void * gaps[4];
+  for (uint32_t i = 0; i < 4; ++i)
+  {
+    gaps[i] = yalloc_alloc(pool, 8); // freed below to make defragmentation move the elements
+    elements[i] = yalloc_alloc(pool, sizeof(ListElement));
+    elements[i]->value = i;
+  }
+  yalloc_list_push_front(pool, &list, &elements[0]->node);
+  yalloc_list_push_back(pool, &list, &elements[1]->node);
+  yalloc_list_push_back(pool, &list, &elements[2]->node);
+  yalloc_list_push_front(pool, &list, &elements[3]->node);
+  yalloc_list_remove(pool, &list, &elements[3]->node); // first
+  yalloc_list_push_back(pool, &list, &elements[3]->node);
+  yalloc_list_remove(pool, &list, &elements[3]->node); // last
+  yalloc_list_push_back(pool, &list, &elements[3]->node);
+  yalloc_list_remove(pool, &list, &elements[1]->node); // in the middle
+  yalloc_list_push_front(pool, &list, &elements[1]->node);
+
+  // all of them are compacted without touching their internals
+  yalloc_vector_deinit(pool, &vector);
+  yalloc_vector_init(&vector, 8);
+  for (uint32_t i = 0; i < 10; ++i)
+    yalloc_vector_push(pool, &vector, NULL);
+  for (int i = 0; i < 4; ++i)
+    yalloc_free(pool, gaps[i]);
+  yalloc_defrag_start(pool);
+  YallocOffset vectorData = vector.data, mapTable = map.table;
+  yalloc_vector_defrag(pool, &vector);
+  yalloc_map_defrag(pool, &map);
+  yalloc_list_defrag(pool, &list);
+  yalloc_defrag_commit(pool);
+  assert(vector.data != vectorData || map.table != mapTable);
+
+  uint32_t order[] = {1, 0, 2, 3};
+  int n = 0;
+  for (YallocListNode * node = yalloc_list_first(pool, &list); node; node = yalloc_list_next(pool, node))
+    assert(((ListElement*)node)->value == order[n++]);
+  assert(n == 4);
+  assert(*yalloc_map_get(pool, &map, 16) == 1000 && map.count == 100);
+
+  yalloc_vector_deinit(pool, &vector);
+  yalloc_map_deinit(pool, &map);
+  while (yalloc_list_first(pool, &list))
+  {
+    YallocListNode * node = yalloc_list_first(pool, &list);
+    yalloc_list_remove(pool, &list, node);
+    yalloc_free(pool, node);
+  }
+  assert(!list.first && !list.last);
+  ListElement * single = yalloc_alloc(pool, sizeof(ListElement));
+  yalloc_list_push_back(pool, &list, &single->node);
+  assert(yalloc_list_first(pool, &list) == &single->node && !yalloc_list_next(pool, &single->node));
+  yalloc_list_remove(pool, &list, &single->node);
+  yalloc_free(pool, single);
+  assert(yalloc_count_free(pool) == freeBytes);
+  yalloc_deinit(pool);
+}
+
+void test_mt()
+{
+  static uint32_t pool[MAX_POOL_SIZE / 4];
+  assert(!yalloc_init(pool, sizeof(pool)));
+  size_t freeBytes = yalloc_count_free(pool);
+  YallocMt mt;
+  assert(!yalloc_mt_init(&mt, pool));
+
+  { // two thread states used by one thread show every path deterministically
+    YallocMtThread a;
+    YallocMtThread b;
+    assert(!yalloc_mt_thread_init(&mt, &a));
+    assert(!yalloc_mt_thread_init(&mt, &b));
+
+    assert(!yalloc_mt_alloc(&a, 0));
+    assert(!yalloc_mt_alloc(&a, MAX_POOL_SIZE + 1));
+    char * big = yalloc_mt_alloc(&a, 1000); // passed through to the pool
+    assert(big);
+    memset(big, 1, 1000);
+    yalloc_mt_free(&b, big);
+    yalloc_mt_free(&a, NULL);
+
+    // the first allocation takes a batch from the pool, so the next ones do not touch it
+    char * p[3 * YALLOC_MT_CACHE_SIZE];
+    p[0] = yalloc_mt_alloc(&a, 8);
+    size_t cachedFree = yalloc_mt_count_free(&mt);
+    assert(cachedFree < freeBytes - YALLOC_MT_BATCH * 12);
+    for (int i = 1; i < YALLOC_MT_BATCH; ++i)
+      p[i] = yalloc_mt_alloc(&a, 5);
+    assert(yalloc_mt_count_free(&mt) == cachedFree);
+    for (int i = YALLOC_MT_BATCH; i < 3 * YALLOC_MT_CACHE_SIZE; ++i)
+      p[i] = yalloc_mt_alloc(&a, 7);
+
+    // frees of the owner go to its cache until it is full, then a batch goes back to the pool
+    for (int i = 0; i < YALLOC_MT_CACHE_SIZE; ++i)
+      yalloc_mt_free(&a, p[i]);
+    size_t before = yalloc_mt_count_free(&mt);
+    yalloc_mt_free(&a, p[YALLOC_MT_CACHE_SIZE]);
+    assert(yalloc_mt_count_free(&mt) > before);
+    assert(a.numCached[1] == YALLOC_MT_CACHE_SIZE + 1 - YALLOC_MT_BATCH);
+
+    // frees of other threads wait in the queue of the owner until its cache runs empty, more than the cache can take go to the pool
+    for (int i = YALLOC_MT_CACHE_SIZE + 1; i < 3 * YALLOC_MT_CACHE_SIZE; ++i)
+      yalloc_mt_free(&b, p[i]);
+    before = yalloc_mt_count_free(&mt);
+    while (a.numCached[1])
+      assert(yalloc_mt_alloc(&a, 8)); // leaks them (they are freed by the pool being initialized again below)
+    assert(yalloc_mt_count_free(&mt) == before);
+    assert(yalloc_mt_alloc(&a, 8));
+    assert(a.numCached[1] == YALLOC_MT_CACHE_SIZE - 1);
+    assert(yalloc_mt_count_free(&mt) > before);
+
+    // blocks of a thread that left are freed to the pool directly
+    char * q = yalloc_mt_alloc(&a, 4);
+    yalloc_mt_thread_deinit(&a);
+    yalloc_mt_free(&b, q);
+    yalloc_mt_thread_deinit(&b);
+    yalloc_mt_deinit(&mt);
+
+    assert(!yalloc_init(pool, 256)); // a small pool runs out of memory
+    assert(!yalloc_mt_init(&mt, pool));
+    assert(!yalloc_mt_thread_init(&mt, &a));
+    while (yalloc_mt_alloc(&a, 16))
+      ;
+    assert(!yalloc_mt_alloc(&a, 100));
+    yalloc_mt_thread_deinit(&a);
+
+    YallocMtThread t[YALLOC_MT_MAX_THREADS + 1];
+    for (int i = 0; i < YALLOC_MT_MAX_THREADS; ++i)
+      assert(!yalloc_mt_thread_init(&mt, &t[i]));
+    assert(yalloc_mt_thread_init(&mt, &t[YALLOC_MT_MAX_THREADS])); // all slots are taken
+    for (int i = 0; i < YALLOC_MT_MAX_THREADS; ++i)
+      yalloc_mt_thread_deinit(&t[i]);
+    yalloc_mt_deinit(&mt);
+  }
+
+  // threads that free the blocks of each other give back everything in the end
+  assert(!yalloc_init(pool, sizeof(pool)));
+  assert(!yalloc_mt_init(&mt, pool));
+  pthread_barrier_t barrier;
+  pthread_barrier_init(&barrier, NULL, MT_THREADS);
+  static MtShared shared;
+  shared.mt = &mt;
+  shared.barrier = &barrier;
+  pthread_t threads[MT_THREADS];
+  MtArg args[MT_THREADS];
+  for (int i = 0; i < MT_THREADS; ++i)
+  {
+    args[i].shared = &shared;
+    args[i].index = i;
+    assert(!pthread_create(&threads[i], NULL, mt_thread, &args[i]));
+  }
+  for (int i = 0; i < MT_THREADS; ++i)
+    pthread_join(threads[i], NULL);
+  pthread_barrier_destroy(&barrier);
+  assert(yalloc_mt_count_free(&mt) == freeBytes);
+  yalloc_mt_deinit(&mt);
+
+  // defragmentation moves the blocks with their prefix
+  assert(!yalloc_mt_init(&mt, pool));
+  YallocMtThread t;
+  assert(!yalloc_mt_thread_init(&mt, &t));
+  char * a = yalloc_mt_alloc(&t, 100);
+  char * b = yalloc_mt_alloc(&t, 100);
+  memset(b, 7, 100);
+  yalloc_mt_free(&t, a);
+  yalloc_mt_thread_deinit(&t);
+  yalloc_defrag_start(pool);
+  assert(!yalloc_mt_defrag_address(&mt, NULL));
+  b = yalloc_mt_defrag_address(&mt, b);
+  yalloc_defrag_commit(pool);
+  assert(b == (char*)pool + 8 && b[0] == 7 && b[99] == 7);
+  assert(!yalloc_mt_thread_init(&mt, &t));
+  yalloc_mt_free(&t, b);
+  yalloc_mt_thread_deinit(&t);
+  assert(yalloc_mt_count_free(&mt) == freeBytes);
+  yalloc_mt_deinit(&mt);
+  yalloc_deinit(pool);
+}
+
+enum { STRIPED_THREADS = 4, STRIPED_BLOCKS = 100 };
+
+typedef struct
+{
+  YallocStriped * striped;
+  pthread_barrier_t * barrier;
+  uint8_t * blocks[STRIPED_THREADS][STRIPED_BLOCKS]; // shared by all threads
+} StripedShared;
+
+typedef struct
+{
+  StripedShared * shared;
+  int index;
+} StripedArg;
+
+static void * striped_thread(void * arg_)
+{
+  StripedArg * arg = arg_;
+  StripedShared * shared = arg->shared;
+  int me = arg->index;
+  uint8_t ** blocks = shared->blocks[me];
+  for (int i = 0; i < STRIPED_BLOCKS; ++i)
+  {
+    blocks[i] = yalloc_striped_alloc_on(shared->striped, me, i % 50 + 1); // the stripes are big enough, so the blocks of a thread stay in its stripe
+    assert(blocks[i]);
+    memset(blocks[i], me * STRIPED_BLOCKS + i, i % 50 + 1);
+  }
+
+  if (!me)
+  { // stripe 0 belongs to this thread, it defragments it while the others allocate and free
+    for (int round = 0; round < 20; ++round)
+    {
+      for (int i = round % 2; i < STRIPED_BLOCKS; i += 2)
+      {
+        yalloc_striped_free(shared->striped, blocks[i]);
+        blocks[i] = NULL;
+      }
+
+      yalloc_striped_defrag_start(shared->striped, 0);
+      for (int i = 0; i < STRIPED_BLOCKS; ++i)
+        blocks[i] = yalloc_striped_defrag_address(shared->striped, 0, blocks[i]);
+      yalloc_striped_defrag_commit(shared->striped, 0);
+
+      for (int i = round % 2; i < STRIPED_BLOCKS; i += 2)
+      {
+        blocks[i] = yalloc_striped_alloc_on(shared->striped, 0, i % 50 + 1);
+        memset(blocks[i], i, i % 50 + 1);
+      }
+      for (int i = 0; i < STRIPED_BLOCKS; ++i)
+        assert(blocks[i][0] == (uint8_t)i && blocks[i][i % 50] == (uint8_t)i);
+    }
+  }
+  else
+  {
+    for (int round = 0; round < 200; ++round)
+    {
+      int i = rand() % STRIPED_BLOCKS;
+      assert(blocks[i][0] == (uint8_t)(me * STRIPED_BLOCKS + i) && blocks[i][i % 50] == (uint8_t)(me * STRIPED_BLOCKS + i));
+      yalloc_striped_free(shared->striped, blocks[i]);
+      blocks[i] = yalloc_striped_alloc_on(shared->striped, me, i % 50 + 1);
+      memset(blocks[i], me * STRIPED_BLOCKS + i, i % 50 + 1);
+    }
+  }
+  pthread_barrier_wait(shared->barrier);
+
+  // free the blocks of the neighbour
+  for (int i = 0; i < STRIPED_BLOCKS; ++i)
+    yalloc_striped_free(shared->striped, shared->blocks[(me + 1) % STRIPED_THREADS][i]);
+  return NULL;
+}
+
+typedef struct
+{
+  YallocStriped * striped;
+  void * p;
+} StripedFreeArg;
+
+static void * striped_free_thread(void * arg_)
+{
+  StripedFreeArg * arg = arg_;
+  yalloc_striped_free(arg->striped, arg->p);
+  return NULL;
+}
+
+void test_striped()
+{
+  static uint32_t buffer[64 * 1024];
+  YallocStriped striped;
+  assert(yalloc_striped_init(&striped, buffer, sizeof(buffer), 0, 0));
+  assert(yalloc_striped_init(&striped, buffer, sizeof(buffer), YALLOC_STRIPED_MAX + 1, 0));
+  assert(yalloc_striped_init(&striped, buffer, sizeof(buffer), 1, 0)); // bigger than MAX_POOL_SIZE
+  assert(yalloc_striped_init(&striped, buffer, 16, 2, 0));
+  assert(yalloc_striped_init(&striped, buffer, 4 * 4096, 4, YALLOC_NEXT_FIT | YALLOC_BEST_FIT));
+
+  // the stripes of a buffer can be bigger than a single pool
+  assert(!yalloc_striped_init(&striped, buffer, sizeof(buffer), 4, YALLOC_ADDRESS_ORDERED));
+  size_t freeBytes = yalloc_striped_count_free(&striped);
+  assert(freeBytes > MAX_POOL_SIZE);
+  void * p = yalloc_striped_alloc(&striped, 1000);
+  void * q = yalloc_striped_alloc(&striped, 1000);
+  assert(yalloc_striped_stripe_of(&striped, p) == yalloc_striped_stripe_of(&striped, q)); // the home stripe of this thread
+  yalloc_striped_free(&striped, p);
+  yalloc_striped_free(&striped, q);
+  yalloc_striped_free(&striped, NULL);
+  yalloc_striped_deinit(&striped);
+
+  assert(!yalloc_striped_init(&striped, buffer, 4 * 4096 + 3, 4, 0));
+  freeBytes = yalloc_striped_count_free(&striped);
+
+  // a full stripe falls back to the stripes behind it
+  void * blocks[64];
+  int n = 0;
+  while ((blocks[n] = yalloc_striped_alloc_on(&striped, 6, 1000)) && yalloc_striped_stripe_of(&striped, blocks[n]) == 2)
+    ++n;
+  assert(n == 4 && blocks[n] && yalloc_striped_stripe_of(&striped, blocks[n]) == 3);
+  ++n;
+  while ((blocks[n] = yalloc_striped_alloc_on(&striped, 3, 1000)))
+    ++n;
+  assert(n == 16);
+  for (int i = 0; i < n; ++i)
+    yalloc_striped_free(&striped, blocks[i]);
+  assert(yalloc_striped_count_free(&striped) == freeBytes);
+
+  // a stripe that is defragmenting is skipped by allocations
+  p = yalloc_striped_alloc_on(&striped, 1, 100);
+  q = yalloc_striped_alloc_on(&striped, 1, 100);
+  void * r = yalloc_striped_alloc_on(&striped, 2, 100);
+  memset(q, 5, 100);
+  yalloc_striped_free(&striped, p);
+  yalloc_striped_defrag_start(&striped, 1);
+  void * s = yalloc_striped_alloc_on(&striped, 1, 100);
+  assert(yalloc_striped_stripe_of(&striped, s) == 2);
+  assert(yalloc_striped_defrag_address(&striped, 1, r) == r);
+  assert(!yalloc_striped_defrag_address(&striped, 1, NULL));
+  q = yalloc_striped_defrag_address(&striped, 1, q);
+  yalloc_striped_defrag_commit(&striped, 1);
+  assert(q == (char*)buffer + 4096 + 4 && ((char*)q)[99] == 5);
+  yalloc_striped_free(&striped, q);
+  yalloc_striped_free(&striped, r);
+  yalloc_striped_free(&striped, s);
+  assert(yalloc_striped_count_free(&striped) == freeBytes);
+
+  // a free into a stripe that is defragmenting gets the address from before and frees the block at its new address after the commit
+  p = yalloc_striped_alloc_on(&striped, 1, 100);
+  q = yalloc_striped_alloc_on(&striped, 1, 100);
+  r = yalloc_striped_alloc_on(&striped, 1, 100);
+  memset(r, 7, 100);
+  yalloc_striped_free(&striped, p);
+  yalloc_striped_defrag_start(&striped, 1);
+  StripedFreeArg freeArg = { &striped, q };
+  pthread_t freeThread;
+  assert(!pthread_create(&freeThread, NULL, striped_free_thread, &freeArg));
+  usleep(10000); // the free waits for the commit
+  r = yalloc_striped_defrag_address(&striped, 1, r);
+  yalloc_striped_defrag_commit(&striped, 1);
+  pthread_join(freeThread, NULL);
+  assert(r == (char*)buffer + 4096 + 108 && ((char*)r)[0] == 7 && ((char*)r)[99] == 7); // q was moved to where p was and r behind it
+  yalloc_striped_free(&striped, r);
+  assert(yalloc_striped_count_free(&striped) == freeBytes);
+  yalloc_striped_deinit(&striped);
+
+  // threads allocate and free concurrently while one of them defragments its stripe
+  assert(!yalloc_striped_init(&striped, buffer, sizeof(buffer), 4, 0));
+  freeBytes = yalloc_striped_count_free(&striped);
+  pthread_barrier_t barrier;
+  pthread_barrier_init(&barrier, NULL, STRIPED_THREADS);
+  static StripedShared shared;
+  shared.striped = &striped;
+  shared.barrier = &barrier;
+  pthread_t threads[STRIPED_THREADS];
+  StripedArg args[STRIPED_THREADS];
+  for (int i = 0; i < STRIPED_THREADS; ++i)
+  {
+    args[i].shared = &shared;
+    args[i].index = i;
+    assert(!pthread_create(&threads[i], NULL, striped_thread, &args[i]));
+  }
+  for (int i = 0; i < STRIPED_THREADS; ++i)
+    pthread_join(threads[i], NULL);
+  pthread_barrier_destroy(&barrier);
+  assert(yalloc_striped_count_free(&striped) == freeBytes);
+  yalloc_striped_deinit(&striped);
+}
+
+void test_persist()
+{
+  char path[] = "/tmp/yalloc_test_XXXXXX";
+  int fd = mkstemp(path);
+  assert(fd >= 0);
+  close(fd);
+
+  YallocFile file;
+  assert(yalloc_open_file(&file, path, MAX_POOL_SIZE + 1, 0) < 0);
+  assert(yalloc_open_file(&file, "/nonexistent/dir/pool", 4096, 0) < 0);
+  assert(yalloc_open_file(&file, path, 4096, YALLOC_NEXT_FIT | YALLOC_BEST_FIT) < 0); // leaves the file empty
+
+  // a new pool is created in the empty file
+  assert(yalloc_open_file(&file, path, 4096, YALLOC_ADDRESS_ORDERED | YALLOC_MEMORY_IS_ZERO) == YALLOC_FILE_CREATED);
+  char * p = yalloc_calloc(file.pool, 1, 100);
+  assert(p);
+  strcpy(p, "persistent");
+  size_t offset = p - (char*)file.pool;
+  size_t freeBytes = yalloc_count_free(file.pool);
+  assert(!yalloc_flush_file(&file));
+  assert(!yalloc_close_file(&file));
+
+  // the pool comes back with its allocations (at whatever address the file is mapped)
+  assert(yalloc_open_file(&file, path, 4096, YALLOC_ADDRESS_ORDERED | YALLOC_MEMORY_IS_ZERO) == YALLOC_FILE_CLEAN);
+  p = (char*)file.pool + offset;
+  assert(!strcmp(p, "persistent") && yalloc_first_used(file.pool) == p);
+  assert(yalloc_count_free(file.pool) == freeBytes);
+  assert(yalloc_alloc(file.pool, 50));
+
+  // a process that dies leaves an unclean file behind
+  munmap(file.header, file.mappedSize);
+  close(file.fd);
+  assert(yalloc_open_file(&file, path, 4096, YALLOC_ADDRESS_ORDERED | YALLOC_MEMORY_IS_ZERO) == YALLOC_FILE_UNCLEAN);
+  assert(yalloc_count_free(file.pool) < freeBytes);
+  assert(!yalloc_close_file(&file));
+
+  // a file of another pool is not touched
+  assert(yalloc_open_file(&file, path, 8192, YALLOC_ADDRESS_ORDERED | YALLOC_MEMORY_IS_ZERO) < 0);
+  assert(yalloc_open_file(&file, path, 4096, YALLOC_ADDRESS_ORDERED) < 0);
+  FILE * f = fopen(path, "r+b");
+  fputc('x', f);
+  fclose(f);
+  assert(yalloc_open_file(&file, path, 4096, YALLOC_ADDRESS_ORDERED | YALLOC_MEMORY_IS_ZERO) < 0);
+
+  // a file that was being created when the process died (full size, but no magic yet) is created again
+  static char partial[sizeof(YallocFileHeader) + 4096];
+  memset(partial + sizeof(YallocFileHeader), 0xAB, 4096); // what yalloc_init_ex() wrote
+  f = fopen(path, "wb");
+  assert(fwrite(partial, sizeof(partial), 1, f) == 1);
+  fclose(f);
+  assert(yalloc_open_file(&file, path, 8192, YALLOC_ADDRESS_ORDERED | YALLOC_MEMORY_IS_ZERO) < 0); // only if the size fits
+  assert(yalloc_open_file(&file, path, 4096, YALLOC_ADDRESS_ORDERED | YALLOC_MEMORY_IS_ZERO) == YALLOC_FILE_CREATED);
+  assert(!yalloc_first_used(file.pool));
+  p = yalloc_calloc(file.pool, 1, 3900);
+  assert(p && !p[0] && !p[3899]);
+  assert(!yalloc_close_file(&file));
+  assert(yalloc_open_file(&file, path, 4096, YALLOC_ADDRESS_ORDERED | YALLOC_MEMORY_IS_ZERO) == YALLOC_FILE_CLEAN);
+  assert(!yalloc_close_file(&file));
+  unlink(path);
+}
+
+// frees all allocations of a pool file and checks that the whole pool is free again
+static void check_file_pool(YallocFile * file, size_t emptyFree)
+{
+  void * p;
+  while ((p = yalloc_first_used(file->pool)))
+    yalloc_free(file->pool, p);
+  assert(yalloc_count_free(file->pool) == emptyFree);
+}
+
+void test_persist_recovery()
+{
+  char path[] = "/tmp/yalloc_test_XXXXXX";
+  int fd = mkstemp(path);
+  assert(fd >= 0);
+  close(fd);
+
+  unsigned const flags = YALLOC_ADDRESS_ORDERED | YALLOC_UNDO_LOG(64);
+  YallocFile file;
+  assert(yalloc_open_file(&file, path, 4096, flags) == YALLOC_FILE_CREATED);
+  size_t emptyFree = yalloc_count_free(file.pool);
+  char * a = yalloc_file_alloc(&file, 100);
+  char * b = yalloc_file_alloc(&file, 200);
+  assert(a && b);
+  yalloc_file_free(&file, NULL);
+  assert(!yalloc_close_file(&file));
+
+  // a sequence that is interrupted by the death of the process is rolled back
+  assert(yalloc_open_file(&file, path, 4096, flags) == YALLOC_FILE_CLEAN);
+  size_t aOffset = (char*)yalloc_first_used(file.pool) - (char*)file.pool;
+  size_t freeBytes = yalloc_count_free(file.pool);
+  yalloc_file_begin(&file);
+  yalloc_free(file.pool, (char*)file.pool + aOffset);
+  assert(yalloc_alloc(file.pool, 300));
+  munmap(file.header, file.mappedSize);
+  close(file.fd);
+  assert(yalloc_open_file(&file, path, 4096, flags) == YALLOC_FILE_UNCLEAN);
+  assert(yalloc_first_used(file.pool) == (char*)file.pool + aOffset);
+  assert(yalloc_count_free(file.pool) == freeBytes);
+  assert(!getControl(file.pool)->undoDepth);
+
+  // completed sequences are kept
+  size_t checkpoint = yalloc_file_begin(&file);
+  yalloc_free(file.pool, (char*)file.pool + aOffset);
+  yalloc_file_end(&file, checkpoint);
+  munmap(file.header, file.mappedSize);
+  close(file.fd);
+  assert(yalloc_open_file(&file, path, 4096, flags) == YALLOC_FILE_UNCLEAN);
+  assert(yalloc_first_used(file.pool) != (char*)file.pool + aOffset);
+
+  // a log that is left over from released checkpoints (the process died while releasing the last one) is not rolled back later
+  yalloc_file_begin(&file);
+  char * c = yalloc_alloc(file.pool, 100);
+  assert(c);
+  size_t cOffset = c - (char*)file.pool;
+  getControl(file.pool)->undoDepth = 0; // as if it died after the depth dropped, before the log was emptied
+  munmap(file.header, file.mappedSize);
+  close(file.fd);
+  assert(yalloc_open_file(&file, path, 4096, flags) == YALLOC_FILE_UNCLEAN);
+  freeBytes = yalloc_count_free(file.pool);
+  yalloc_file_begin(&file);
+  assert(yalloc_alloc(file.pool, 50));
+  munmap(file.header, file.mappedSize);
+  close(file.fd);
+  assert(yalloc_open_file(&file, path, 4096, flags) == YALLOC_FILE_UNCLEAN);
+  assert(yalloc_count_free(file.pool) == freeBytes); // c is still allocated
+  yalloc_file_free(&file, (char*)file.pool + cOffset);
+
+  // a sequence that overflows the log can not be rolled back
+  yalloc_file_begin(&file);
+  for (int i = 0; i < 64; ++i)
+    yalloc_alloc(file.pool, 4);
+  munmap(file.header, file.mappedSize);
+  close(file.fd);
+  assert(yalloc_open_file(&file, path, 4096, flags) == YALLOC_FILE_BROKEN);
+  assert(yalloc_count_free(file.pool) == emptyFree); // the pool was initialized again
+
+  // neither can an interrupted defragmentation
+  assert(yalloc_file_alloc(&file, 10) && yalloc_file_alloc(&file, 10));
+  yalloc_file_free(&file, yalloc_first_used(file.pool));
+  yalloc_file_defrag_start(&file);
+  munmap(file.header, file.mappedSize);
+  close(file.fd);
+  assert(yalloc_open_file(&file, path, 4096, flags) == YALLOC_FILE_BROKEN);
+  assert(!file.header->defragging);
+  yalloc_file_defrag_start(&file);
+  yalloc_file_defrag_commit(&file);
+  assert(!yalloc_close_file(&file));
+  assert(yalloc_open_file(&file, path, 4096, flags) == YALLOC_FILE_CLEAN);
+  assert(!yalloc_close_file(&file));
+
+  // kill processes at random points of their allocations, the pool must always be consistent afterwards
+  for (int round = 0; round < 20; ++round)
+  {
+    pid_t pid = fork();
+    assert(pid >= 0);
+    if (!pid)
+    {
+      assert(yalloc_open_file(&file, path, 4096, flags) >= 0);
+      void * blocks[16] = {0};
+      for (unsigned i = 0;; ++i)
+      {
+        unsigned slot = (i * 7) % 16;
+        yalloc_file_free(&file, blocks[slot]);
+        blocks[slot] = yalloc_file_alloc(&file, 4 + (i * 13) % 200);
+      }
+    }
+
+    usleep(1000 + round * 300);
+    kill(pid, SIGKILL);
+    waitpid(pid, NULL, 0);
+    int result = yalloc_open_file(&file, path, 4096, flags);
+    assert(result == YALLOC_FILE_UNCLEAN || result == YALLOC_FILE_CLEAN); // clean if the child did not open it yet
+    check_file_pool(&file, emptyFree);
+    assert(!yalloc_close_file(&file));
+  }
+
+  unlink(path);
+}
+
+void test_shm()
+{
+  char name[32];
+  snprintf(name, sizeof(name), "/yalloc_test_%d", (int)getpid());
+  unsigned const flags = YALLOC_ADDRESS_ORDERED | YALLOC_UNDO_LOG(64);
+
+  YallocShm a, b;
+  assert(yalloc_shm_open(&a, name, MAX_POOL_SIZE + 1, flags) < 0);
+  assert(yalloc_shm_open(&a, name, 4096, YALLOC_NEXT_FIT | YALLOC_BEST_FIT) < 0); // does not leave an object behind
+  assert(yalloc_shm_open(&a, name, 4096, flags) == YALLOC_SHM_CREATED);
+  assert(yalloc_shm_open(&b, name, 8192, flags) < 0);
+  assert(yalloc_shm_open(&b, name, 4096, YALLOC_ADDRESS_ORDERED) < 0);
+  assert(yalloc_shm_open(&b, name, 4096, flags) == YALLOC_SHM_ATTACHED);
+  assert(a.pool != b.pool); // two mappings of the same pool
+
+  // allocations are passed between mappings by offset
+  size_t freeBytes = yalloc_count_free(a.pool);
+  char * p = yalloc_shm_alloc(&a, 100);
+  strcpy(p, "shared");
+  uint32_t offset = yalloc_shm_offset(&a, p);
+  assert(!strcmp(yalloc_shm_pointer(&b, offset), "shared"));
+  yalloc_shm_free(&b, yalloc_shm_pointer(&b, offset));
+  yalloc_shm_free(&b, NULL);
+  assert(yalloc_count_free(a.pool) == freeBytes);
+  assert(yalloc_shm_offset(&a, NULL) == YALLOC_SHM_NULL && !yalloc_shm_pointer(&a, YALLOC_SHM_NULL));
+  yalloc_shm_close(&b);
+
+  // and between processes
+  int fds[2];
+  assert(!pipe(fds));
+  pid_t pid = fork();
+  assert(pid >= 0);
+  if (!pid)
+  {
+    YallocShm c;
+    if (yalloc_shm_open(&c, name, 4096, flags) != YALLOC_SHM_ATTACHED)
+      _exit(1);
+    char * message = yalloc_shm_alloc(&c, 1000);
+    strcpy(message, "from another process");
+    offset = yalloc_shm_offset(&c, message);
+    _exit(write(fds[1], &offset, sizeof(offset)) != sizeof(offset));
+  }
+
+  int status;
+  assert(read(fds[0], &offset, sizeof(offset)) == sizeof(offset));
+  assert(waitpid(pid, &status, 0) == pid && WIFEXITED(status) && !WEXITSTATUS(status));
+  assert(!strcmp(yalloc_shm_pointer(&a, offset), "from another process"));
+  yalloc_shm_free(&a, yalloc_shm_pointer(&a, offset));
+  assert(yalloc_count_free(a.pool) == freeBytes);
+  close(fds[0]);
+  close(fds[1]);
+
+  // a process that dies with the lock has its changes rolled back
+  pid = fork();
+  assert(pid >= 0);
+  if (!pid)
+  {
+    YallocShm c;
+    if (yalloc_shm_open(&c, name, 4096, flags) != YALLOC_SHM_ATTACHED)
+      _exit(1);
+    yalloc_shm_lock(&c);
+    yalloc_alloc(c.pool, 100);
+    _exit(0);
+  }
+
+  assert(waitpid(pid, &status, 0) == pid && WIFEXITED(status) && !WEXITSTATUS(status));
+  assert(yalloc_shm_lock(&a) == YALLOC_SHM_RECOVERED);
+  assert(yalloc_count_free(a.pool) == freeBytes);
+  yalloc_shm_unlock(&a);
+  assert(yalloc_shm_lock(&a) == YALLOC_SHM_LOCKED);
+  yalloc_shm_unlock(&a);
+
+  // also if it took checkpoints of its own
+  pid = fork();
+  assert(pid >= 0);
+  if (!pid)
+  {
+    YallocShm c;
+    if (yalloc_shm_open(&c, name, 4096, flags) != YALLOC_SHM_ATTACHED)
+      _exit(1);
+    yalloc_shm_lock(&c);
+    yalloc_alloc(c.pool, 100);
+    yalloc_checkpoint(c.pool);
+    yalloc_alloc(c.pool, 100);
+    yalloc_checkpoint(c.pool);
+    _exit(0);
+  }
+
+  assert(waitpid(pid, &status, 0) == pid && WIFEXITED(status) && !WEXITSTATUS(status));
+  assert(yalloc_shm_lock(&a) == YALLOC_SHM_RECOVERED);
+  assert(yalloc_count_free(a.pool) == freeBytes && a.header->checkpoint == 1); // all of its checkpoints are released
+  yalloc_shm_unlock(&a);
+  p = yalloc_shm_alloc(&a, 100);
+  assert(p && !yalloc_shm_free(&a, p) && !yalloc_shm_free(&a, NULL));
+
+  // a pool that can not be rolled back can not be locked anymore
+  for (int overflow = 0; overflow < 2; ++overflow)
+  {
+    unsigned const brokenFlags = overflow ? flags : YALLOC_ADDRESS_ORDERED;
+    YallocShm d;
+    char brokenName[40];
+    snprintf(brokenName, sizeof(brokenName), "%s_broken", name);
+    assert(yalloc_shm_open(&d, brokenName, 4096, brokenFlags) == YALLOC_SHM_CREATED);
+    p = yalloc_shm_alloc(&d, 100);
+    assert(p);
+    pid = fork();
+    assert(pid >= 0);
+    if (!pid)
+    {
+      YallocShm c;
+      if (yalloc_shm_open(&c, brokenName, 4096, brokenFlags) != YALLOC_SHM_ATTACHED)
+        _exit(1);
+      yalloc_shm_lock(&c);
+      for (int i = 0; i < 30; ++i) // overflows the log of 64 entries
+        yalloc_alloc(c.pool, 8);
+      _exit(0);
+    }
+
+    assert(waitpid(pid, &status, 0) == pid && WIFEXITED(status) && !WEXITSTATUS(status));
+    assert(yalloc_shm_lock(&d) == YALLOC_SHM_UNRECOVERABLE);
+    assert(yalloc_shm_lock(&d) == YALLOC_SHM_UNRECOVERABLE); // and stays so
+    assert(!yalloc_shm_alloc(&d, 100) && yalloc_shm_free(&d, p));
+    yalloc_shm_close(&d);
+    assert(!yalloc_shm_unlink(brokenName));
+  }
+
+  yalloc_shm_close(&a);
+  assert(!yalloc_shm_unlink(name));
+  assert(yalloc_shm_unlink(name));
+}
+
+static uint32_t fake_clock()
+{
+  static uint32_t t = 1000;
+  return t += 10;
+}
+
+void test_trace()
+{
+  uint32_t pool[64];
+  uint32_t replayed[64];
+  YallocTraceRecord records[32];
+  YallocTrace trace;
+  yalloc_trace_init_buffer(&trace, records, 32, NULL);
+
+  assert(yalloc_traced_init(&trace, pool, sizeof(pool)) == 0);
+  void * a = yalloc_traced_alloc(&trace, pool, 10);
+  void * b = yalloc_traced_alloc(&trace, pool, 20);
+  void * c = yalloc_traced_alloc(&trace, pool, 30);
+  assert(!yalloc_traced_alloc(&trace, pool, sizeof(pool))); // failed allocations are recorded too
+  yalloc_traced_free(&trace, pool, a);
+  yalloc_traced_free(&trace, pool, NULL);
+  yalloc_traced_defrag_start(&trace, pool);
+  b = yalloc_defrag_address(pool, b);
+  c = yalloc_defrag_address(pool, c);
+  yalloc_traced_defrag_commit(&trace, pool);
+  yalloc_traced_free(&trace, pool, b);
+  void * d = yalloc_traced_alloc(&trace, pool, 4);
+
+  assert(trace.count == 11);
+  assert(records[0].op == YALLOC_TRACE_INIT && records[0].size == sizeof(pool) / 4);
+  assert(records[1].op == YALLOC_TRACE_ALLOC && records[1].size == 3 && records[1].offset == 1);
+  assert(records[4].op == YALLOC_TRACE_ALLOC && records[4].offset == 0);
+  assert(records[1].time == 1 && records[10].time == 10); // sequence numbers when there is no clock
+  assert(!yalloc_trace_dropped(&trace));
+
+  { // replaying reconstructs the exact pool layout
+    assert(yalloc_trace_replay(records, trace.count, replayed, sizeof(replayed)) == trace.count);
+    char * p = yalloc_first_used(pool);
+    char * q = yalloc_first_used(replayed);
+    while (p)
+    {
+      assert(q && p - (char*)pool == q - (char*)replayed);
+      assert(yalloc_block_size(pool, p) == yalloc_block_size(replayed, q));
+      p = yalloc_next_used(pool, p);
+      q = yalloc_next_used(replayed, q);
+    }
+    assert(!q);
+    assert(yalloc_count_free(pool) == yalloc_count_free(replayed));
+    yalloc_deinit(replayed);
+  }
+
+  { // partial replays stop where they are told to and diverging traces are detected
+    assert(yalloc_trace_replay(records, 3, replayed, sizeof(replayed)) == 3);
+    assert(yalloc_first_used(replayed) == (char*)replayed + 4);
+    yalloc_deinit(replayed);
+
+    YallocTraceRecord broken = records[1];
+    broken.offset = 7;
+    assert(yalloc_trace_replay(&broken, 1, replayed, sizeof(replayed)) == 0); // does not start with init
+    records[2].offset = 7;
+    assert(yalloc_trace_replay(records, trace.count, replayed, sizeof(replayed)) == 2);
+    yalloc_deinit(replayed);
+    assert(yalloc_trace_replay(records, 1, replayed, 16) == 0); // buffer too small for the recorded pool
+  }
+
+  yalloc_traced_free(&trace, pool, c);
+  yalloc_traced_free(&trace, pool, d);
+  yalloc_deinit(pool);
+
+  { // a wrapped ring buffer can not be replayed
+    YallocTraceRecord small[4];
+    yalloc_trace_init_buffer(&trace, small, 4, fake_clock);
+    yalloc_traced_init(&trace, pool, sizeof(pool));
+    for (int i = 0; i < 4; ++i)
+      yalloc_traced_free(&trace, pool, yalloc_traced_alloc(&trace, pool, 8));
+
+    assert(trace.count == 9);
+    assert(yalloc_trace_dropped(&trace) == 5);
+    assert(small[1].time > 1000 && small[0].time == small[1].time + 30); // timestamps come from the clock, small[0] holds the newest record
+    assert(yalloc_trace_replay(small, 4, replayed, sizeof(replayed)) == 0);
+
+    FILE * f = tmpfile();
+    assert(yalloc_trace_save(&trace, f) == 4);
+    rewind(f);
+    YallocTraceRecord first;
+    assert(fread(&first, sizeof(first), 1, f) == 1);
+    assert(first.op == YALLOC_TRACE_ALLOC); // oldest surviving record comes first
+    fclose(f);
+    yalloc_deinit(pool);
+  }
+
+  { // recording to a file
+    FILE * f = tmpfile();
+    yalloc_trace_init_file(&trace, f, NULL);
+    assert(yalloc_traced_init(&trace, pool, 8)); // failed initialization
+    assert(yalloc_traced_init(&trace, pool, sizeof(pool)) == 0);
+    yalloc_traced_free(&trace, pool, yalloc_traced_alloc(&trace, pool, 8));
+    assert(!yalloc_trace_dropped(&trace));
+    assert(yalloc_trace_save(&trace, stdout) == 0); // nothing buffered
+    rewind(f);
+    YallocTraceRecord fromFile[4];
+    assert(fread(fromFile, sizeof(YallocTraceRecord), 4, f) == 4);
+    fclose(f);
+    assert(yalloc_trace_replay(fromFile, 4, replayed, sizeof(replayed)) == 1); // replay of a failed initialization ends early
+    assert(yalloc_trace_replay(fromFile + 1, 3, replayed, sizeof(replayed)) == 3);
+    yalloc_deinit(replayed);
+    yalloc_deinit(pool);
+  }
+
+  { // the replayed pool has the size of the traced one, also if that was not a multiple of 4
+    yalloc_trace_init_buffer(&trace, records, 32, NULL);
+    assert(yalloc_traced_init(&trace, pool, sizeof(pool) - 7) == 0);
+    assert(records[0].size == sizeof(pool) / 4 - 2);
+    yalloc_traced_alloc(&trace, pool, 8);
+    assert(yalloc_trace_replay(records, trace.count, replayed, sizeof(replayed)) == trace.count);
+    assert(yalloc_count_free(replayed) == yalloc_count_free(pool));
+    yalloc_deinit(replayed);
+    yalloc_deinit(pool);
+  }
+
+  { // the replay creates a pool with the recorded flags
+    yalloc_trace_init_buffer(&trace, records, 32, NULL);
+    assert(yalloc_traced_init_ex(&trace, pool, sizeof(pool), 0x8000)); // unknown flag
+    assert(records[0].flags == 0x8000 && records[0].result);
+    assert(yalloc_trace_replay(records, 1, replayed, sizeof(replayed)) == 1);
+
+    yalloc_trace_init_buffer(&trace, records, 32, NULL);
+    assert(yalloc_traced_init_ex(&trace, pool, sizeof(pool), YALLOC_ADDRESS_ORDERED) == 0);
+    assert(records[0].flags == YALLOC_ADDRESS_ORDERED);
+    void * x[4];
+    for (int i = 0; i < 4; ++i)
+      x[i] = yalloc_traced_alloc(&trace, pool, 8);
+    yalloc_traced_free(&trace, pool, x[2]);
+    yalloc_traced_free(&trace, pool, x[0]);
+    yalloc_traced_alloc(&trace, pool, 8); // address order takes x[0], LIFO would take x[2]
+    assert(records[trace.count - 1].offset == records[1].offset);
+    assert(yalloc_trace_replay(records, trace.count, replayed, sizeof(replayed)) == trace.count);
+    assert(yalloc_count_free(replayed) == yalloc_count_free(pool));
+    yalloc_deinit(replayed);
+
+    records[0].flags = 0;
+    assert(yalloc_trace_replay(records, trace.count, replayed, sizeof(replayed)) == 1); // offsets differ without the control block
+    yalloc_deinit(replayed);
+    yalloc_deinit(pool);
+  }
+}
+
 int main()
 {
   test_used_block_iteration();
@@ -400,6 +2552,28 @@ int main()
   test_free_coverage();
   test_defragmentation_coverage();
   test_defragmentation();
+  test_offsets();
+  test_trace();
+  test_address_ordered();
+  test_next_fit();
+  test_alloc_hint();
+  test_adaptive();
+  test_slab();
+  test_slab_limit();
+  test_arena();
+  test_checkpoint();
+  test_tags();
+  test_free_all();
+  test_calloc();
+  test_bitmap();
+  test_out_of_band();
+  test_containers();
+  test_vector_limit();
+  test_mt();
+  test_striped();
+  test_persist();
+  test_persist_recovery();
+  test_shm();
 
   return 0;
 }
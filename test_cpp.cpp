@@ -0,0 +1,251 @@
+#include "yalloc/yalloc.h"
+#include "yalloc/yalloc_pmr.hpp"
+#include "yalloc/yalloc_static_pool.hpp"
+
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <list>
+#include <map>
+#include <memory_resource>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+/*
+Tests the C++ headers of yalloc (and that the C headers can be used from C++).
+*/
+
+static void test_pool_resource()
+{
+  alignas(64) static std::uint32_t pool[MAX_POOL_SIZE / 4];
+  assert(!yalloc_init(pool, sizeof(pool)));
+  std::size_t freeBytes = yalloc_count_free(pool);
+  {
+    yalloc::pool_resource resource(pool);
+    assert(resource.pool() == pool);
+
+    std::pmr::vector<int> v(&resource);
+    for (int i = 0; i < 1000; ++i)
+      v.push_back(i);
+    for (int i = 0; i < 1000; ++i)
+      assert(v[i] == i);
+    assert((char*)v.data() > (char*)pool && (char*)v.data() < (char*)pool + sizeof(pool));
+
+    std::pmr::unordered_map<int, std::pmr::string> m(&resource);
+    for (int i = 0; i < 100; ++i)
+      m.emplace(i, std::pmr::string(40, (char)('a' + i % 26)));
+    for (int i = 0; i < 100; i += 2)
+      m.erase(i);
+    assert(m.size() == 50 && m.at(51) == std::pmr::string(40, 'z'));
+
+    // bigger alignments than the pool provides
+    for (std::size_t alignment = 1; alignment <= 64; alignment *= 2)
+    {
+      void * p = resource.allocate(24, alignment);
+      assert((std::uintptr_t)p % alignment == 0);
+      resource.deallocate(p, 24, alignment);
+    }
+    void * empty = resource.allocate(0);
+    resource.deallocate(empty, 0);
+
+    // the pool is not endless
+    bool thrown = false;
+    try
+    {
+      (void)resource.allocate(sizeof(pool));
+    }
+    catch (std::bad_alloc const &)
+    {
+      thrown = true;
+    }
+    assert(thrown);
+    thrown = false;
+    std::size_t volatile huge = SIZE_MAX; // overflows when the alignment is added (volatile keeps the compiler from warning about it)
+    try
+    {
+      (void)resource.allocate(huge, 16);
+    }
+    catch (std::bad_alloc const &)
+    {
+      thrown = true;
+    }
+    assert(thrown);
+
+    yalloc::pool_resource same(pool), other(pool + 2048);
+    assert(resource.is_equal(same) && !resource.is_equal(other) && !resource.is_equal(*std::pmr::new_delete_resource()));
+  }
+  assert(yalloc_count_free(pool) == freeBytes);
+  yalloc_deinit(pool);
+}
+
+static void test_scratch_resource()
+{
+  static std::uint32_t pool[4096];
+  assert(!yalloc_init_ex(pool, sizeof(pool), YALLOC_ADDRESS_ORDERED));
+  std::size_t freeBytes = yalloc_count_free(pool);
+  {
+    yalloc::scratch_resource scratch(pool, 128);
+    {
+      std::pmr::vector<std::pmr::string> words(&scratch);
+      for (int i = 0; i < 50; ++i)
+        words.emplace_back(30, 'x');
+    }
+    assert(yalloc_count_free(pool) < freeBytes); // freeing does nothing
+    scratch.release();
+    assert(yalloc_count_free(pool) == freeBytes);
+
+    // caching per size on top of the pool
+    yalloc::pool_resource resource(pool);
+    std::pmr::unsynchronized_pool_resource cache(&resource);
+    std::pmr::list<int> l(&cache);
+    for (int i = 0; i < 100; ++i)
+      l.push_back(i);
+    assert(l.size() == 100);
+  }
+  assert(yalloc_count_free(pool) == freeBytes);
+  yalloc_deinit(pool);
+}
+
+struct alignas(16) Vec4
+{
+  float v[4];
+};
+
+static void test_allocator()
+{
+  static std::uint32_t pool[4096];
+  assert(!yalloc_init(pool, sizeof(pool)));
+  std::size_t freeBytes = yalloc_count_free(pool);
+  {
+    yalloc::allocator<int> a(pool);
+    std::vector<int, yalloc::allocator<int>> v(a);
+    for (int i = 0; i < 100; ++i)
+      v.push_back(i);
+
+    using Map = std::map<int, int, std::less<int>, yalloc::allocator<std::pair<int const, int>>>;
+    Map m{Map::allocator_type(a)};
+    for (int i = 0; i < 100; ++i)
+      m[i] = i * i;
+    assert(m[9] == 81);
+
+    std::vector<Vec4, yalloc::allocator<Vec4>> aligned{yalloc::allocator<Vec4>(a)};
+    for (int i = 0; i < 10; ++i)
+    {
+      aligned.push_back(Vec4{});
+      assert((std::uintptr_t)aligned.data() % 16 == 0);
+    }
+
+    yalloc::allocator<char> b(a), c(pool + 2048);
+    assert(a == b && !(a != b) && a != c);
+
+    bool thrown = false;
+    try
+    {
+      (void)a.allocate(SIZE_MAX / 2);
+    }
+    catch (std::bad_alloc const &)
+    {
+      thrown = true;
+    }
+    assert(thrown);
+  }
+  assert(yalloc_count_free(pool) == freeBytes);
+  yalloc_deinit(pool);
+}
+
+struct Node
+{
+  Node(int value, YallocOffset next) : value(value), next(next) {}
+  int value;
+  YallocOffset next; // pointers would need 64bit alignment
+};
+
+struct Throwing
+{
+  Throwing() { throw std::runtime_error("constructor"); }
+  char padding[6];
+};
+
+static void test_static_pool()
+{
+  using Small = yalloc::static_pool<1000>;
+  using Big = yalloc::static_pool<MAX_POOL_SIZE, 16>;
+  static_assert(Small::size == 1000 && Big::size == MAX_POOL_SIZE);
+  static_assert(std::is_same_v<Small::offset_type, std::uint8_t> && std::is_same_v<Big::offset_type, YallocOffset>);
+  static_assert(Small::granule_shift == 2 && Big::granule_shift == 4);
+  static_assert(Small::round(1) == 4 && Small::round(8) == 8 && Big::round(1) == 16 && Big::round(17) == 32);
+  static_assert(yalloc::static_pool<23>::size == 20);
+
+  static Big big;
+  std::size_t freeBytes = big.count_free();
+  assert(!big.allocate(0) && !big.allocate(MAX_POOL_SIZE + 1));
+  void * p = big.allocate(1);
+  assert(yalloc_block_size(big.pool(), p) == 16);
+  void * q = big.allocate<20>();
+  assert(yalloc_block_size(big.pool(), q) == 32);
+  big.deallocate(p);
+  big.deallocate(q);
+
+  // offsets are computed inline, the same way as by the C functions
+  Node * list = nullptr;
+  for (int i = 0; i < 10; ++i)
+  {
+    list = big.make<Node>(i, big.to_offset(list));
+    assert(big.to_offset(list) == yalloc_ptr_to_off(big.pool(), list));
+  }
+  Node * second = static_cast<Node*>(big.from_offset(list->next));
+  assert(list->value == 9 && second->value == 8);
+  assert(yalloc_block_size(big.pool(), list) == 16);
+  assert(big.from_offset(big.to_offset(nullptr)) == nullptr);
+
+  while (list)
+  {
+    Node * next = static_cast<Node*>(big.from_offset(list->next));
+    big.destroy(list);
+    list = next;
+  }
+  big.destroy<Node>(nullptr);
+
+  bool thrown = false;
+  try
+  {
+    big.make<Throwing>();
+  }
+  catch (std::runtime_error const &)
+  {
+    thrown = true;
+  }
+  assert(thrown);
+  assert(big.count_free() == freeBytes);
+
+  // a full pool returns nullptr
+  Small small(YALLOC_ADDRESS_ORDERED);
+  while (small.make<Node>(0, YALLOC_NULL_OFFSET))
+    ;
+  assert(!small.allocate<4>());
+
+  thrown = false;
+  try
+  {
+    Small broken(YALLOC_NEXT_FIT | YALLOC_BEST_FIT);
+  }
+  catch (std::invalid_argument const &)
+  {
+    thrown = true;
+  }
+  assert(thrown);
+}
+
+int main()
+{
+  test_pool_resource();
+  test_scratch_resource();
+  test_allocator();
+  test_static_pool();
+  std::printf("All fine!\n");
+  return 0;
+}
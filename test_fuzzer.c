@@ -5,21 +5,6 @@
 #include <memory.h>
 #include <assert.h>
 
-typedef struct
-{
-  uint16_t size;
-  uint16_t tStart;
-  uint16_t tDuration;
-} RawStep;
-
-typedef struct
-{
-  void * p;
-  uint32_t size;
-  uint32_t tStart;
-  uint32_t tEnd;
-} Step;
-
 size_t ceil4(size_t i)
 {
   while (i % 4)
@@ -33,11 +18,12 @@ void fuzzerFunc(const uint8_t * data, size_t size)
   /*
   This test function is given a bunch of random bytes. Here is how we convert that to a sequence of free/alloc calls:
 
-  Interpret the random blob as a pool size (first 4 bytes) followed by a vector of triplets that represent allocations, their parameters are:
+  Interpret the random blob as a pool size (first 4 bytes, the bits that exceed the maximum pool size select the flags
+  for yalloc_init_ex()) followed by a vector of triplets that represent allocations, their parameters are:
 
    - size of the allocation
    - time when to do the allocation
-   - duration after which the allocation will be freed
+   - duration after which the allocation will be freed (allocations with long durations are done with YALLOC_LONG_LIVED)
 
   This is valid data for all possible inputs.
   Its structure should give the fuzzer a good chance to mutate/crossover the input vectors in a meaningful way to explore all the code paths.
@@ -51,20 +37,24 @@ void fuzzerFunc(const uint8_t * data, size_t size)
   }
 
   // initialize a pool
-  if (size < 4)
-    return;
-
   uint32_t poolSize;
-  memcpy(&poolSize, data, 4);
-  data += 4;
-  size -= 4;
+  unsigned flags;
+  if (decode_pool(&data, &size, &poolSize, &flags))
+    return;
 
-  poolSize %= MAX_POOL_SIZE; // Map the 32bit input size to a valid pool size
+  size_t controlSize = flags ? sizeof(Control) : 0;
+  if (flags & YALLOC_ADDRESS_ORDERED)
+  { // the first free block of every address range (see MAX_FREE_LIST_BUCKETS)
+    unsigned shift = MIN_BUCKET_SHIFT;
+    while ((poolSize / 4 * 2 >> shift) >= MAX_FREE_LIST_BUCKETS)
+      ++shift;
+    controlSize += ((poolSize / 4 * 2 >> shift) + 2) / 2 * 4;
+  }
 
   uint32_t pool[ceil4(poolSize) / 4];
-  if (yalloc_init(pool, poolSize))
+  if (yalloc_init_ex(pool, poolSize, flags))
   {
-    assert(poolSize < sizeof(Header) * 3);
+    assert(poolSize < controlSize + sizeof(Header) * (flags & YALLOC_OUT_OF_BAND ? 5 : 3)); // out-of-band metadata takes 12 bytes in front of the two granules
     return;
   }
 
@@ -77,7 +67,10 @@ void fuzzerFunc(const uint8_t * data, size_t size)
   }
 
   uint32_t freeBytes = yalloc_count_free(pool); // counts the bytes that the pool claims to be free to allocate user data
-  assert(freeBytes == (poolSize / 4) * 4 - 2 * sizeof(Header));
+  if (flags & YALLOC_BITMAP)
+    assert(freeBytes <= (poolSize / 4) * 4 - 2 * sizeof(Header) - controlSize); // the bitmap takes some of the space
+  else
+    assert(freeBytes == (poolSize / 4) * 4 - 2 * sizeof(Header) - controlSize);
 
   int numAllocs = size / sizeof(RawStep);
 
@@ -89,45 +82,10 @@ void fuzzerFunc(const uint8_t * data, size_t size)
     return;
   }
 
-  RawStep rawSteps[numAllocs];
-  memcpy(rawSteps, data, numAllocs * sizeof(RawStep)); // copy the random bits into the "raw step vector" for which all possible values result in a meaningful input
-
   Step allocs[numAllocs];
-
   Step * starts[numAllocs + 1]; // allocations, sorted by allocation-time
   Step * ends[numAllocs + 1]; // allocations, sorted by deallocation-time
-
-  // translate the random input to some test-data
-  for (int i = 0; i < numAllocs; ++i)
-  {
-    starts[i] = ends[i] = &allocs[i]; // initialize starts/ends unsorted
-    allocs[i].p = NULL;
-    allocs[i].size = rawSteps[i].size;
-    allocs[i].tStart = rawSteps[i].tStart;
-    allocs[i].tEnd = rawSteps[i].tStart + rawSteps[i].tDuration;
-  }
-
-  // make starts/ends to NULL-terminated
-  starts[numAllocs] = NULL;
-  ends[numAllocs] = NULL;
-
-  // sort starts/ends by their time-stamps
-  for (int i = 1; i < numAllocs; ++i)
-  {
-    for (int j = i; j && starts[j-1]->tStart > starts[j]->tStart; --j)
-    {
-      Step * tmp = starts[j-1];
-      starts[j-1] = starts[j];
-      starts[j] = tmp;
-    }
-
-    for (int j = i; j && ends[j-1]->tEnd > ends[j]->tEnd; --j)
-    {
-      Step * tmp = ends[j-1];
-      ends[j-1] = ends[j];
-      ends[j] = tmp;
-    }
-  }
+  decode_steps(data, numAllocs, allocs, starts, ends); // translate the random input to some test-data
 
   int dummy = 666;
   void * freed = &dummy; // sentinel that freed pointers will set to (so i can detect early if i messed up the test and do double frees by accident)
@@ -142,7 +100,7 @@ void fuzzerFunc(const uint8_t * data, size_t size)
     {
       Step * x = *curStart;
       assert(!x->p);
-      x->p = checked_alloc(pool, x->size);
+      x->p = x->tEnd - x->tStart >= 0x8000 ? checked_alloc_hint(pool, x->size, YALLOC_LONG_LIVED) : checked_alloc(pool, x->size);
       ++curStart;
 
       size_t newFreeBytes = yalloc_count_free(pool);
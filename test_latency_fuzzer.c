@@ -0,0 +1,314 @@
+#include "yalloc/yalloc.h"
+#include "yalloc/yalloc_internals.h"
+#include "test_util.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#ifndef YALLOC_WORK_COUNTERS
+#error "This test must be compiled with YALLOC_WORK_COUNTERS defined"
+#endif
+
+/*
+This fuzz target searches for worst case sequences instead of correctness
+failures. It uses the same input format as test_fuzzer.c (pool size followed by
+size/start/duration triplets), replays it and measures the work (see
+YALLOC_WORK_COUNTERS) that every single yalloc_alloc(), yalloc_free() and
+defragmentation did.
+
+The maximum work of every operation is reported to libFuzzer as feature via
+extra counters, scaled relative to the size of the pool. So inputs that make an
+operation more expensive than ever seen reach a new feature and are kept in the
+corpus. This turns the coverage guided search into a maximization of the work.
+
+Every input that sets a new worst case (per process) is written to
+corpus_latency_worst/ (or $YALLOC_WORST_DIR) with the metric and the cost in its
+name (for example "alloc-visits-123-<hash>"). Such files can be used as
+latency regression tests: Run them with "-check" and the test fails if any
+operation needs more work than when the file was saved.
+*/
+
+enum
+{
+  METRIC_ALLOC_VISITS, // free-list nodes visited by one yalloc_alloc()
+  METRIC_FREE_VISITS, // free-list nodes touched by one yalloc_free()
+  METRIC_DEFRAG_VISITS, // blocks visited by one defragmentation (start + commit)
+  METRIC_DEFRAG_BYTES, // bytes moved by one defragmentation
+  NUM_METRICS
+};
+
+static char const * metricNames[NUM_METRICS] = {"alloc-visits", "free-visits", "defrag-visits", "defrag-bytes"};
+
+#define LEVELS 64
+
+// libFuzzer treats every nonzero byte of this section as a feature
+__attribute__((used, section("__libfuzzer_extra_counters")))
+static uint8_t extraCounters[NUM_METRICS * LEVELS];
+
+static size_t worstSeen[NUM_METRICS]; // worst costs of this process
+static size_t worstOfInput[NUM_METRICS]; // worst costs of the current input
+
+static void report(int metric, size_t cost, size_t maxCost)
+{
+  if (cost > worstOfInput[metric])
+    worstOfInput[metric] = cost;
+
+  size_t level = maxCost ? cost * (LEVELS - 1) / maxCost : 0;
+  if (level >= LEVELS)
+    level = LEVELS - 1;
+
+  extraCounters[metric * LEVELS + level] = 1;
+}
+
+static void defrag(void * pool, Step * allocs, int numAllocs, void * freed, size_t maxBlocks, size_t poolSize)
+{
+  YallocWorkCounters before = yalloc_work;
+  yalloc_defrag_start(pool);
+
+  for (int i = 0; i < numAllocs; ++i)
+  {
+    Step * x = &allocs[i];
+    if (x->p && x->p != freed)
+      x->p = yalloc_defrag_address(pool, x->p);
+  }
+
+  yalloc_defrag_commit(pool);
+  report(METRIC_DEFRAG_VISITS, yalloc_work.blockVisits - before.blockVisits, 2 * maxBlocks);
+  report(METRIC_DEFRAG_BYTES, yalloc_work.bytesMoved - before.bytesMoved, poolSize);
+}
+
+// Replays an input and stores the worst cost per metric in worstOfInput.
+static void run(const uint8_t * data, size_t size)
+{
+  memset(worstOfInput, 0, sizeof(worstOfInput));
+
+  uint32_t poolSize;
+  unsigned flags; // not used, the worst cases are searched for plain pools
+  if (decode_pool(&data, &size, &poolSize, &flags))
+    return;
+
+  uint32_t pool[(poolSize + 3) / 4 + 1];
+  if (yalloc_init(pool, poolSize))
+    return;
+
+  size_t maxBlocks = poolSize / 8; // the smallest block is 8 bytes (header + 4 bytes payload)
+
+  int numAllocs = size / sizeof(RawStep);
+  if (!numAllocs)
+  {
+    yalloc_deinit(pool);
+    return;
+  }
+
+  Step allocs[numAllocs];
+  Step * starts[numAllocs + 1];
+  Step * ends[numAllocs + 1];
+  decode_steps(data, numAllocs, allocs, starts, ends);
+
+  int dummy = 666;
+  void * freed = &dummy;
+
+  Step ** curStart = starts;
+  Step ** curEnd = ends;
+  uint32_t t = 0;
+  for (;;)
+  {
+    while (*curStart && (*curStart)->tStart == t)
+    {
+      Step * x = *curStart;
+      size_t before = yalloc_work.freeListVisits;
+      x->p = yalloc_alloc(pool, x->size);
+      report(METRIC_ALLOC_VISITS, yalloc_work.freeListVisits - before, maxBlocks);
+      ++curStart;
+
+      if (!x->p)
+        defrag(pool, allocs, numAllocs, freed, maxBlocks, poolSize);
+    }
+
+    while (*curEnd && (*curEnd)->tEnd == t)
+    {
+      Step * x = *curEnd;
+      size_t before = yalloc_work.freeListVisits;
+      yalloc_free(pool, x->p);
+      report(METRIC_FREE_VISITS, yalloc_work.freeListVisits - before, maxBlocks);
+      x->p = freed;
+      ++curEnd;
+    }
+
+    uint32_t newT;
+    if (*curStart && *curEnd)
+    {
+      uint32_t a = (*curStart)->tStart;
+      uint32_t b = (*curEnd)->tEnd;
+      newT = a < b ? a : b;
+    }
+    else if (*curEnd)
+      newT = (*curEnd)->tEnd;
+    else
+      break;
+
+    t = newT;
+  }
+
+  yalloc_deinit(pool);
+}
+
+static void save_worst(const uint8_t * data, size_t size, int metric)
+{
+  char const * dir = getenv("YALLOC_WORST_DIR");
+  if (!dir)
+    dir = "corpus_latency_worst";
+
+  uint32_t hash = 2166136261u; // FNV-1a, only used to make file names unique
+  for (size_t i = 0; i < size; ++i)
+    hash = (hash ^ data[i]) * 16777619u;
+
+  char fn[512];
+  snprintf(fn, sizeof(fn), "%s/%s-%zu-%08x", dir, metricNames[metric], worstOfInput[metric], (unsigned)hash);
+  FILE * f = fopen(fn, "wb");
+  if (!f)
+    return; // the directory does not exist, so the caller is not interested in the worst cases
+
+  fwrite(data, size, 1, f);
+  fclose(f);
+}
+
+static void fuzzerFunc(const uint8_t * data, size_t size)
+{
+  run(data, size);
+
+  for (int m = 0; m < NUM_METRICS; ++m)
+  {
+    if (worstOfInput[m] > worstSeen[m])
+    {
+      worstSeen[m] = worstOfInput[m];
+      save_worst(data, size, m);
+    }
+  }
+}
+
+#ifdef USE_LIBFUZZER
+int LLVMFuzzerTestOneInput(const uint8_t * data, size_t size)
+{
+  fuzzerFunc(data, size);
+  return 0;
+}
+#else
+
+static uint8_t * read_file(char const * fn, size_t * size)
+{
+  FILE * f = fopen(fn, "rb");
+  if (!f)
+    return NULL;
+
+  uint8_t * buf = NULL;
+  if (!fseek(f, 0, SEEK_END))
+  {
+    long n = ftell(f);
+    if (n >= 0 && !fseek(f, 0, SEEK_SET))
+    {
+      buf = (uint8_t*)malloc(n + 1);
+      if (buf && fread(buf, 1, n, f) != (size_t)n)
+      {
+        free(buf);
+        buf = NULL;
+      }
+      *size = n;
+    }
+  }
+  fclose(f);
+  return buf;
+}
+
+/*
+This program supports three modes:
+
+  -n N
+
+  Runs N testcases from /dev/urandom and prints the worst costs that where found.
+
+  -check <file1> <file2> ...
+
+  Runs files that where saved as worst cases and fails if an operation needs
+  more work than encoded in the file name (latency regression test).
+
+  <file1> <file2> ...
+
+  Runs every file and prints its worst costs.
+*/
+int main(int argc, char * argv[])
+{
+  if (argc == 3 && !strcmp(argv[1], "-n"))
+  {
+    int n = atoi(argv[2]);
+    FILE * f = fopen("/dev/urandom", "rb");
+    if (!f)
+      return -1;
+
+    uint8_t buf[64];
+    for (int i = 0; i < n; ++i)
+    {
+      uint16_t size;
+      if (fread(&size, 2, 1, f) != 1)
+        return -1;
+
+      size %= sizeof(buf);
+      if (size && fread(buf, size, 1, f) != 1)
+        return -1;
+
+      fuzzerFunc(buf, size);
+    }
+    fclose(f);
+
+    for (int m = 0; m < NUM_METRICS; ++m)
+      printf("worst %s: %zu\n", metricNames[m], worstSeen[m]);
+
+    printf("All fine!\n");
+    return 0;
+  }
+
+  int check = argc > 1 && !strcmp(argv[1], "-check");
+  int failed = 0;
+  for (int iarg = check ? 2 : 1; iarg < argc; ++iarg)
+  {
+    char const * fn = argv[iarg];
+    size_t size = 0;
+    uint8_t * buf = read_file(fn, &size);
+    if (!buf)
+      return -1;
+
+    run(buf, size);
+    free(buf);
+
+    char const * base = strrchr(fn, '/');
+    base = base ? base + 1 : fn;
+
+    for (int m = 0; m < NUM_METRICS; ++m)
+    {
+      size_t nameLen = strlen(metricNames[m]);
+      if (check)
+      {
+        if (strncmp(base, metricNames[m], nameLen) || base[nameLen] != '-')
+          continue;
+
+        size_t limit = strtoul(base + nameLen + 1, NULL, 10);
+        if (worstOfInput[m] > limit)
+        {
+          printf("%s: %s needs %zu, limit is %zu\n", fn, metricNames[m], worstOfInput[m], limit);
+          failed = 1;
+        }
+      }
+      else
+        printf("%s: %s %zu\n", fn, metricNames[m], worstOfInput[m]);
+    }
+  }
+
+  if (failed)
+    return 1;
+
+  printf("All fine!\n");
+  return 0;
+}
+#endif
@@ -27,10 +27,10 @@ checked_alloc with raw yalloc_alloc() in a pool (because those "manually" alloca
 memory or have content that confuses the checking-logic!).
 */
 
-static void * checked_alloc(void * pool, size_t size)
+// fills a block that was just allocated with its pseudorandom sequence
+static inline void * checked_fill(void * pool, void * p, size_t size)
 {
   static uint16_t allocSeed = 0xabcd;
-  void * p = yalloc_alloc(pool, size);
   if (p)
   {
     size_t allocSize = yalloc_block_size(pool, p);
@@ -48,7 +48,17 @@ static void * checked_alloc(void * pool, size_t size)
   return p;
 }
 
-static void checked_free(void * pool, void * p)
+static inline void * checked_alloc(void * pool, size_t size)
+{
+  return checked_fill(pool, yalloc_alloc(pool, size), size);
+}
+
+static inline void * checked_alloc_hint(void * pool, size_t size, unsigned hint)
+{
+  return checked_fill(pool, yalloc_alloc_hint(pool, size, hint), size);
+}
+
+static inline void checked_free(void * pool, void * p)
 {
   if (p)
   {
@@ -73,4 +83,86 @@ static void checked_free(void * pool, void * p)
   yalloc_free(pool, p);
 }
 
+/*
+The fuzzers (test_fuzzer.c and test_latency_fuzzer.c) interpret their input as
+a pool size (first 4 bytes) followed by RawSteps, which describe allocations
+by their size, the time when they are done and the duration after which they
+are freed. Every input is valid.
+*/
+
+typedef struct
+{
+  uint16_t size;
+  uint16_t tStart;
+  uint16_t tDuration;
+} RawStep;
+
+typedef struct
+{
+  void * p;
+  uint32_t size;
+  uint32_t tStart;
+  uint32_t tEnd;
+} Step;
+
+// Takes the pool size from the front of a fuzzer input. The bits that exceed the maximum pool size select the flags
+// for yalloc_init_ex() (reduced to a supported combination). Returns nonzero if the input is too short.
+static inline int decode_pool(const uint8_t ** data, size_t * size, uint32_t * poolSize, unsigned * flags)
+{
+  if (*size < 4)
+    return -1;
+
+  memcpy(poolSize, *data, 4);
+  *data += 4;
+  *size -= 4;
+
+  *flags = (*poolSize / MAX_POOL_SIZE) & (YALLOC_ADDRESS_ORDERED | YALLOC_NEXT_FIT | YALLOC_BEST_FIT | YALLOC_ADAPTIVE | YALLOC_BITMAP | YALLOC_OUT_OF_BAND);
+  if (*flags & YALLOC_NEXT_FIT)
+    *flags &= ~YALLOC_BEST_FIT; // can not be combined
+  if (*flags & YALLOC_BITMAP)
+    *flags &= YALLOC_BITMAP | YALLOC_OUT_OF_BAND; // the bitmap engine does not combine with the free list policies
+  else
+    *flags &= ~YALLOC_OUT_OF_BAND; // only the bitmap engine supports out-of-band metadata
+
+  *poolSize %= MAX_POOL_SIZE; // Map the 32bit input size to a valid pool size
+  return 0;
+}
+
+// Translates the RawSteps of a fuzzer input to allocations. starts/ends (with space for numAllocs + 1 entries) receive
+// the allocations sorted by allocation-time/deallocation-time and are NULL-terminated.
+static inline void decode_steps(const uint8_t * data, int numAllocs, Step * allocs, Step ** starts, Step ** ends)
+{
+  for (int i = 0; i < numAllocs; ++i)
+  {
+    RawStep raw;
+    memcpy(&raw, data + i * sizeof(RawStep), sizeof(RawStep)); // the input has no alignment
+    starts[i] = ends[i] = &allocs[i]; // initialize starts/ends unsorted
+    allocs[i].p = NULL;
+    allocs[i].size = raw.size;
+    allocs[i].tStart = raw.tStart;
+    allocs[i].tEnd = raw.tStart + raw.tDuration;
+  }
+
+  starts[numAllocs] = NULL;
+  ends[numAllocs] = NULL;
+
+  // sort starts/ends by their time-stamps
+  for (int i = 1; i < numAllocs; ++i)
+  {
+    for (int j = i; j && starts[j-1]->tStart > starts[j]->tStart; --j)
+    {
+      Step * tmp = starts[j-1];
+      starts[j-1] = starts[j];
+      starts[j] = tmp;
+    }
+
+    for (int j = i; j && ends[j-1]->tEnd > ends[j]->tEnd; --j)
+    {
+      Step * tmp = ends[j-1];
+      ends[j-1] = ends[j];
+      ends[j] = tmp;
+    }
+  }
+}
+
 #endif // TEST_UTIL_H
@@ -0,0 +1,294 @@
+#include "../yalloc/yalloc.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+/*
+Computes the minimum pool size that serves an allocation trace without a single
+failing allocation.
+
+The peak of live bytes is only a lower bound because first fit allocation
+fragments the pool, so this tool simulates the trace on pools of different
+sizes and bisects the smallest one that never fails. It does so without
+defragmentation, with defragmentation whenever an allocation fails (the
+allocation is retried afterwards) and optionally with defragmentation after
+every N operations.
+
+  yalloc_plan [-raw] [-flags F] [-defrag-every N] [-current SIZE] <trace-file>
+
+The trace consists of allocations described by size/start/duration triplets
+(like test_fuzzer.c models them). The block is allocated at time "start" and
+freed at "start + duration", allocations are done before frees that happen at
+the same time. By default the file is text with one triplet per line, with
+-raw it is an array of native endian uint16_t triplets (the RawStep format of
+test_fuzzer.c without the leading pool size). -flags simulates pools that are
+created by yalloc_init_ex() with the given flags (decimal or 0x hex), the
+result then includes their metadata.
+
+NOTE: Failure is not strictly monotonic in the pool size for first fit
+allocation (a bigger pool may split blocks differently), so the result is the
+smallest size the bisection found to work. It is always verified by a
+simulation.
+
+Build it with (NDEBUG because the internal validation makes the simulation
+very slow):
+
+  gcc -O2 -DNDEBUG tools/yalloc_plan.c yalloc/yalloc.c -o yalloc_plan
+*/
+
+typedef struct
+{
+  uint32_t size;
+  uint32_t tStart;
+  uint32_t tEnd;
+  void * p;
+} Alloc;
+
+typedef struct
+{
+  Alloc * allocs;
+  int numAllocs;
+  Alloc ** starts; // sorted by tStart
+  Alloc ** ends; // sorted by tEnd
+} Trace;
+
+#define DEFRAG_NEVER 0
+#define DEFRAG_ON_FAILURE 1
+
+static uint32_t pool[MAX_POOL_SIZE / 4];
+
+static int cmp_start(void const * a, void const * b)
+{
+  uint32_t x = (*(Alloc * const *)a)->tStart;
+  uint32_t y = (*(Alloc * const *)b)->tStart;
+  return x < y ? -1 : x > y;
+}
+
+static int cmp_end(void const * a, void const * b)
+{
+  uint32_t x = (*(Alloc * const *)a)->tEnd;
+  uint32_t y = (*(Alloc * const *)b)->tEnd;
+  return x < y ? -1 : x > y;
+}
+
+static void defrag(Trace * trace)
+{
+  yalloc_defrag_start(pool);
+  for (int i = 0; i < trace->numAllocs; ++i)
+  {
+    if (trace->allocs[i].p)
+      trace->allocs[i].p = yalloc_defrag_address(pool, trace->allocs[i].p);
+  }
+  yalloc_defrag_commit(pool);
+}
+
+// Runs the trace on a pool of the given size. Returns 1 if no allocation failed.
+static int simulate(Trace * trace, size_t poolSize, unsigned flags, int defragMode, unsigned defragEvery)
+{
+  if (yalloc_init_ex(pool, poolSize, flags))
+    return 0;
+
+  for (int i = 0; i < trace->numAllocs; ++i)
+    trace->allocs[i].p = NULL;
+
+  int ok = 1;
+  unsigned ops = 0;
+  int s = 0;
+  int e = 0;
+  while (ok && e < trace->numAllocs)
+  {
+    // process all allocations that happen before the next free (allocations first if they happen at the same time)
+    if (s < trace->numAllocs && trace->starts[s]->tStart <= trace->ends[e]->tEnd)
+    {
+      Alloc * a = trace->starts[s++];
+      a->p = yalloc_alloc(pool, a->size);
+      if (!a->p && a->size)
+      {
+        if (defragMode == DEFRAG_ON_FAILURE)
+        {
+          defrag(trace);
+          a->p = yalloc_alloc(pool, a->size);
+        }
+
+        ok = a->p != NULL;
+      }
+    }
+    else
+    {
+      Alloc * a = trace->ends[e++];
+      yalloc_free(pool, a->p);
+      a->p = NULL;
+    }
+
+    if (defragEvery && ++ops % defragEvery == 0)
+      defrag(trace);
+  }
+
+  yalloc_deinit(pool);
+  return ok;
+}
+
+// Bisects the smallest pool size (multiple of 4) in [lo, MAX_POOL_SIZE] for which the simulation succeeds. Returns 0 if even the biggest pool fails.
+static size_t bisect(Trace * trace, size_t lo, unsigned flags, int defragMode, unsigned defragEvery)
+{
+  size_t hi = MAX_POOL_SIZE / 4 * 4;
+  if (!simulate(trace, hi, flags, defragMode, defragEvery))
+    return 0;
+
+  lo = lo / 4 * 4;
+  while (lo < hi)
+  {
+    size_t mid = (lo + hi) / 8 * 4;
+    if (simulate(trace, mid, flags, defragMode, defragEvery))
+      hi = mid;
+    else
+      lo = mid + 4;
+  }
+  return hi;
+}
+
+// Peak of live bytes including the 4 byte header of every block and the header at the end of the pool.
+static size_t peak_live(Trace * trace)
+{
+  size_t live = 4;
+  size_t peak = live;
+  int s = 0;
+  int e = 0;
+  while (e < trace->numAllocs)
+  {
+    if (s < trace->numAllocs && trace->starts[s]->tStart <= trace->ends[e]->tEnd)
+    {
+      uint32_t size = trace->starts[s++]->size;
+      if (size)
+        live += (size + 3) / 4 * 4 + 4;
+      if (live > peak)
+        peak = live;
+    }
+    else
+    {
+      uint32_t size = trace->ends[e++]->size;
+      if (size)
+        live -= (size + 3) / 4 * 4 + 4;
+    }
+  }
+  return peak < 12 ? 12 : peak; // yalloc_init() needs at least 12 bytes
+}
+
+static int read_trace(char const * fn, int raw, Trace * trace)
+{
+  FILE * f = fopen(fn, raw ? "rb" : "r");
+  if (!f)
+    return -1;
+
+  int capacity = 0;
+  trace->allocs = NULL;
+  trace->numAllocs = 0;
+  for (;;)
+  {
+    unsigned long size, start, duration;
+    if (raw)
+    {
+      uint16_t triplet[3];
+      if (fread(triplet, sizeof(triplet), 1, f) != 1)
+        break;
+
+      size = triplet[0];
+      start = triplet[1];
+      duration = triplet[2];
+    }
+    else if (fscanf(f, "%lu %lu %lu", &size, &start, &duration) != 3)
+      break;
+
+    if (trace->numAllocs == capacity)
+    {
+      capacity = capacity ? capacity * 2 : 1024;
+      trace->allocs = (Alloc*)realloc(trace->allocs, capacity * sizeof(Alloc));
+      if (!trace->allocs)
+        return -1;
+    }
+
+    Alloc * a = &trace->allocs[trace->numAllocs++];
+    a->size = size > MAX_POOL_SIZE ? MAX_POOL_SIZE : (uint32_t)size;
+    a->tStart = (uint32_t)start;
+    a->tEnd = (uint32_t)(start + duration);
+    a->p = NULL;
+  }
+  fclose(f);
+
+  trace->starts = (Alloc**)malloc((trace->numAllocs + 1) * sizeof(Alloc*));
+  trace->ends = (Alloc**)malloc((trace->numAllocs + 1) * sizeof(Alloc*));
+  if (!trace->starts || !trace->ends)
+    return -1;
+
+  for (int i = 0; i < trace->numAllocs; ++i)
+    trace->starts[i] = trace->ends[i] = &trace->allocs[i];
+
+  qsort(trace->starts, trace->numAllocs, sizeof(Alloc*), cmp_start);
+  qsort(trace->ends, trace->numAllocs, sizeof(Alloc*), cmp_end);
+  return 0;
+}
+
+static void print_result(char const * what, size_t size, size_t current)
+{
+  if (!size)
+    printf("%-28s does not fit into a pool of MAX_POOL_SIZE\n", what);
+  else if (current && current > size)
+    printf("%-28s %zu bytes (saves %zu of the current pool)\n", what, size, current - size);
+  else
+    printf("%-28s %zu bytes\n", what, size);
+}
+
+int main(int argc, char * argv[])
+{
+  int raw = 0;
+  unsigned flags = 0;
+  unsigned defragEvery = 0;
+  size_t current = 0;
+  char const * fn = NULL;
+
+  for (int i = 1; i < argc; ++i)
+  {
+    if (!strcmp(argv[i], "-raw"))
+      raw = 1;
+    else if (!strcmp(argv[i], "-flags") && i + 1 < argc)
+      flags = (unsigned)strtoul(argv[++i], NULL, 0);
+    else if (!strcmp(argv[i], "-defrag-every") && i + 1 < argc)
+      defragEvery = (unsigned)strtoul(argv[++i], NULL, 10);
+    else if (!strcmp(argv[i], "-current") && i + 1 < argc)
+      current = strtoul(argv[++i], NULL, 10);
+    else
+      fn = argv[i];
+  }
+
+  if (!fn)
+  {
+    fprintf(stderr, "usage: %s [-raw] [-flags F] [-defrag-every N] [-current SIZE] <trace-file>\n", argv[0]);
+    return -1;
+  }
+
+  Trace trace;
+  if (read_trace(fn, raw, &trace))
+  {
+    fprintf(stderr, "can not read %s\n", fn);
+    return -1;
+  }
+
+  size_t lowerBound = peak_live(&trace);
+  printf("allocations:                 %i\n", trace.numAllocs);
+  printf("peak live bytes (+headers):  %zu\n", lowerBound);
+  print_result("without defragmentation:", bisect(&trace, lowerBound, flags, DEFRAG_NEVER, 0), current);
+  print_result("defragmenting on failure:", bisect(&trace, lowerBound, flags, DEFRAG_ON_FAILURE, 0), current);
+  if (defragEvery)
+  {
+    char what[64];
+    snprintf(what, sizeof(what), "defragmenting every %u ops:", defragEvery);
+    print_result(what, bisect(&trace, lowerBound, flags, DEFRAG_NEVER, defragEvery), current);
+  }
+
+  free(trace.allocs);
+  free(trace.starts);
+  free(trace.ends);
+  return 0;
+}
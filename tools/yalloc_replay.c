@@ -0,0 +1,153 @@
+#include "../yalloc/yalloc.h"
+#include "../yalloc/yalloc_trace.h"
+#include "../yalloc/yalloc_internals.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+/*
+Replays a binary trace that was recorded with the yalloc_traced_*() functions
+and prints the state of the pool afterwards.
+
+  yalloc_replay [-n N] [-flags F] [-dump] <trace-file>
+
+  -n N      Only replay the first N records (to inspect the pool at that point of the trace).
+  -flags F  Create the pool with these flags of yalloc_init_ex() instead of the recorded ones
+            (decimal or 0x hex). The replay then stops at the first allocation that lands
+            elsewhere, which shows where the other kind of pool starts to behave differently.
+  -dump     Print all blocks of the pool with yalloc_dump().
+
+Build it with:
+
+  gcc tools/yalloc_replay.c yalloc/yalloc.c yalloc/yalloc_trace.c yalloc/yalloc_dump.c -o yalloc_replay
+*/
+
+static void print_summary(void * pool, size_t poolSize)
+{
+  size_t usedBlocks = 0;
+  size_t usedBytes = 0;
+  size_t largestGap = 0;
+  char * end = (char*)getRoot(pool, getControl(pool)); // end of the previous used block (which is where the next free range would start)
+  for (char * p = yalloc_first_used(pool); p; p = yalloc_next_used(pool, p))
+  {
+    size_t gap = (size_t)(p - 4 - end);
+    if (gap > largestGap)
+      largestGap = gap;
+
+    ++usedBlocks;
+    usedBytes += yalloc_block_size(pool, p);
+    end = p + yalloc_block_size(pool, p);
+  }
+
+  // the pool ends with a 4 byte header
+  size_t tail = (size_t)((char*)pool + poolSize / 4 * 4 - 4 - end);
+  if (tail > largestGap)
+    largestGap = tail;
+
+  size_t freeBytes = yalloc_count_free(pool);
+  printf("pool size:          %zu\n", poolSize);
+  printf("used blocks:        %zu\n", usedBlocks);
+  printf("used bytes:         %zu\n", usedBytes);
+  printf("free bytes:         %zu\n", freeBytes);
+  printf("largest free range: %zu\n", largestGap > 4 ? largestGap - 4 : 0);
+}
+
+int main(int argc, char * argv[])
+{
+  size_t limit = (size_t)-1;
+  long flags = -1; // the recorded ones
+  int dump = 0;
+  char const * fn = NULL;
+
+  for (int i = 1; i < argc; ++i)
+  {
+    if (!strcmp(argv[i], "-n") && i + 1 < argc)
+      limit = strtoul(argv[++i], NULL, 10);
+    else if (!strcmp(argv[i], "-flags") && i + 1 < argc)
+      flags = (long)strtoul(argv[++i], NULL, 0);
+    else if (!strcmp(argv[i], "-dump"))
+      dump = 1;
+    else
+      fn = argv[i];
+  }
+
+  if (!fn)
+  {
+    fprintf(stderr, "usage: %s [-n N] [-flags F] [-dump] <trace-file>\n", argv[0]);
+    return -1;
+  }
+
+  FILE * f = fopen(fn, "rb");
+  if (!f)
+  {
+    fprintf(stderr, "can not open %s\n", fn);
+    return -1;
+  }
+
+  long fileSize = fseek(f, 0, SEEK_END) ? -1 : ftell(f);
+  if (fileSize < 0 || fseek(f, 0, SEEK_SET))
+  {
+    fprintf(stderr, "can not read %s\n", fn);
+    fclose(f);
+    return -1;
+  }
+
+  size_t n = (size_t)fileSize / sizeof(YallocTraceRecord);
+  YallocTraceRecord * records = (YallocTraceRecord*)malloc(n * sizeof(YallocTraceRecord) + 1);
+  if (!records || fread(records, sizeof(YallocTraceRecord), n, f) != n)
+  {
+    fprintf(stderr, "can not read %s\n", fn);
+    free(records);
+    fclose(f);
+    return -1;
+  }
+
+  fclose(f);
+
+  if (n > limit)
+    n = limit;
+
+  if (!n || records[0].op != YALLOC_TRACE_INIT)
+  {
+    fprintf(stderr, "%s does not start with the initialization of a pool\n", fn);
+    free(records);
+    return -1;
+  }
+
+  if (flags >= 0)
+    records[0].flags = (uint16_t)flags;
+
+  size_t poolSize = (size_t)records[0].size * 4;
+  uint32_t * pool = (uint32_t*)malloc(poolSize + 4);
+  if (!pool)
+  {
+    free(records);
+    return -1;
+  }
+
+  size_t replayed = yalloc_trace_replay(records, n, pool, poolSize);
+  printf("replayed %zu of %zu records (flags 0x%x)\n", replayed, n, (unsigned)records[0].flags);
+  if (replayed != n)
+  {
+    YallocTraceRecord const * r = &records[replayed];
+    printf("diverged at record %zu (time %u, op %u, size %u, offset %u)\n", replayed, (unsigned)r->time, (unsigned)r->op, (unsigned)r->size * 4, (unsigned)r->offset * 4);
+  }
+
+  if (replayed && !records[0].result)
+  {
+    if (yalloc_defrag_in_progress(pool))
+      printf("pool is defragmenting\n");
+    else
+    {
+      print_summary(pool, poolSize);
+      if (dump)
+        yalloc_dump(pool, "replayed pool");
+    }
+  }
+
+  free(pool);
+  free(records);
+  return replayed == n ? 0 : 1;
+}
@@ -22,6 +22,13 @@
 # define VALGRIND_MEMPOOL_CHANGE(pool, a, b, s)  ((void)0)
 #endif
 
+#ifdef YALLOC_WORK_COUNTERS
+YallocWorkCounters yalloc_work;
+#endif
+
+// bits of the flags that hold the capacity of the undo log (see YALLOC_UNDO_LOG())
+#define UNDO_LOG_MASK 0x7F00u
+
 #define MARK_NEW_FREE_HDR(p) VALGRIND_MAKE_MEM_UNDEFINED(p, sizeof(Header) * 2)
 #define MARK_NEW_HDR(p) VALGRIND_MAKE_MEM_UNDEFINED(p, sizeof(Header))
 #define PROTECT_HDR(p) VALGRIND_MAKE_MEM_NOACCESS(p, sizeof(Header))
@@ -29,11 +36,130 @@
 #define UNPROTECT_HDR(p) VALGRIND_MAKE_MEM_DEFINED(p, sizeof(Header))
 #define UNPROTECT_FREE_HDR(p) VALGRIND_MAKE_MEM_DEFINED(p, sizeof(Header) * 2)
 
+#if defined(__GNUC__)
+# define ctz32(x) ((unsigned)__builtin_ctz(x))
+# define clz32(x) ((unsigned)__builtin_clz(x))
+# define popcount32(x) ((unsigned)__builtin_popcount(x))
+#else
+// x must not be 0
+static unsigned ctz32(uint32_t x)
+{
+  unsigned n = 0;
+  for (; !(x & 1); x >>= 1)
+    ++n;
+  return n;
+}
+
+// x must not be 0
+static unsigned clz32(uint32_t x)
+{
+  unsigned n = 0;
+  for (; !(x & 0x80000000u); x <<= 1)
+    ++n;
+  return n;
+}
+
+static unsigned popcount32(uint32_t x)
+{
+  unsigned n = 0;
+  for (; x; x &= x - 1)
+    ++n;
+  return n;
+}
+#endif
+
+static inline int isBitmap(Control * ctrl)
+{
+  return ctrl && (ctrl->flags & YALLOC_BITMAP);
+}
+
+// returns granule i of a YALLOC_BITMAP pool
+static inline BlockHeader * granuleAt(Control * ctrl, size_t i)
+{
+  return (BlockHeader*)((char*)ctrl + ctrl->size) + i;
+}
+
+static inline size_t granuleOf(Control * ctrl, BlockHeader * blk)
+{
+  return (size_t)(blk - granuleAt(ctrl, 0));
+}
+
+// tells if the blocks of a YALLOC_BITMAP pool have no BlockHeader
+static inline int isOutOfBand(Control * ctrl)
+{
+  return ctrl->flags & YALLOC_OUT_OF_BAND;
+}
+
+// returns the first set bit at or behind bit i (or limit if there is none in front of limit)
+static size_t find_set_bit(uint32_t * bitmap, size_t i, size_t limit)
+{
+  while (i < limit)
+  {
+    COUNT_ACCESS(&bitmap[i / 32]);
+    uint32_t bits = bitmap[i / 32] >> (i % 32);
+    if (bits)
+    {
+      i += ctz32(bits);
+      return i < limit ? i : limit;
+    }
+
+    i = (i / 32 + 1) * 32;
+  }
+  return limit;
+}
+
+// returns the first granule at or behind granule i where a block starts (or numGranules if there is none)
+static size_t bitmap_next_block(Control * ctrl, size_t i)
+{
+  // a used granule that follows behind free ones or the end of a block starts the next block
+  return find_set_bit(getBitmap(ctrl), i, ctrl->numGranules);
+}
+
+// returns the number of granules of the block that starts at granule i
+static size_t block_granules(Control * ctrl, size_t i)
+{
+  if (isOutOfBand(ctrl))
+    return find_set_bit(getEndBitmap(ctrl), i, ctrl->numGranules) - i + 1;
+
+  COUNT_ACCESS(granuleAt(ctrl, i));
+  return granuleAt(ctrl, i)->size;
+}
+
+// returns the user pointer of the block that starts at granule i
+static inline void * block_payload(Control * ctrl, size_t i)
+{
+  return isOutOfBand(ctrl) ? (void*)granuleAt(ctrl, i) : (void*)(granuleAt(ctrl, i) + 1);
+}
+
+// returns the first granule of the block of a user pointer
+static inline size_t block_of(Control * ctrl, void * p)
+{
+  return granuleOf(ctrl, (BlockHeader*)p - !isOutOfBand(ctrl));
+}
 
 #if USE_VALGRIND
-static void _unprotect_pool(void * pool)
+static void _unprotect_pool(void * pool_)
 {
-  Header * cur = (Header*)pool;
+  UNPROTECT_HDR(pool_); // the first Header or the marker of a Control block
+  Control * ctrl = getControl(pool_);
+  if (ctrl)
+  {
+    VALGRIND_MAKE_MEM_DEFINED(ctrl, sizeof(Control));
+    VALGRIND_MAKE_MEM_DEFINED(ctrl, ctrl->size);
+  }
+
+  if (isBitmap(ctrl))
+  {
+    if (!isOutOfBand(ctrl))
+    {
+      for (size_t i = bitmap_next_block(ctrl, 0); i < ctrl->numGranules; i = bitmap_next_block(ctrl, i + granuleAt(ctrl, i)->size))
+        UNPROTECT_HDR(granuleAt(ctrl, i));
+    }
+    return;
+  }
+
+  Header * pool = getRoot(pool_, ctrl);
+  Header * cur = pool;
   for (;;)
   {
     UNPROTECT_HDR(cur);
@@ -47,9 +173,24 @@ static void _unprotect_pool(void * pool)
   }
 }
 
-static void _protect_pool(void * pool)
+static void _protect_pool(void * pool_)
 {
-  Header * cur = (Header*)pool;
+  Control * ctrl = getControl(pool_);
+  if (isBitmap(ctrl))
+  {
+    size_t i = isOutOfBand(ctrl) ? ctrl->numGranules : bitmap_next_block(ctrl, 0);
+    while (i < ctrl->numGranules)
+    {
+      size_t next = bitmap_next_block(ctrl, i + granuleAt(ctrl, i)->size);
+      PROTECT_HDR(granuleAt(ctrl, i));
+      i = next;
+    }
+    VALGRIND_MAKE_MEM_NOACCESS(ctrl, ctrl->size);
+    return;
+  }
+
+  Header * pool = getRoot(pool_, ctrl);
+  Header * cur = pool;
   while (cur)
   {
     Header * next = isNil(cur->next) ? NULL : HDR_PTR(cur->next);
@@ -61,6 +202,9 @@ static void _protect_pool(void * pool)
 
     cur = next;
   }
+
+  if (ctrl)
+    VALGRIND_MAKE_MEM_NOACCESS(ctrl, ctrl->size);
 }
 #define assert_is_pool(pool) assert(VALGRIND_MEMPOOL_EXISTS(pool));
 
@@ -85,11 +229,105 @@ static int _yalloc_defrag_in_progress(void * pool)
 int yalloc_defrag_in_progress(void * pool)
 {
   _unprotect_pool(pool);
-  int ret = _yalloc_defrag_in_progress(pool);
+  Control * ctrl = getControl(pool);
+  int ret = isBitmap(ctrl) ? ctrl->defragging : _yalloc_defrag_in_progress(getRoot(pool, ctrl));
   _protect_pool(pool);
   return ret;
 }
 
+static inline int isAddressOrdered(Control * ctrl)
+{
+  return ctrl && (ctrl->flags & YALLOC_ADDRESS_ORDERED);
+}
+
+// tells if the pool maintains the rover (the free block where the next search of next fit starts)
+static inline int tracksRover(Control * ctrl)
+{
+  return ctrl && (ctrl->flags & (YALLOC_NEXT_FIT | YALLOC_ADAPTIVE));
+}
+
+static inline int isAdaptive(Control * ctrl)
+{
+  return ctrl && (ctrl->flags & YALLOC_ADAPTIVE);
+}
+
+static inline int isTagged(Control * ctrl)
+{
+  return ctrl && (ctrl->flags & YALLOC_TAGGED);
+}
+
+static inline int tracksZero(Control * ctrl)
+{
+  return ctrl && (ctrl->flags & YALLOC_MEMORY_IS_ZERO);
+}
+
+// Remembers that the memory in front of end (behind the root) may be non-zero now (YALLOC_MEMORY_IS_ZERO only).
+static inline void raise_zero_mark(void * root, Control * ctrl, void * end)
+{
+  size_t granule = (size_t)((char*)end - (char*)root) / 4;
+  if (tracksZero(ctrl) && granule > ctrl->zeroFrom)
+    ctrl->zeroFrom = (uint16_t)granule;
+}
+
+// Clears the memory from mark to the zero mark after defragmentation moved the blocks away from it (YALLOC_MEMORY_IS_ZERO only).
+static void clear_to_zero_mark(void * root, Control * ctrl, void * mark)
+{
+  char * zero = (char*)root + (size_t)ctrl->zeroFrom * 4;
+  if ((char*)mark < zero)
+  {
+    VALGRIND_MAKE_MEM_UNDEFINED(mark, zero - (char*)mark);
+    memset(mark, 0, zero - (char*)mark);
+    ctrl->zeroFrom = (uint16_t)(((char*)mark - (char*)root) / 4);
+  }
+}
+
+// returns the tag of a block of a YALLOC_TAGGED pool
+static inline unsigned tagOf(Header * pool, Control * ctrl, Header * blk)
+{
+  size_t i = HDR_OFFSET(blk) >> 2;
+  return getTags(ctrl)[i / 2] >> (i % 2 * 4) & 0xFu;
+}
+
+// returns the size of the user data of a used block
+static inline size_t payloadSize(Header * pool, Header * blk)
+{
+  return (char*)HDR_PTR(blk->next) - (char*)(blk + 1) - (isPadded(blk) ? sizeof(Header) : 0);
+}
+
+static inline unsigned policyOf(Control * ctrl)
+{
+  return ctrl ? ctrl->policy : YALLOC_POLICY_FIRST_FIT;
+}
+
+// returns the index of the address range a block belongs to (see getBuckets())
+static inline unsigned bucketOf(Header * pool, Control * ctrl, Header * blk)
+{
+  return HDR_OFFSET(blk) >> ctrl->bucketShift;
+}
+
+// returns the first free block of an address range or NIL if the range has no free block
+static inline uint16_t firstFreeIn(Control * ctrl, unsigned b)
+{
+  return ctrl->nonEmptyBuckets[b / 16] >> (b % 16) & 1 ? getBuckets(ctrl)[b] : NIL;
+}
+
+// returns the last address range up to range b (including it) that has a free block, or -1 if there is none
+static int last_nonempty_bucket(Control * ctrl, int b)
+{
+  if (b < 0)
+    return -1;
+
+  int w = b / 16;
+  uint32_t bits = ctrl->nonEmptyBuckets[w] & ((2u << (b % 16)) - 1);
+  while (!bits)
+  {
+    if (--w < 0)
+      return -1;
+    bits = ctrl->nonEmptyBuckets[w];
+  }
+  return w * 16 + 31 - (int)clz32(bits);
+}
+
 #if YALLOC_INTERNAL_VALIDATE
 
 static size_t _count_free_list_occurences(Header * pool, Header * blk)
@@ -129,10 +367,10 @@ static size_t _count_addr_list_occurences(Header * pool, Header * blk)
   return n;
 }
 
-static void _validate_user_ptr(void * pool, void * p)
+static void _validate_user_ptr(Header * pool, void * p)
 {
   Header * hdr = (Header*)p - 1;
-  size_t n = _count_addr_list_occurences((Header*)pool, hdr);
+  size_t n = _count_addr_list_occurences(pool, hdr);
   assert(n == 1 && !isFree(hdr));
 }
 
@@ -141,11 +379,17 @@ Validates if all the invariants of a pool are intact.
 
 This is very expensive when there are enough blocks in the heap (quadratic complexity!).
 */
-static void _yalloc_validate(void * pool_)
+static void _yalloc_validate(Header * pool, Control * ctrl)
 {
-  Header * pool = (Header*)pool_;
   Header * cur = pool;
 
+  if (ctrl)
+  {
+    assert(ctrl->magic == CONTROL_MAGIC);
+    assert(ctrl->marker == CONTROL_MARKER);
+    assert((char*)pool == (char*)ctrl + ctrl->size);
+  }
+
   assert(!isNil(pool->next)); // there must always be at least two blocks: a free/used one and the final block at the end
 
   if (_yalloc_defrag_in_progress(pool))
@@ -236,35 +480,727 @@ static void _yalloc_validate(void * pool_)
         if (isNil(f[1].next))
           break;
 
+        assert(!isAddressOrdered(ctrl) || HDR_PTR(f[1].next) > f); // address ordered free lists must be sorted
         f = HDR_PTR(f[1].next);
       }
     }
+
+    if (isAddressOrdered(ctrl))
+    { // every bucket must point to the first free block in its address range
+      uint16_t expected[MAX_FREE_LIST_BUCKETS];
+      for (unsigned i = 0; i < ctrl->numBuckets; ++i)
+        expected[i] = NIL;
+
+      for (uint16_t f = pool->prev & NIL; !isNil(f); f = HDR_PTR(f)[1].next)
+      {
+        unsigned b = bucketOf(pool, ctrl, HDR_PTR(f));
+        assert(b < ctrl->numBuckets);
+        if (isNil(expected[b]))
+          expected[b] = f;
+      }
+
+      for (unsigned i = 0; i < ctrl->numBuckets; ++i)
+        assert(firstFreeIn(ctrl, i) == expected[i]);
+      for (unsigned i = ctrl->numBuckets; i < MAX_FREE_LIST_BUCKETS; ++i)
+        assert(!(ctrl->nonEmptyBuckets[i / 16] >> (i % 16) & 1)); // there are no ranges behind the pool
+    }
+
+    if (tracksRover(ctrl) && !isNil(ctrl->rover))
+    { // the rover must point to a block in the free list
+      assert(_count_free_list_occurences(pool, HDR_PTR(ctrl->rover)) == 1);
+    }
+
+    if (isTagged(ctrl))
+    { // the statistics of every tag must match its used blocks
+      size_t bytes[YALLOC_NUM_TAGS] = {0};
+      size_t blocks[YALLOC_NUM_TAGS] = {0};
+      for (Header * blk = pool; !isNil(blk->next); blk = HDR_PTR(blk->next))
+      {
+        if (!isFree(blk))
+        {
+          bytes[tagOf(pool, ctrl, blk)] += payloadSize(pool, blk);
+          ++blocks[tagOf(pool, ctrl, blk)];
+        }
+      }
+
+      for (unsigned i = 0; i < YALLOC_NUM_TAGS; ++i)
+      {
+        assert(getTagStats(ctrl)[i].bytes == bytes[i]);
+        assert(getTagStats(ctrl)[i].blocks == blocks[i]);
+      }
+    }
   }
 }
 
+static size_t bitmap_metadata_size(size_t numWords, int outOfBand);
+
+static void _bitmap_validate(Control * ctrl)
+{
+  assert(ctrl->magic == CONTROL_MAGIC);
+  assert(ctrl->marker == CONTROL_MARKER);
+
+  uint32_t * bitmap = getBitmap(ctrl);
+  size_t numWords = bitmapWords(ctrl);
+  assert(ctrl->size == sizeof(Control) + bitmap_metadata_size(numWords, isOutOfBand(ctrl)));
+
+  size_t usedBits = 0;
+  for (size_t i = 0; i < numWords * 32; ++i)
+  {
+    if (bitmap[i / 32] >> (i % 32) & 1)
+      ++usedBits;
+    else
+      assert(i < ctrl->numGranules); // the bits behind the last granule must be set
+  }
+
+  for (size_t w = 0; w < ctrl->searchStart; ++w)
+    assert(bitmap[w] == 0xFFFFFFFFu); // no free granule in front of the search start
+
+  // the blocks must cover exactly the used granules
+  size_t usedGranules = 0;
+  size_t numBlocks = 0;
+  size_t end = 0; // where the previous block ended
+  for (size_t i = bitmap_next_block(ctrl, 0); i < ctrl->numGranules; i = bitmap_next_block(ctrl, end))
+  {
+    size_t n = block_granules(ctrl, i);
+    assert(i >= end);
+    assert(n >= (isOutOfBand(ctrl) ? 1u : 2u) && i + n <= ctrl->numGranules);
+    for (size_t j = i; j < i + n; ++j)
+      assert(bitmap[j / 32] >> (j % 32) & 1);
+
+    if (ctrl->defragging && !isOutOfBand(ctrl))
+      assert(granuleAt(ctrl, i)->defragTarget == usedGranules);
+
+    usedGranules += n;
+    ++numBlocks;
+    end = i + n;
+  }
+
+  assert(usedBits - (numWords * 32 - ctrl->numGranules) == usedGranules);
+
+  if (isOutOfBand(ctrl))
+  {
+    size_t endBits = 0;
+    size_t rank = 0;
+    for (size_t w = 0; w < numWords; ++w)
+    {
+      endBits += popcount32(getEndBitmap(ctrl)[w]);
+      if (ctrl->defragging)
+        assert(getRanks(ctrl)[w] == rank);
+      rank += popcount32(bitmap[w]);
+    }
+    assert(endBits == numBlocks); // no end bits in free granules
+  }
+}
+
+static void _bitmap_validate_user_ptr(Control * ctrl, void * p)
+{
+  size_t blk = block_of(ctrl, p);
+  size_t i = bitmap_next_block(ctrl, 0);
+  while (i < blk)
+    i = bitmap_next_block(ctrl, i + block_granules(ctrl, i));
+  assert(i == blk);
+}
+
 #else
-static void _yalloc_validate(void * pool){(void)pool;}
-static void _validate_user_ptr(void * pool, void * p){(void)pool; (void)p;}
+static void _yalloc_validate(Header * pool, Control * ctrl){(void)pool; (void)ctrl;}
+static void _validate_user_ptr(Header * pool, void * p){(void)pool; (void)p;}
+static void _bitmap_validate(Control * ctrl){(void)ctrl;}
+static void _bitmap_validate_user_ptr(Control * ctrl, void * p){(void)ctrl; (void)p;}
 #endif
 
-int yalloc_init(void * pool, size_t size)
+// Records the 4 byte word that contains p in the undo log (see yalloc_checkpoint()).
+static void log_undo(Control * ctrl, void * p)
+{
+  if (ctrl->undoUsed == UNDO_OVERFLOW)
+    return; // the checkpoints can not be rolled back anyway
+
+  if (ctrl->undoUsed == ctrl->undoCapacity)
+  {
+    ctrl->undoUsed = UNDO_OVERFLOW;
+    return;
+  }
+
+  // Headers are at multiples of 4 from the root, which is at a multiple of 4 from the control block
+  size_t word = (size_t)((char*)p - (char*)ctrl) / 4;
+  uint16_t * w = (uint16_t*)ctrl + word * 2;
+  UndoEntry * e = &getUndoLog(ctrl)[ctrl->undoUsed];
+  e->word = (uint16_t)word;
+  e->old[0] = w[0];
+  e->old[1] = w[1];
+
+  // the entry is complete before it counts and it counts before the word is changed
+  WRITE_BARRIER();
+  ++ctrl->undoUsed;
+  WRITE_BARRIER();
+}
+
+// records the metadata at p before it is changed while a checkpoint exists
+#define LOG_UNDO(ctrl, p) do { if ((ctrl) && (ctrl)->undoDepth) log_undo(ctrl, p); } while (0)
+
+// sets the tag of a block (YALLOC_TAGGED only)
+static void set_tag(Header * pool, Control * ctrl, Header * blk, unsigned tag)
+{
+  size_t i = HDR_OFFSET(blk) >> 2;
+  uint8_t * t = &getTags(ctrl)[i / 2];
+  LOG_UNDO(ctrl, t);
+  *t = (uint8_t)((*t & (0xF0u >> (i % 2 * 4))) | tag << (i % 2 * 4));
+}
+
+// Gives a block a tag and adds it to the statistics of the tag (YALLOC_TAGGED only).
+static void tag_block(Header * pool, Control * ctrl, Header * blk, unsigned tag)
+{
+  set_tag(pool, ctrl, blk, tag);
+
+  TagStats * stats = &getTagStats(ctrl)[tag];
+  LOG_UNDO(ctrl, &stats->bytes);
+  LOG_UNDO(ctrl, &stats->blocks);
+  stats->bytes += (uint32_t)payloadSize(pool, blk);
+  ++stats->blocks;
+}
+
+// Removes a used block that is about to be freed from the statistics of its tag (YALLOC_TAGGED only).
+static void untag_block(Header * pool, Control * ctrl, Header * blk)
+{
+  TagStats * stats = &getTagStats(ctrl)[tagOf(pool, ctrl, blk)];
+  LOG_UNDO(ctrl, &stats->bytes);
+  LOG_UNDO(ctrl, &stats->blocks);
+  stats->bytes -= (uint32_t)payloadSize(pool, blk);
+  --stats->blocks;
+}
+
+// Makes first (a free block or NIL if there is none) the first free block of the address range b.
+static void set_bucket(Control * ctrl, unsigned b, uint16_t first)
+{
+  uint16_t bit = (uint16_t)(1u << (b % 16));
+  LOG_UNDO(ctrl, &ctrl->nonEmptyBuckets[b / 16]);
+  if (isNil(first))
+    ctrl->nonEmptyBuckets[b / 16] &= (uint16_t)~bit;
+  else
+  {
+    LOG_UNDO(ctrl, &getBuckets(ctrl)[b]);
+    getBuckets(ctrl)[b] = first;
+    ctrl->nonEmptyBuckets[b / 16] |= bit;
+  }
+}
+
+// Removes a block from the free-list and moves the pools first-free-bock pointer to its successor if it pointed to that block.
+static void unlink_from_free_list(Header * pool, Control * ctrl, Header * blk)
+{
+  COUNT_WORK(freeListVisits, 1);
+  COUNT_ACCESS(blk);
+
+  if (isAddressOrdered(ctrl))
+  { // if it was the first free block of its address range then its successor takes over (if it is in the same range)
+    unsigned b = bucketOf(pool, ctrl, blk);
+    if (firstFreeIn(ctrl, b) == HDR_OFFSET(blk))
+      set_bucket(ctrl, b, !isNil(blk[1].next) && bucketOf(pool, ctrl, HDR_PTR(blk[1].next)) == b ? blk[1].next : NIL);
+  }
+
+  // a search that would start at the block (it was consumed or joined with a neighbour) starts at its successor instead
+  if (tracksRover(ctrl) && ctrl->rover == HDR_OFFSET(blk))
+  {
+    LOG_UNDO(ctrl, &ctrl->rover);
+    ctrl->rover = blk[1].next;
+  }
+
+  // update the pools pointer to the first block in the free list if necessary
+  if (isNil(blk[1].prev))
+  { // the block is the first in the free-list
+    // make the pools first-free-pointer point to the next in the free list
+    uint16_t freeBit = isFree(pool);
+    LOG_UNDO(ctrl, pool);
+    pool->prev = (blk[1].next & NIL) | freeBit;
+  }
+  else
+  {
+    COUNT_ACCESS(HDR_PTR(blk[1].prev) + 1);
+    LOG_UNDO(ctrl, HDR_PTR(blk[1].prev) + 1);
+    HDR_PTR(blk[1].prev)[1].next = blk[1].next;
+  }
+
+  if (!isNil(blk[1].next))
+  {
+    COUNT_ACCESS(HDR_PTR(blk[1].next) + 1);
+    LOG_UNDO(ctrl, HDR_PTR(blk[1].next) + 1);
+    HDR_PTR(blk[1].next)[1].prev = blk[1].prev;
+  }
+}
+
+// Makes a free block the first free block of its address range if it is in front of the current one.
+static void update_bucket(Header * pool, Control * ctrl, Header * blk)
+{
+  if (isAddressOrdered(ctrl))
+  {
+    unsigned b = bucketOf(pool, ctrl, blk);
+    uint16_t first = firstFreeIn(ctrl, b);
+    if (isNil(first) || HDR_PTR(first) > blk)
+      set_bucket(ctrl, b, HDR_OFFSET(blk));
+  }
+}
+
+// Finds the last free block in front of blk (or NULL if there is none) in an address ordered free list.
+static Header * find_free_predecessor(Header * pool, Control * ctrl, Header * blk)
+{
+  // Start at the first free block of the address range of blk (or of the closest range in front of it that has a
+  // free block, which the bitmap of non-empty ranges finds a word at a time). So at most the free blocks of one range
+  // are walked, and there are at most 32 of them (see MAX_FREE_LIST_BUCKETS).
+  unsigned b = bucketOf(pool, ctrl, blk);
+  Header * pred;
+  if (!isNil(firstFreeIn(ctrl, b)))
+  {
+    pred = HDR_PTR(getBuckets(ctrl)[b]);
+    COUNT_ACCESS(pred + 1);
+    if (pred > blk) // the free block in front of the first one of the range is in a range in front of blk
+      return isNil(pred[1].prev) ? NULL : HDR_PTR(pred[1].prev);
+  }
+  else
+  {
+    int p = last_nonempty_bucket(ctrl, (int)b - 1);
+    if (p < 0)
+      return NULL;
+    pred = HDR_PTR(getBuckets(ctrl)[p]);
+    COUNT_ACCESS(pred + 1);
+  }
+
+  while (!isNil(pred[1].next) && HDR_PTR(pred[1].next) < blk)
+  {
+    COUNT_WORK(freeListVisits, 1);
+    pred = HDR_PTR(pred[1].next);
+    COUNT_ACCESS(pred + 1);
+  }
+
+  return pred;
+}
+
+// Inserts a block, that already has its "free"-bit set, into the free list behind pred (or at the front if pred is NULL).
+static void insert_after(Header * pool, Control * ctrl, Header * blk, Header * pred)
+{
+  COUNT_WORK(freeListVisits, 1);
+  COUNT_ACCESS(blk + 1);
+
+  LOG_UNDO(ctrl, blk + 1);
+  if (pred)
+  { // insert after its predecessor in address order
+    blk[1].prev = HDR_OFFSET(pred);
+    blk[1].next = pred[1].next;
+    if (!isNil(pred[1].next))
+    {
+      COUNT_ACCESS(HDR_PTR(pred[1].next) + 1);
+      LOG_UNDO(ctrl, HDR_PTR(pred[1].next) + 1);
+      HDR_PTR(pred[1].next)[1].prev = HDR_OFFSET(blk);
+    }
+    LOG_UNDO(ctrl, pred + 1);
+    pred[1].next = HDR_OFFSET(blk);
+  }
+  else
+  { // the block becomes the first in the free-list
+    blk[1].prev = NIL; // it will be the first free block in the free list, so it has no prevFree
+
+    if (!isNil(pool->prev))
+    { // the free-list was already non-empty
+      COUNT_ACCESS(HDR_PTR(pool->prev) + 1);
+      LOG_UNDO(ctrl, HDR_PTR(pool->prev) + 1);
+      HDR_PTR(pool->prev)[1].prev = HDR_OFFSET(blk); // make the first entry in the free list point back to the new free block (it will become the first one)
+      blk[1].next = pool->prev & NIL; // the next free block is the first of the old free-list (without the free-bit of the first block)
+    }
+    else
+      blk[1].next = NIL; // free-list was empty, so there is no successor
+
+    // update the offset to the first element of the free list
+    uint16_t freeBit = isFree(pool); // remember the free-bit of the offset
+    LOG_UNDO(ctrl, pool);
+    pool->prev = HDR_OFFSET(blk) | freeBit; // update the offset and restore the free-bit
+  }
+
+  update_bucket(pool, ctrl, blk);
+}
+
+// Inserts a block, that already has its "free"-bit set, into the free list.
+static void insert_into_free_list(Header * pool, Control * ctrl, Header * blk)
+{
+  insert_after(pool, ctrl, blk, isAddressOrdered(ctrl) ? find_free_predecessor(pool, ctrl, blk) : NULL);
+}
+
+// resets the state of the free list to "empty" (the caller has to insert the free blocks)
+static void _reset_free_list(Header * pool, Control * ctrl)
+{
+  LOG_UNDO(ctrl, pool);
+  pool->prev = (pool->prev & 1) | NIL;
+  if (ctrl)
+  {
+    LOG_UNDO(ctrl, &ctrl->rover);
+    ctrl->rover = NIL;
+  }
+
+  if (isAddressOrdered(ctrl))
+  {
+    for (unsigned i = 0; i < MAX_FREE_LIST_BUCKETS / 16; ++i)
+    {
+      LOG_UNDO(ctrl, &ctrl->nonEmptyBuckets[i]);
+      ctrl->nonEmptyBuckets[i] = 0;
+    }
+  }
+}
+
+/*
+The bitmap engine (YALLOC_BITMAP). Blocks are runs of granules that start with
+a BlockHeader (or are marked in the end bitmap for YALLOC_OUT_OF_BAND).
+Searching only reads the bitmap and handles a whole word at a time: completely
+used and completely free words are skipped/taken as a whole, for mixed words
+the free bits at both ends are counted with ctz/clz and runs inside of the
+word are found with a few shift-and steps.
+*/
+
+// sets (used != 0) or clears the bits of the granules [start, start + n)
+static void set_bits(uint32_t * bitmap, size_t start, size_t n, int used)
+{
+  while (n)
+  {
+    size_t bit = start % 32;
+    size_t k = 32 - bit < n ? 32 - bit : n;
+    uint32_t mask = (k == 32 ? 0xFFFFFFFFu : (((uint32_t)1 << k) - 1)) << bit;
+    COUNT_ACCESS(&bitmap[start / 32]);
+    if (used)
+      bitmap[start / 32] |= mask;
+    else
+      bitmap[start / 32] &= ~mask;
+
+    start += k;
+    n -= k;
+  }
+}
+
+// Finds the first run of n free granules. Returns the index of its first granule or -1 if there is none.
+static long find_free_run(Control * ctrl, size_t n)
+{
+  uint32_t * bitmap = getBitmap(ctrl);
+  size_t numWords = bitmapWords(ctrl);
+  size_t run = 0; // length of the current run of free granules
+  size_t start = 0; // first granule of the current run
+  for (size_t w = ctrl->searchStart; w < numWords; ++w)
+  {
+    COUNT_WORK(freeListVisits, 1);
+    COUNT_ACCESS(&bitmap[w]);
+    uint32_t bits = bitmap[w];
+    if (bits == 0xFFFFFFFFu)
+    {
+      run = 0;
+      continue;
+    }
+
+    if (!bits)
+    {
+      if (!run)
+        start = w * 32;
+      run += 32;
+      if (run >= n)
+        return (long)start;
+      continue;
+    }
+
+    // the free granules at the start of the word continue the current run (a new run is found by the search below)
+    if (run && run + ctz32(bits) >= n)
+      return (long)start;
+
+    if (n < 32)
+    { // look for a run inside of the word: bit i of x stays set if granules i to i + n - 1 are all free
+      uint32_t x = ~bits;
+      for (size_t len = 1; len < n && x;)
+      {
+        size_t shift = len < n - len ? len : n - len;
+        x &= x >> shift;
+        len += shift;
+      }
+
+      if (x)
+        return (long)(w * 32 + ctz32(x));
+    }
+
+    // the free granules at the end of the word start a new run
+    run = clz32(bits);
+    start = w * 32 + 32 - run;
+  }
+  return -1;
+}
+
+// size of the bitmaps (and the table for defragmentation) for numWords words per bitmap
+static size_t bitmap_metadata_size(size_t numWords, int outOfBand)
+{
+  return outOfBand ? numWords * 8 + (numWords * 2 + 3) / 4 * 4 : numWords * 4;
+}
+
+// returns the number of granules that fit into a pool of size bytes (behind the control block and the metadata)
+static size_t bitmap_granules(size_t size, int outOfBand)
+{
+  size_t avail = size - sizeof(Control);
+  size_t numGranules = avail / 4;
+  while (numGranules * 4 + bitmap_metadata_size((numGranules + 31) / 32, outOfBand) > avail)
+    --numGranules;
+  return numGranules;
+}
+
+static void bitmap_init(Control * ctrl, size_t numGranules)
+{
+  size_t numWords = (numGranules + 31) / 32;
+  size_t metadataSize = bitmap_metadata_size(numWords, isOutOfBand(ctrl));
+  ctrl->size = sizeof(Control) + metadataSize;
+  ctrl->numGranules = numGranules;
+  ctrl->searchStart = 0;
+  ctrl->defragging = 0;
+
+  uint32_t * bitmap = getBitmap(ctrl);
+  VALGRIND_MAKE_MEM_UNDEFINED(bitmap, metadataSize);
+  memset(bitmap, 0, metadataSize);
+  set_bits(bitmap, numGranules, numWords * 32 - numGranules, 1);
+}
+
+static void * bitmap_alloc(void * pool_, Control * ctrl, size_t size)
+{
+  assert(!ctrl->defragging);
+  _bitmap_validate(ctrl);
+
+  size_t n = (size + 3) / 4 + !isOutOfBand(ctrl); // the payload rounded up to whole granules and the header
+  long start = size && size <= MAX_POOL_SIZE && n <= ctrl->numGranules ? find_free_run(ctrl, n) : -1; // (huge sizes overflow n)
+  if (start < 0)
+  {
+    _protect_pool(pool_);
+    return NULL;
+  }
+
+  uint32_t * bitmap = getBitmap(ctrl);
+  set_bits(bitmap, (size_t)start, n, 1);
+  size_t numWords = bitmapWords(ctrl);
+  while (ctrl->searchStart < numWords && bitmap[ctrl->searchStart] == 0xFFFFFFFFu)
+    ++ctrl->searchStart;
+
+  if (isOutOfBand(ctrl))
+    set_bits(getEndBitmap(ctrl), (size_t)start + n - 1, 1, 1);
+  else
+  {
+    BlockHeader * blk = granuleAt(ctrl, (size_t)start);
+    MARK_NEW_HDR(blk);
+    COUNT_ACCESS(blk);
+    blk->size = (uint16_t)n;
+    blk->defragTarget = 0;
+  }
+
+  raise_zero_mark(granuleAt(ctrl, 0), ctrl, granuleAt(ctrl, (size_t)start + n));
+  void * p = block_payload(ctrl, (size_t)start);
+  _bitmap_validate(ctrl);
+  VALGRIND_MEMPOOL_ALLOC(pool_, p, size);
+  _protect_pool(pool_);
+  return p;
+}
+
+static void bitmap_free(void * pool_, Control * ctrl, void * p)
+{
+#if USE_VALGRIND
+  {
+    unsigned errs = VALGRIND_COUNT_ERRORS;
+    VALGRIND_MEMPOOL_FREE(pool_, p);
+    if (VALGRIND_COUNT_ERRORS > errs)
+    { // early exit if the free was invalid (see yalloc_free())
+      _protect_pool(pool_);
+      return;
+    }
+  }
+#endif
+
+  _bitmap_validate_user_ptr(ctrl, p);
+
+  size_t i = block_of(ctrl, p);
+  size_t n = block_granules(ctrl, i);
+  set_bits(getBitmap(ctrl), i, n, 0);
+  if (isOutOfBand(ctrl))
+    set_bits(getEndBitmap(ctrl), i + n - 1, 1, 0);
+  if (i / 32 < ctrl->searchStart)
+    ctrl->searchStart = (uint16_t)(i / 32);
+
+  VALGRIND_MAKE_MEM_NOACCESS(granuleAt(ctrl, i), n * 4);
+
+  _bitmap_validate(ctrl);
+  _protect_pool(pool_);
+}
+
+static size_t bitmap_count_free(Control * ctrl)
+{
+  _bitmap_validate(ctrl);
+  uint32_t * bitmap = getBitmap(ctrl);
+  size_t numWords = bitmapWords(ctrl);
+  size_t freeGranules = 0;
+  for (size_t w = ctrl->searchStart; w < numWords; ++w)
+  {
+    COUNT_WORK(blockVisits, 1);
+    freeGranules += popcount32(~bitmap[w]);
+  }
+
+  if (isOutOfBand(ctrl))
+    return freeGranules * 4;
+
+  return freeGranules ? (freeGranules - 1) * 4 : 0; // one granule is needed for the header
+}
+
+static void bitmap_defrag_start(Control * ctrl)
+{
+  assert(!ctrl->defragging);
+
+  if (isOutOfBand(ctrl))
+  { // the post-defragment granule of a block is the number of used granules in front of it
+    uint32_t * bitmap = getBitmap(ctrl);
+    uint16_t * ranks = getRanks(ctrl);
+    size_t numWords = bitmapWords(ctrl);
+    size_t rank = 0;
+    for (size_t w = 0; w < numWords; ++w)
+    {
+      COUNT_WORK(blockVisits, 1);
+      ranks[w] = (uint16_t)rank;
+      rank += popcount32(bitmap[w]);
+    }
+  }
+  else
+  { // store the post-defragment granule of each block in its header
+    size_t end = 0;
+    for (size_t i = bitmap_next_block(ctrl, 0); i < ctrl->numGranules; i = bitmap_next_block(ctrl, i + granuleAt(ctrl, i)->size))
+    {
+      COUNT_WORK(blockVisits, 1);
+      granuleAt(ctrl, i)->defragTarget = (uint16_t)end;
+      end += granuleAt(ctrl, i)->size;
+    }
+  }
+
+  ctrl->defragging = 1;
+  _bitmap_validate(ctrl);
+}
+
+static void * bitmap_defrag_address(Control * ctrl, void * p)
+{
+  _bitmap_validate_user_ptr(ctrl, p);
+  size_t i = block_of(ctrl, p);
+  size_t target;
+  if (isOutOfBand(ctrl))
+    target = getRanks(ctrl)[i / 32] + popcount32(getBitmap(ctrl)[i / 32] & (((uint32_t)1 << (i % 32)) - 1));
+  else
+    target = granuleAt(ctrl, i)->defragTarget;
+
+  return block_payload(ctrl, target);
+}
+
+static void bitmap_defrag_commit(void * pool_, Control * ctrl)
+{
+  assert(ctrl->defragging);
+  (void)pool_;
+
+  // Move the blocks. The bitmaps still describe the old positions, which is fine because a block never moves behind
+  // its old end (so neither the header of the next block nor the end bits behind the block are overwritten).
+  int outOfBand = isOutOfBand(ctrl);
+  size_t end = 0;
+  size_t i = bitmap_next_block(ctrl, 0);
+  while (i < ctrl->numGranules)
+  {
+    COUNT_WORK(blockVisits, 1);
+    size_t n = block_granules(ctrl, i);
+    size_t next = bitmap_next_block(ctrl, i + n);
+    if (end != i)
+    {
+      COUNT_WORK(bytesMoved, n * 4);
+      VALGRIND_MAKE_MEM_UNDEFINED(granuleAt(ctrl, end), (i - end) * 4);
+      memmove(granuleAt(ctrl, end), granuleAt(ctrl, i), n * 4);
+      VALGRIND_MEMPOOL_CHANGE(pool_, block_payload(ctrl, i), block_payload(ctrl, end), (n - !outOfBand) * 4);
+      if (outOfBand)
+      {
+        set_bits(getEndBitmap(ctrl), i + n - 1, 1, 0);
+        set_bits(getEndBitmap(ctrl), end + n - 1, 1, 1);
+      }
+    }
+
+    end += n;
+    i = next;
+  }
+
+  // now the first end granules are used
+  uint32_t * bitmap = getBitmap(ctrl);
+  size_t numWords = bitmapWords(ctrl);
+  memset(bitmap, 0, numWords * 4);
+  set_bits(bitmap, 0, end, 1);
+  set_bits(bitmap, ctrl->numGranules, numWords * 32 - ctrl->numGranules, 1);
+  ctrl->searchStart = (uint16_t)(end / 32);
+  ctrl->defragging = 0;
+  if (tracksZero(ctrl))
+    clear_to_zero_mark(granuleAt(ctrl, 0), ctrl, granuleAt(ctrl, end));
+
+  _bitmap_validate(ctrl);
+}
+
+int yalloc_init_ex(void * pool_, size_t size, unsigned flags)
 {
   if (size > MAX_POOL_SIZE)
     return -1;
 
+  if (flags & ~(unsigned)(YALLOC_ADDRESS_ORDERED | YALLOC_NEXT_FIT | YALLOC_BEST_FIT | YALLOC_ADAPTIVE | YALLOC_BITMAP | YALLOC_OUT_OF_BAND | YALLOC_TAGGED | YALLOC_MEMORY_IS_ZERO | UNDO_LOG_MASK))
+    return -1; // unknown flags
+
+  if ((flags & YALLOC_BITMAP) && (flags & ~(unsigned)(YALLOC_BITMAP | YALLOC_OUT_OF_BAND | YALLOC_MEMORY_IS_ZERO)))
+    return -1; // the policies and the undo log only apply to the free list
+
+  if ((flags & YALLOC_OUT_OF_BAND) && !(flags & YALLOC_BITMAP))
+    return -1; // only the bitmap engine can do without headers
+
+  if ((flags & YALLOC_NEXT_FIT) && (flags & YALLOC_BEST_FIT))
+    return -1; // contradicting policies
+
   // TODO: Error when pool is not properly aligned
 
   // TODO: Error when size is not a multiple of the alignment?
   while (size % sizeof(Header))
     --size;
 
-  if(size < sizeof(Header) * 3)
+  size_t undoCapacity = (flags & UNDO_LOG_MASK) >> 8 << 6;
+  size_t tagsSize = flags & YALLOC_TAGGED ? sizeof(TagStats) * YALLOC_NUM_TAGS + (size / 8 / 2 + 1 + 3) / 4 * 4 : 0; // 4 bits for every 8 bytes
+  // choose the size of the address ranges so that the offsets of all blocks map to MAX_FREE_LIST_BUCKETS ranges
+  unsigned bucketShift = MIN_BUCKET_SHIFT;
+  while ((size / 2 >> bucketShift) >= MAX_FREE_LIST_BUCKETS)
+    ++bucketShift;
+  size_t numBuckets = flags & YALLOC_ADDRESS_ORDERED ? (size / 2 >> bucketShift) + 1 : 0;
+  size_t bucketsSize = (numBuckets + 1) / 2 * 4;
+  size_t controlSize = flags ? sizeof(Control) + undoCapacity * sizeof(UndoEntry) + bucketsSize + tagsSize : 0;
+  if(size < controlSize + sizeof(Header) * 3)
     return -1;
 
-  VALGRIND_CREATE_MEMPOOL(pool, 0, 0);
+  size_t numGranules = flags & YALLOC_BITMAP ? bitmap_granules(size, flags & YALLOC_OUT_OF_BAND) : 0;
+  if ((flags & YALLOC_BITMAP) && numGranules < 2)
+    return -1;
 
-  Header * first = (Header*)pool;
-  Header * last = (Header*)((char*)pool + size) - 1;
+  VALGRIND_CREATE_MEMPOOL(pool_, 0, 0);
+
+  Control * ctrl = NULL;
+  if (flags)
+  {
+    ctrl = (Control*)pool_;
+    VALGRIND_MAKE_MEM_UNDEFINED(ctrl, sizeof(Control));
+    memset(ctrl, 0, sizeof(Control));
+    ctrl->magic = CONTROL_MAGIC;
+    ctrl->marker = CONTROL_MARKER;
+    ctrl->flags = flags;
+    ctrl->size = controlSize;
+    ctrl->undoCapacity = undoCapacity;
+    ctrl->numBuckets = (uint16_t)numBuckets;
+    ctrl->bucketShift = bucketShift;
+    memset(getBuckets(ctrl), 0, bucketsSize);
+    memset(getTagStats(ctrl), 0, tagsSize);
+    ctrl->policy = flags & YALLOC_NEXT_FIT ? YALLOC_POLICY_NEXT_FIT : flags & YALLOC_BEST_FIT ? YALLOC_POLICY_BEST_FIT : YALLOC_POLICY_FIRST_FIT;
+  }
+
+  if (isBitmap(ctrl))
+  {
+    bitmap_init(ctrl, numGranules);
+    _bitmap_validate(ctrl);
+    _protect_pool(pool_);
+    return 0;
+  }
+
+  Header * pool = getRoot(pool_, ctrl);
+  Header * first = pool;
+  Header * last = (Header*)((char*)pool_ + size) - 1;
 
   MARK_NEW_FREE_HDR(first);
   MARK_NEW_HDR(first);
@@ -277,146 +1213,388 @@ int yalloc_init(void * pool, size_t size)
   last->prev = HDR_OFFSET(first);
   last->next = NIL;
 
-  _unprotect_pool(pool);
-  _yalloc_validate(pool);
-  _protect_pool(pool);
+  if (ctrl)
+  {
+    ctrl->last = HDR_OFFSET(last);
+    ctrl->zeroFrom = 2; // behind the Header and the free list links of the first block
+
+    _reset_free_list(pool, ctrl);
+    insert_into_free_list(pool, ctrl, first);
+  }
+
+  _unprotect_pool(pool_);
+  _yalloc_validate(pool, ctrl);
+  _protect_pool(pool_);
   return 0;
 }
 
-void yalloc_deinit(void * pool)
+int yalloc_init(void * pool, size_t size)
+{
+  return yalloc_init_ex(pool, size, 0);
+}
+
+void yalloc_deinit(void * pool_)
 {
 #if USE_VALGRIND
-  VALGRIND_DESTROY_MEMPOOL(pool);
+  VALGRIND_DESTROY_MEMPOOL(pool_);
 
-  Header * last = (Header*)pool;
-  UNPROTECT_HDR(last);
-  while (!isNil(last->next))
+  _unprotect_pool(pool_);
+  Control * ctrl = getControl(pool_);
+  if (isBitmap(ctrl))
   {
-    Header * next = HDR_PTR(last->next);
-    UNPROTECT_HDR(next);
-    last = next;
+    VALGRIND_MAKE_MEM_UNDEFINED(pool_, ctrl->size + (size_t)ctrl->numGranules * 4);
+    return;
   }
 
-  VALGRIND_MAKE_MEM_UNDEFINED(pool, (char*)(last + 1) - (char*)pool);
+  Header * pool = getRoot(pool_, ctrl);
+  Header * last = pool;
+  while (!isNil(last->next))
+    last = HDR_PTR(last->next);
+
+  VALGRIND_MAKE_MEM_UNDEFINED(pool_, (char*)(last + 1) - (char*)pool_);
 #else
-  (void)pool;
+  (void)pool_;
 #endif
 }
 
 
-void * yalloc_alloc(void * pool, size_t size)
+// Finds a free block that can hold bruttoSize bytes according to the search policy of the pool. Returns NULL if there is none.
+static Header * find_fit(Header * pool, Control * ctrl, size_t bruttoSize, unsigned * visits)
 {
-  assert_is_pool(pool);
-  _unprotect_pool(pool);
+  Header * first = HDR_PTR(pool->prev);
+  if (policyOf(ctrl) == YALLOC_POLICY_BEST_FIT)
+  { // take the smallest block that fits, an exact fit can not be beaten
+    Header * best = NULL;
+    size_t bestSize = 0;
+    for (Header * cur = first;; cur = HDR_PTR(cur[1].next))
+    {
+      COUNT_WORK(freeListVisits, 1);
+      COUNT_ACCESS(cur);
+      ++*visits;
+      size_t curSize = (char*)HDR_PTR(cur->next) - (char*)cur;
+      if (curSize >= bruttoSize && (!best || curSize < bestSize))
+      {
+        best = cur;
+        bestSize = curSize;
+      }
+
+      if (bestSize == bruttoSize || isNil(cur[1].next))
+        return best;
+    }
+  }
+
+  Header * start = policyOf(ctrl) == YALLOC_POLICY_NEXT_FIT && !isNil(ctrl->rover) ? HDR_PTR(ctrl->rover) : first; // next fit resumes where the last search ended
+  Header * cur = start;
+  for (;;)
+  {
+    COUNT_WORK(freeListVisits, 1);
+    COUNT_ACCESS(cur);
+    ++*visits;
+    if ((size_t)((char*)HDR_PTR(cur->next) - (char*)cur) >= bruttoSize)
+      return cur;
+
+    // continue with the next free block, wrapping around to the front of the free list (only happens for next fit)
+    cur = isNil(cur[1].next) ? first : HDR_PTR(cur[1].next);
+    if (cur == start)
+      return NULL;
+  }
+}
+
+// Finds the free block with the highest address that can hold bruttoSize bytes. Returns NULL if there is none.
+static Header * find_highest_fit(Header * pool, Control * ctrl, size_t bruttoSize, unsigned * visits)
+{
+  Header * best = NULL;
+  if (isAddressOrdered(ctrl))
+  { // walk the address ranges from the top: the first range with a fitting block contains the highest one
+    for (int b = last_nonempty_bucket(ctrl, ctrl->numBuckets - 1); b >= 0 && !best; b = last_nonempty_bucket(ctrl, b - 1))
+    {
+      for (uint16_t f = getBuckets(ctrl)[b]; !isNil(f) && bucketOf(pool, ctrl, HDR_PTR(f)) == (unsigned)b; f = HDR_PTR(f)[1].next)
+      {
+        COUNT_WORK(freeListVisits, 1);
+        COUNT_ACCESS(HDR_PTR(f));
+        ++*visits;
+        Header * cur = HDR_PTR(f);
+        if ((size_t)((char*)HDR_PTR(cur->next) - (char*)cur) >= bruttoSize)
+          best = cur;
+      }
+    }
+    return best;
+  }
+
+  for (Header * cur = HDR_PTR(pool->prev);; cur = HDR_PTR(cur[1].next))
+  {
+    COUNT_WORK(freeListVisits, 1);
+    COUNT_ACCESS(cur);
+    ++*visits;
+    if ((size_t)((char*)HDR_PTR(cur->next) - (char*)cur) >= bruttoSize && (!best || cur > best))
+      best = cur;
+
+    if (isNil(cur[1].next))
+      return best;
+  }
+}
+
+// sum of the sizes of all free blocks (including their headers)
+static size_t free_list_bytes(Header * pool)
+{
+  size_t bytes = 0;
+  for (uint16_t f = pool->prev & NIL; !isNil(f); f = HDR_PTR(f)[1].next)
+    bytes += (char*)HDR_PTR(HDR_PTR(f)->next) - (char*)HDR_PTR(f);
+
+  return bytes;
+}
+
+// Records an allocation of an adaptive pool and chooses the search policy at the end of every window of allocations.
+static void adapt(Header * pool, Control * ctrl, unsigned visits, int failed, size_t bruttoSize)
+{
+  ctrl->windowVisits = visits > 0xFFFFu - ctrl->windowVisits ? 0xFFFFu : ctrl->windowVisits + visits;
+  if (failed && free_list_bytes(pool) >= bruttoSize)
+    ++ctrl->windowFragFailures;
+
+  if (++ctrl->windowAllocs < ADAPT_WINDOW)
+    return;
+
+  size_t total = 0;
+  size_t largest = 0;
+  for (uint16_t f = pool->prev & NIL; !isNil(f); f = HDR_PTR(f)[1].next)
+  {
+    size_t size = (char*)HDR_PTR(HDR_PTR(f)->next) - (char*)HDR_PTR(f);
+    total += size;
+    if (size > largest)
+      largest = size;
+  }
+
+  unsigned fragPercent = total ? 100 - largest * 100 / total : 0;
+  unsigned policy;
+  if (fragPercent >= ADAPT_FRAG_PERCENT || (ctrl->policy == YALLOC_POLICY_BEST_FIT && fragPercent >= ADAPT_FRAG_PERCENT / 2))
+    policy = YALLOC_POLICY_BEST_FIT;
+  else if (ctrl->policy == YALLOC_POLICY_NEXT_FIT || ctrl->windowVisits >= ADAPT_MAX_VISITS * ADAPT_WINDOW)
+    policy = YALLOC_POLICY_NEXT_FIT;
+  else
+    policy = YALLOC_POLICY_FIRST_FIT;
+
+  if (policy != ctrl->policy)
+  {
+    ctrl->policy = policy;
+    if (ctrl->switches != 0xFFFFu)
+      ++ctrl->switches;
+  }
+
+  ctrl->defragSuggested = ctrl->windowFragFailures || fragPercent >= ADAPT_DEFRAG_PERCENT;
+  ctrl->windowAllocs = 0;
+  ctrl->windowVisits = 0;
+  ctrl->windowFragFailures = 0;
+}
+
+static void * alloc_block(void * pool_, size_t size, unsigned hint, unsigned tag)
+{
+  assert(hint == YALLOC_SHORT_LIVED || hint == YALLOC_LONG_LIVED);
+  assert(tag < YALLOC_NUM_TAGS);
+  assert_is_pool(pool_);
+  _unprotect_pool(pool_);
+  Control * ctrl = getControl(pool_);
+  if (isBitmap(ctrl))
+    return bitmap_alloc(pool_, ctrl, size);
+
+  Header * pool = getRoot(pool_, ctrl);
   assert(!_yalloc_defrag_in_progress(pool));
-  _yalloc_validate(pool);
-  if (!size)
+  _yalloc_validate(pool, ctrl);
+  if (!size || size > MAX_POOL_SIZE)
+  {
+    _protect_pool(pool_);
+    return NULL; // a size beyond any pool would also overflow when it is rounded up
+  }
+
+  Header * root = pool;
+  COUNT_ACCESS(root);
+  if (isNil(root->prev))
+  {
+    _protect_pool(pool_);
+    return NULL; /* no free block, no chance to allocate anything */ // TODO: Just read up which C standard supports single line comments and then fucking use them!
+  }
+
+  size = (size + 3) & ~(size_t)3; // round up to alignment (sizes that are already rounded, like the ones of yalloc_static_pool.hpp, stay as they are)
+
+  if (isTagged(ctrl))
+  {
+    TagStats * stats = &getTagStats(ctrl)[tag];
+    if (stats->quota && stats->bytes + size > stats->quota)
+    {
+      _protect_pool(pool_);
+      return NULL; // the tag would exceed its quota
+    }
+  }
+
+  size_t bruttoSize = size + sizeof(Header);
+  unsigned visits = 0;
+  Header * cur = hint == YALLOC_LONG_LIVED ? find_highest_fit(pool, ctrl, bruttoSize, &visits) : find_fit(pool, ctrl, bruttoSize, &visits);
+  if (isAdaptive(ctrl))
+    adapt(pool, ctrl, visits, !cur, bruttoSize);
+
+  if (!cur)
+  {
+    _yalloc_validate(pool, ctrl);
+    _protect_pool(pool_);
+    return NULL;
+  }
+
+  size_t curSize = (char*)HDR_PTR(cur->next) - (char*)cur; /* size of the block, including its header */
+
+  if (hint == YALLOC_LONG_LIVED && curSize >= bruttoSize + sizeof(Header) * 2)
+  { // carve the block from the top of the free block, which stays free (so the free list does not change)
+    Header * blk = (Header*)((char*)HDR_PTR(cur->next) - bruttoSize);
+    MARK_NEW_HDR(blk);
+    COUNT_ACCESS(blk);
+    COUNT_ACCESS(HDR_PTR(cur->next));
+    LOG_UNDO(ctrl, blk);
+    LOG_UNDO(ctrl, HDR_PTR(cur->next));
+    LOG_UNDO(ctrl, cur);
+
+    blk->next = cur->next;
+    blk->prev = HDR_OFFSET(cur);
+    HDR_PTR(cur->next)->prev = HDR_OFFSET(blk); // NOTE: The next block is used because free blocks are never neighbours.
+    cur->next = HDR_OFFSET(blk);
+
+    if (isTagged(ctrl))
+      tag_block(pool, ctrl, blk, tag);
+
+    raise_zero_mark(pool, ctrl, HDR_PTR(blk->next));
+    _yalloc_validate(pool, ctrl);
+    VALGRIND_MEMPOOL_ALLOC(pool_, blk + 1, size);
+    _protect_pool(pool_);
+    return blk + 1;
+  }
+
+  // take action for unused space in the free block
+  if (curSize >= bruttoSize + sizeof(Header) * 2)
+  { // the leftover space is big enough to make it a free block
+    // Build a free block from the unused space and insert it into the list of free blocks after the current free block
+    Header * tail = (Header*)((char*)cur + bruttoSize);
+    MARK_NEW_FREE_HDR(tail);
+    COUNT_ACCESS(tail);
+    COUNT_ACCESS(HDR_PTR(cur->next));
+    LOG_UNDO(ctrl, tail);
+    LOG_UNDO(ctrl, tail + 1);
+    LOG_UNDO(ctrl, HDR_PTR(cur->next));
+    LOG_UNDO(ctrl, cur);
+    LOG_UNDO(ctrl, cur + 1);
+
+    // update address-order-list
+    tail->next = cur->next;
+    tail->prev = HDR_OFFSET(cur) | 1;
+    HDR_PTR(cur->next)->prev = HDR_OFFSET(tail); // NOTE: We know the next block is used because free blocks are never neighbours. So we don't have to care about the lower bit which would be set for the prev of a free block.
+    cur->next = HDR_OFFSET(tail);
+
+    // update list of free blocks
+    tail[1].next = cur[1].next;
+
+    tail[1].prev = HDR_OFFSET(cur);
+
+    if (!isNil(cur[1].next))
+    {
+      LOG_UNDO(ctrl, HDR_PTR(cur[1].next) + 1);
+      HDR_PTR(cur[1].next)[1].prev = HDR_OFFSET(tail);
+    }
+    cur[1].next = HDR_OFFSET(tail);
+
+    // the tail directly follows cur, so this keeps an address ordered free list sorted
+    update_bucket(pool, ctrl, tail);
+    raise_zero_mark(pool, ctrl, tail + 2);
+  }
+  else if (curSize > bruttoSize)
+  { // there will be unused space, but not enough to insert a free header
+    internal_assert(curSize - bruttoSize == sizeof(Header)); // unused space must be enough to build a free-block or it should be exactly the size of a Header
+    LOG_UNDO(ctrl, cur);
+    cur->next |= 1; // set marker for "has unused trailing space"
+  }
+  else
   {
-    _protect_pool(pool);
-    return NULL;
+    internal_assert(curSize == bruttoSize);
   }
 
-  Header * root = (Header*)pool;
-  if (isNil(root->prev))
+  LOG_UNDO(ctrl, cur);
+  cur->prev &= NIL; // clear marker for "is a free block"
+
+  // the next search starts behind this allocation (at the tail that was split off if there is one)
+  if (tracksRover(ctrl))
   {
-    _protect_pool(pool);
-    return NULL; /* no free block, no chance to allocate anything */ // TODO: Just read up which C standard supports single line comments and then fucking use them!
+    LOG_UNDO(ctrl, &ctrl->rover);
+    ctrl->rover = cur[1].next;
   }
 
-  while (size % 4)
-    ++size; /* round up to alignment TODO: do it the clever way */
+  // remove from linked list of free blocks
+  unlink_from_free_list(pool, ctrl, cur);
 
-  size_t bruttoSize = size + sizeof(Header);
-  Header * prev = NULL;
-  Header * cur = HDR_PTR(root->prev);
-  for (;;)
-  {
-    size_t curSize = (char*)HDR_PTR(cur->next) - (char*)cur; /* size of the block, including its header */
+  if (isTagged(ctrl))
+    tag_block(pool, ctrl, cur, tag);
 
-    if (curSize >= bruttoSize) // it is big enough
-    {
-      // take action for unused space in the free block
-      if (curSize >= bruttoSize + sizeof(Header) * 2)
-      { // the leftover space is big enough to make it a free block
-        // Build a free block from the unused space and insert it into the list of free blocks after the current free block
-        Header * tail = (Header*)((char*)cur + bruttoSize);
-        MARK_NEW_FREE_HDR(tail);
-
-        // update address-order-list
-        tail->next = cur->next;
-        tail->prev = HDR_OFFSET(cur) | 1;
-        HDR_PTR(cur->next)->prev = HDR_OFFSET(tail); // NOTE: We know the next block is used because free blocks are never neighbours. So we don't have to care about the lower bit which would be set for the prev of a free block.
-        cur->next = HDR_OFFSET(tail);
-
-        // update list of free blocks
-        tail[1].next = cur[1].next;
-        // NOTE: tail[1].prev is updated in the common path below (assignment to "HDR_PTR(cur[1].next)[1].prev")
-
-        if (!isNil(cur[1].next))
-          HDR_PTR(cur[1].next)[1].prev = HDR_OFFSET(tail);
-        cur[1].next = HDR_OFFSET(tail);
-      }
-      else if (curSize > bruttoSize)
-      { // there will be unused space, but not enough to insert a free header
-        internal_assert(curSize - bruttoSize == sizeof(Header)); // unused space must be enough to build a free-block or it should be exactly the size of a Header
-        cur->next |= 1; // set marker for "has unused trailing space"
-      }
-      else
-      {
-        internal_assert(curSize == bruttoSize);
-      }
+  raise_zero_mark(pool, ctrl, HDR_PTR(cur->next));
 
-      cur->prev &= NIL; // clear marker for "is a free block"
+  _yalloc_validate(pool, ctrl);
+  VALGRIND_MEMPOOL_ALLOC(pool_, cur + 1, size);
+  _protect_pool(pool_);
+  return cur + 1; // return address after the header
+}
 
-      // remove from linked list of free blocks
-      if (prev)
-        prev[1].next = cur[1].next;
-      else
-      {
-        uint16_t freeBit = isFree(root);
-        root->prev = (cur[1].next & NIL) | freeBit;
-      }
+void * yalloc_alloc_hint(void * pool, size_t size, unsigned hint)
+{
+  return alloc_block(pool, size, hint, 0);
+}
 
-      if (!isNil(cur[1].next))
-        HDR_PTR(cur[1].next)[1].prev = prev ? HDR_OFFSET(prev) : NIL;
+void * yalloc_alloc(void * pool, size_t size)
+{
+  return alloc_block(pool, size, YALLOC_SHORT_LIVED, 0);
+}
 
-      _yalloc_validate(pool);
-      VALGRIND_MEMPOOL_ALLOC(pool, cur + 1, size);
-      _protect_pool(pool);
-      return cur + 1; // return address after the header
-    }
+void * yalloc_alloc_tagged(void * pool, size_t size, unsigned tag)
+{
+  return alloc_block(pool, size, YALLOC_SHORT_LIVED, tag);
+}
 
-    if (isNil(cur[1].next))
-      break;
+void * yalloc_calloc(void * pool_, size_t num, size_t size)
+{
+  if (size && num > (size_t)-1 / size)
+    return NULL; // the size overflows
 
-    prev = cur;
-    cur = HDR_PTR(cur[1].next);
-  }
+  size *= num;
 
-  _yalloc_validate(pool);
-  _protect_pool(pool);
-  return NULL;
+  // everything behind the zero mark of the pool before the allocation is still zero
+  _unprotect_pool(pool_);
+  Control * ctrl = getControl(pool_);
+  char * zero = tracksZero(ctrl) ? (char*)getRoot(pool_, ctrl) + (size_t)ctrl->zeroFrom * 4 : NULL;
+  _protect_pool(pool_);
+
+  char * p = (char*)yalloc_alloc(pool_, size);
+  if (p)
+  {
+    char * dirty = zero && zero < p + size ? zero : p + size; // end of the part that has to be cleared
+    if (dirty > p)
+      memset(p, 0, dirty - p);
+    VALGRIND_MAKE_MEM_DEFINED(p, size);
+  }
+  return p;
 }
 
-// Removes a block from the free-list and moves the pools first-free-bock pointer to its successor if it pointed to that block.
-static void unlink_from_free_list(Header * pool, Header * blk)
+size_t yalloc_block_size(void * pool_, void * p)
 {
-  // update the pools pointer to the first block in the free list if necessary
-  if (isNil(blk[1].prev))
-  { // the block is the first in the free-list
-    // make the pools first-free-pointer point to the next in the free list
-    uint16_t freeBit = isFree(pool);
-    pool->prev = (blk[1].next & NIL) | freeBit;
+  UNPROTECT_HDR(pool_);
+  Control * ctrl = getControl(pool_);
+  if (ctrl)
+    VALGRIND_MAKE_MEM_DEFINED(ctrl, sizeof(Control));
+
+  if (isBitmap(ctrl))
+  { // the size of an out-of-band block is in the bitmaps
+    _unprotect_pool(pool_);
+    size_t payloadSize = (block_granules(ctrl, block_of(ctrl, p)) - !isOutOfBand(ctrl)) * 4;
+    _protect_pool(pool_);
+    return payloadSize;
   }
-  else
-    HDR_PTR(blk[1].prev)[1].next = blk[1].next;
 
-  if (!isNil(blk[1].next))
-    HDR_PTR(blk[1].next)[1].prev = blk[1].prev;
-}
+  Header * pool = getRoot(pool_, ctrl);
+  if (ctrl)
+    VALGRIND_MAKE_MEM_NOACCESS(ctrl, sizeof(Control));
+  PROTECT_HDR(pool_);
 
-size_t yalloc_block_size(void * pool, void * p)
-{
   Header * a = (Header*)p - 1;
   UNPROTECT_HDR(a);
   Header * b = HDR_PTR(a->next);
@@ -436,12 +1614,25 @@ void yalloc_free(void * pool_, void * p)
 
   _unprotect_pool(pool_);
 
-  Header * pool = (Header*)pool_;
+  Control * ctrl = getControl(pool_);
+  if (isBitmap(ctrl))
+  {
+    bitmap_free(pool_, ctrl, p);
+    return;
+  }
+
+  Header * pool = getRoot(pool_, ctrl);
   Header * cur = (Header*)p - 1;
+  COUNT_ACCESS(pool);
+  COUNT_ACCESS(cur);
 
   // get pointers to previous/next block in address order
   Header * prev = cur == pool || isNil(cur->prev) ? NULL : HDR_PTR(cur->prev);
   Header * next = isNil(cur->next) ? NULL : HDR_PTR(cur->next);
+  if (prev)
+    COUNT_ACCESS(prev);
+  if (next)
+    COUNT_ACCESS(next);
 
   int prevFree = prev && isFree(prev);
   int nextFree = next && isFree(next);
@@ -449,7 +1640,7 @@ void yalloc_free(void * pool_, void * p)
 #if USE_VALGRIND
   {
     unsigned errs = VALGRIND_COUNT_ERRORS;
-    VALGRIND_MEMPOOL_FREE(pool, p);
+    VALGRIND_MEMPOOL_FREE(pool_, p);
     if (VALGRIND_COUNT_ERRORS > errs)
     { // early exit if the free was invalid (so we get a valgrind error and don't mess up the pool, which is helpful for testing if invalid frees are detected by valgrind)
       _protect_pool(pool_);
@@ -458,15 +1649,25 @@ void yalloc_free(void * pool_, void * p)
   }
 #endif
 
-  _validate_user_ptr(pool_, p);
+  _validate_user_ptr(pool, p);
+
+  if (isTagged(ctrl))
+    untag_block(pool, ctrl, cur);
+
+  // in an address ordered free list the joined block takes the place of its free neighbours, so only a block without
+  // free neighbours has to search for its position
+  uint16_t predOffset = prevFree ? prev[1].prev : nextFree ? next[1].prev : NIL;
 
   if (prevFree && nextFree)
   { // the freed block has two free neighbors
-    unlink_from_free_list(pool, prev);
-    unlink_from_free_list(pool, next);
+    unlink_from_free_list(pool, ctrl, prev);
+    unlink_from_free_list(pool, ctrl, next);
 
     // join prev, cur and next
+    LOG_UNDO(ctrl, prev);
+    LOG_UNDO(ctrl, HDR_PTR(next->next));
     prev->next = next->next;
+    COUNT_ACCESS(HDR_PTR(next->next));
     HDR_PTR(next->next)->prev = cur->prev;
 
     // prev is now the block we want to push onto the free-list
@@ -474,9 +1675,11 @@ void yalloc_free(void * pool_, void * p)
   }
   else if (prevFree)
   {
-    unlink_from_free_list(pool, prev);
+    unlink_from_free_list(pool, ctrl, prev);
 
     // join prev and cur
+    LOG_UNDO(ctrl, prev);
+    LOG_UNDO(ctrl, HDR_PTR(cur->next));
     prev->next = cur->next;
     HDR_PTR(cur->next)->prev = cur->prev;
 
@@ -485,10 +1688,13 @@ void yalloc_free(void * pool_, void * p)
   }
   else if (nextFree)
   {
-    unlink_from_free_list(pool, next);
+    unlink_from_free_list(pool, ctrl, next);
 
     // join cur and next
+    LOG_UNDO(ctrl, cur);
+    LOG_UNDO(ctrl, HDR_PTR(next->next));
     cur->next = next->next;
+    COUNT_ACCESS(HDR_PTR(next->next));
     HDR_PTR(next->next)->prev = next->prev & NIL;
   }
 
@@ -500,6 +1706,10 @@ void yalloc_free(void * pool_, void * p)
     { // the previous block has padding, so extend the current block to consume move the padding to the current free block
       Header * grown = cur - 1;
       MARK_NEW_HDR(grown);
+      LOG_UNDO(ctrl, grown);
+      LOG_UNDO(ctrl, left);
+      if (!isNil(cur->next))
+        LOG_UNDO(ctrl, HDR_PTR(cur->next));
       grown->next = cur->next;
       grown->prev = cur->prev;
       left->next = HDR_OFFSET(grown);
@@ -510,43 +1720,160 @@ void yalloc_free(void * pool_, void * p)
     }
   }
 
+  LOG_UNDO(ctrl, cur);
   cur->prev |= 1; // it becomes a free block
   cur->next &= NIL; // reset padding-bit
   UNPROTECT_HDR(cur + 1);
-  cur[1].prev = NIL; // it will be the first free block in the free list, so it has no prevFree
 
-  if (!isNil(pool->prev))
-  { // the free-list was already non-empty
-    HDR_PTR(pool->prev)[1].prev = HDR_OFFSET(cur); // make the first entry in the free list point back to the new free block (it will become the first one)
-    cur[1].next = pool->prev; // the next free block is the first of the old free-list
-  }
+  // push it to the front of the free-list (or insert it at its address ordered position)
+  if (isAddressOrdered(ctrl) && (prevFree || nextFree))
+    insert_after(pool, ctrl, cur, isNil(predOffset) ? NULL : HDR_PTR(predOffset));
   else
-    cur[1].next = NIL; // free-list was empty, so there is no successor
+    insert_into_free_list(pool, ctrl, cur);
 
   VALGRIND_MAKE_MEM_NOACCESS(cur + 2, (char*)HDR_PTR(cur->next) - (char*)(cur + 2));
 
-  // now the freed block is the first in the free-list
+  _yalloc_validate(pool, ctrl);
+  _protect_pool(pool_);
+}
 
-  // update the offset to the first element of the free list
-  uint16_t freeBit = isFree(pool); // remember the free-bit of the offset
-  pool->prev = HDR_OFFSET(cur) | freeBit; // update the offset and restore the free-bit
-  _yalloc_validate(pool);
-  _protect_pool(pool);
+// tells if a used block has a tag (blocks of pools without YALLOC_TAGGED have tag 0)
+static inline int hasTag(Header * pool, Control * ctrl, Header * blk, unsigned tag)
+{
+  return isTagged(ctrl) ? tagOf(pool, ctrl, blk) == tag : !tag;
+}
+
+void yalloc_free_all(void * pool_, unsigned tag)
+{
+  assert(tag < YALLOC_NUM_TAGS);
+  assert_is_pool(pool_);
+  assert(!yalloc_defrag_in_progress(pool_));
+  _unprotect_pool(pool_);
+  Control * ctrl = getControl(pool_);
+  if (isBitmap(ctrl))
+  { // all blocks have tag 0
+    _protect_pool(pool_);
+    if (!tag)
+      yalloc_reset(pool_);
+    return;
+  }
+
+  Header * pool = getRoot(pool_, ctrl);
+  _yalloc_validate(pool, ctrl);
+
+  // Walk the blocks in address order and turn every run of neighbours that are free or have the tag into one free
+  // block. As all free blocks are visited anyway the free list is rebuilt in address order on the way, which avoids
+  // unlinking the free blocks that are joined and searching the position of the new ones.
+  _reset_free_list(pool, ctrl);
+  Header * tail = NULL; // last block of the new free list
+  size_t freedBytes = 0;
+  size_t freedBlocks = 0;
+  Header * cur = pool;
+  while (!isNil(cur->next))
+  {
+    COUNT_WORK(blockVisits, 1);
+    COUNT_ACCESS(cur);
+    if (!isFree(cur) && !hasTag(pool, ctrl, cur, tag))
+    {
+      cur = HDR_PTR(cur->next);
+      continue;
+    }
+
+    // find the end of the run (the Header at the end of the pool is never part of it)
+    Header * end = cur;
+    do
+    {
+      if (!isFree(end))
+      {
+        freedBytes += payloadSize(pool, end);
+        ++freedBlocks;
+        VALGRIND_MEMPOOL_FREE(pool_, end + 1);
+      }
+
+      end = HDR_PTR(end->next);
+      COUNT_WORK(blockVisits, 1);
+      COUNT_ACCESS(end);
+    } while (!isNil(end->next) && (isFree(end) || hasTag(pool, ctrl, end, tag)));
+
+    if (!isFree(cur) && cur != pool && !isNil(cur->prev))
+    { // grow into the padding of the previous block like yalloc_free() does (free blocks never follow padding)
+      Header * left = HDR_PTR(cur->prev);
+      if (isPadded(left))
+      {
+        Header * grown = cur - 1;
+        MARK_NEW_HDR(grown);
+        LOG_UNDO(ctrl, grown);
+        LOG_UNDO(ctrl, left);
+        grown->prev = cur->prev;
+        left->next = HDR_OFFSET(grown);
+        cur = grown;
+      }
+    }
+
+    LOG_UNDO(ctrl, cur);
+    LOG_UNDO(ctrl, end);
+    cur->next = HDR_OFFSET(end);
+    cur->prev |= 1; // it becomes (or stays) a free block
+    end->prev = HDR_OFFSET(cur);
+
+    // append it to the free list
+    UNPROTECT_HDR(cur + 1);
+    LOG_UNDO(ctrl, cur + 1);
+    cur[1].prev = tail ? HDR_OFFSET(tail) : NIL;
+    cur[1].next = NIL;
+    if (tail)
+    {
+      LOG_UNDO(ctrl, tail + 1);
+      tail[1].next = HDR_OFFSET(cur);
+    }
+    else
+    {
+      LOG_UNDO(ctrl, pool);
+      pool->prev = HDR_OFFSET(cur) | isFree(pool);
+    }
+    update_bucket(pool, ctrl, cur);
+    tail = cur;
+
+    VALGRIND_MAKE_MEM_NOACCESS(cur + 2, (char*)end - (char*)(cur + 2));
+    cur = end;
+  }
+
+  if (isTagged(ctrl) && freedBlocks)
+  {
+    TagStats * stats = &getTagStats(ctrl)[tag];
+    LOG_UNDO(ctrl, &stats->bytes);
+    LOG_UNDO(ctrl, &stats->blocks);
+    stats->bytes -= (uint32_t)freedBytes;
+    stats->blocks -= (uint16_t)freedBlocks;
+  }
+
+  _yalloc_validate(pool, ctrl);
+  _protect_pool(pool_);
 }
 
 size_t yalloc_count_free(void * pool_)
 {
   assert_is_pool(pool_);
   _unprotect_pool(pool_);
-  assert(!_yalloc_defrag_in_progress(pool_));
-  Header * pool = (Header*)pool_;
+  Control * ctrl = getControl(pool_);
+  if (isBitmap(ctrl))
+  {
+    assert(!ctrl->defragging);
+    size_t bytes = bitmap_count_free(ctrl);
+    _protect_pool(pool_);
+    return bytes;
+  }
+
+  Header * pool = getRoot(pool_, ctrl);
+  assert(!_yalloc_defrag_in_progress(pool));
   size_t bruttoFree = 0;
   Header * cur = pool;
 
-  _yalloc_validate(pool);
+  _yalloc_validate(pool, ctrl);
 
   for (;;)
   {
+    COUNT_WORK(blockVisits, 1);
     if (isFree(cur))
     { // it is a free block
       bruttoFree += (char*)HDR_PTR(cur->next) - (char*)cur;
@@ -565,7 +1892,7 @@ size_t yalloc_count_free(void * pool_)
     cur = HDR_PTR(cur->next);
   }
 
-  _protect_pool(pool);
+  _protect_pool(pool_);
 
   if (bruttoFree < sizeof(Header))
   {
@@ -576,30 +1903,52 @@ size_t yalloc_count_free(void * pool_)
   return bruttoFree - sizeof(Header);
 }
 
-void * yalloc_first_used(void * pool)
+void * yalloc_first_used(void * pool_)
 {
-  assert_is_pool(pool);
-  _unprotect_pool(pool);
-  Header * blk = (Header*)pool;
+  assert_is_pool(pool_);
+  _unprotect_pool(pool_);
+  Control * ctrl = getControl(pool_);
+  if (isBitmap(ctrl))
+  {
+    size_t i = bitmap_next_block(ctrl, 0);
+    void * p = i < ctrl->numGranules ? block_payload(ctrl, i) : NULL;
+    _protect_pool(pool_);
+    return p;
+  }
+
+  Header * pool = getRoot(pool_, ctrl);
+  Header * blk = pool;
   while (!isNil(blk->next))
   {
     if (!isFree(blk))
     {
-      _protect_pool(pool);
+      _protect_pool(pool_);
       return blk + 1;
     }
 
     blk = HDR_PTR(blk->next);
   }
 
-  _protect_pool(pool);
+  _protect_pool(pool_);
   return NULL;
 }
 
-void * yalloc_next_used(void * pool, void * p)
+void * yalloc_next_used(void * pool_, void * p)
 {
-  assert_is_pool(pool);
-  _unprotect_pool(pool);
+  assert_is_pool(pool_);
+  _unprotect_pool(pool_);
+  Control * ctrl = getControl(pool_);
+  if (isBitmap(ctrl))
+  {
+    _bitmap_validate_user_ptr(ctrl, p);
+    size_t cur = block_of(ctrl, p);
+    size_t i = bitmap_next_block(ctrl, cur + block_granules(ctrl, cur));
+    void * next = i < ctrl->numGranules ? block_payload(ctrl, i) : NULL;
+    _protect_pool(pool_);
+    return next;
+  }
+
+  Header * pool = getRoot(pool_, ctrl);
   _validate_user_ptr(pool, p);
   Header * prev = (Header*)p - 1;
   assert(!isNil(prev->next)); // the last block should never end up as input to this function (because it is not user-visible)
@@ -609,14 +1958,14 @@ void * yalloc_next_used(void * pool, void * p)
   {
     if (!isFree(blk))
     {
-      _protect_pool(pool);
+      _protect_pool(pool_);
       return blk + 1;
     }
 
     blk = HDR_PTR(blk->next);
   }
 
-  _protect_pool(pool);
+  _protect_pool(pool_);
   return NULL;
 }
 
@@ -624,14 +1973,26 @@ void yalloc_defrag_start(void * pool_)
 {
   assert_is_pool(pool_);
   _unprotect_pool(pool_);
-  assert(!_yalloc_defrag_in_progress(pool_));
-  Header * pool = (Header*)pool_;
+  Control * ctrl = getControl(pool_);
+  if (isBitmap(ctrl))
+  {
+    bitmap_defrag_start(ctrl);
+    _protect_pool(pool_);
+    return;
+  }
+
+  Header * pool = getRoot(pool_, ctrl);
+  assert(!_yalloc_defrag_in_progress(pool));
+
+  if (ctrl && ctrl->undoDepth)
+    ctrl->undoUsed = UNDO_OVERFLOW; // moving the blocks is not recorded, so the checkpoints become invalid
 
   // iterate over all blocks in address order and store the post-defragment address of used blocks in their "prev" field
   size_t end = 0; // offset for the next used block
   Header * blk = (Header*)pool;
   for (; !isNil(blk->next); blk = HDR_PTR(blk->next))
   {
+    COUNT_WORK(blockVisits, 1);
     if (!isFree(blk))
     { // it is a used block
       blk->prev = end >> 1;
@@ -657,9 +2018,9 @@ void yalloc_defrag_start(void * pool_)
   uint16_t freeBit = isFree(pool);
   pool->prev = (HDR_OFFSET(blk) & NIL) | freeBit;
 
-  _yalloc_validate(pool);
-  internal_assert(yalloc_defrag_in_progress(pool));
-  _protect_pool(pool);
+  _yalloc_validate(pool, ctrl);
+  internal_assert(_yalloc_defrag_in_progress(pool));
+  _protect_pool(pool_);
 }
 
 void * yalloc_defrag_address(void * pool_, void * p)
@@ -669,10 +2030,17 @@ void * yalloc_defrag_address(void * pool_, void * p)
   if (!p)
     return NULL;
 
-  Header * pool = (Header*)pool_;
+  _unprotect_pool(pool_);
+  Control * ctrl = getControl(pool_);
+  if (isBitmap(ctrl))
+  {
+    void * defragP = bitmap_defrag_address(ctrl, p);
+    _protect_pool(pool_);
+    return defragP;
+  }
 
-  _unprotect_pool(pool);
-  _validate_user_ptr(pool_, p);
+  Header * pool = getRoot(pool_, ctrl);
+  _validate_user_ptr(pool, p);
 
   if (pool + 1 == p)
     return pool + 1; // "prev" of the first block points to the last used block to mark the pool as "defragmentation in progress"
@@ -681,16 +2049,45 @@ void * yalloc_defrag_address(void * pool_, void * p)
 
   void * defragP = HDR_PTR(blk->prev) + 1;
 
-  _protect_pool(pool);
+  _protect_pool(pool_);
   return defragP;
 }
 
+YallocOffset yalloc_ptr_to_off(void * pool, void * p)
+{
+  if (!p)
+    return YALLOC_NULL_OFFSET;
+
+  size_t bytes = (char*)p - (char*)pool;
+  assert((char*)p > (char*)pool && bytes < MAX_POOL_SIZE); // p must be in the pool (and can not be its start)
+  assert(bytes % 4 == 0); // p must be 32bit aligned relative to the pool
+  return (YallocOffset)(bytes >> 2);
+}
+
+void * yalloc_off_to_ptr(void * pool, YallocOffset offset)
+{
+  return offset == YALLOC_NULL_OFFSET ? NULL : (char*)pool + ((size_t)offset << 2);
+}
+
+YallocOffset yalloc_defrag_offset(void * pool, YallocOffset offset)
+{
+  return yalloc_ptr_to_off(pool, yalloc_defrag_address(pool, yalloc_off_to_ptr(pool, offset)));
+}
+
 void yalloc_defrag_commit(void * pool_)
 {
   assert_is_pool(pool_);
   _unprotect_pool(pool_);
-  assert(_yalloc_defrag_in_progress(pool_));
-  Header * pool = (Header*)pool_;
+  Control * ctrl = getControl(pool_);
+  if (isBitmap(ctrl))
+  {
+    bitmap_defrag_commit(pool_, ctrl);
+    _protect_pool(pool_);
+    return;
+  }
+
+  Header * pool = getRoot(pool_, ctrl);
+  assert(_yalloc_defrag_in_progress(pool));
 
   // iterate over all blocks in address order and move them
   size_t end = 0; // offset for the next used block
@@ -698,6 +2095,7 @@ void yalloc_defrag_commit(void * pool_)
   Header * lastUsed = NULL;
   while (!isNil(blk->next))
   {
+    COUNT_WORK(blockVisits, 1);
     if (!isFree(blk))
     { // it is a used block
       size_t bruttoSize = (char*)HDR_PTR(blk->next) - (char*)blk;
@@ -713,9 +2111,13 @@ void yalloc_defrag_commit(void * pool_)
       blk->next = (end + bruttoSize) >> 1;
 
       lastUsed = (Header*)((char*)pool + end);
+      if (isTagged(ctrl)) // the tag moves with the block (the tags of the blocks behind it are at higher offsets, so they are not overwritten)
+        set_tag(pool, ctrl, lastUsed, tagOf(pool, ctrl, blk));
       VALGRIND_MAKE_MEM_UNDEFINED(lastUsed, (char*)blk - (char*)lastUsed);
+      if (lastUsed != blk)
+        COUNT_WORK(bytesMoved, bruttoSize);
       memmove(lastUsed, blk, bruttoSize);
-      VALGRIND_MEMPOOL_CHANGE(pool, blk + 1, lastUsed + 1, bruttoSize - sizeof(Header));
+      VALGRIND_MEMPOOL_CHANGE(pool_, blk + 1, lastUsed + 1, bruttoSize - sizeof(Header));
 
       end += bruttoSize;
       blk = next;
@@ -728,6 +2130,16 @@ void yalloc_defrag_commit(void * pool_)
   internal_assert(isNil(blk->next));
   internal_assert(!isFree(blk));
 
+  _reset_free_list(pool, ctrl);
+
+  if (isAdaptive(ctrl))
+  { // the fragmentation that was observed so far is gone
+    ctrl->defragSuggested = 0;
+    ctrl->windowAllocs = 0;
+    ctrl->windowVisits = 0;
+    ctrl->windowFragFailures = 0;
+  }
+
   if (lastUsed)
   {
     Header * gap = HDR_PTR(lastUsed->next);
@@ -745,6 +2157,7 @@ void yalloc_defrag_commit(void * pool_)
       gap[1].prev = NIL;
       gap[1].next = NIL;
       pool->prev = blk->prev = HDR_OFFSET(gap);
+      update_bucket(pool, ctrl, gap);
     }
     else
     { // there is a gap, but it is too small to be used as free-list-node, so just make it padding of the last used block
@@ -756,9 +2169,242 @@ void yalloc_defrag_commit(void * pool_)
   else
   { // the pool is empty
     pool->prev = 1;
+    update_bucket(pool, ctrl, pool);
+  }
+
+  if (tracksZero(ctrl))
+  { // everything behind the links of the free block at the end (if there is one) was moved away
+    Header * mark = isFree(HDR_PTR(blk->prev)) ? HDR_PTR(blk->prev) + 2 : blk;
+    clear_to_zero_mark(pool, ctrl, mark);
   }
 
   internal_assert(!_yalloc_defrag_in_progress(pool));
-  _yalloc_validate(pool);
+  _yalloc_validate(pool, ctrl);
+  _protect_pool(pool_);
+}
+
+unsigned yalloc_policy(void * pool)
+{
+  _unprotect_pool(pool);
+  unsigned policy = policyOf(getControl(pool));
+  _protect_pool(pool);
+  return policy;
+}
+
+unsigned yalloc_policy_switches(void * pool)
+{
+  _unprotect_pool(pool);
+  Control * ctrl = getControl(pool);
+  unsigned switches = isAdaptive(ctrl) ? ctrl->switches : 0;
+  _protect_pool(pool);
+  return switches;
+}
+
+int yalloc_defrag_suggested(void * pool)
+{
+  _unprotect_pool(pool);
+  Control * ctrl = getControl(pool);
+  int suggested = isAdaptive(ctrl) && ctrl->defragSuggested;
+  _protect_pool(pool);
+  return suggested;
+}
+
+unsigned yalloc_tag_of(void * pool_, void * p)
+{
+  _unprotect_pool(pool_);
+  Control * ctrl = getControl(pool_);
+  Header * pool = getRoot(pool_, ctrl);
+  unsigned tag = 0;
+  if (isTagged(ctrl))
+  {
+    _validate_user_ptr(pool, p);
+    tag = tagOf(pool, ctrl, (Header*)p - 1);
+  }
+
+  _protect_pool(pool_);
+  return tag;
+}
+
+size_t yalloc_tag_bytes(void * pool, unsigned tag)
+{
+  assert(tag < YALLOC_NUM_TAGS);
+  _unprotect_pool(pool);
+  Control * ctrl = getControl(pool);
+  size_t bytes = isTagged(ctrl) ? getTagStats(ctrl)[tag].bytes : 0;
+  _protect_pool(pool);
+  return bytes;
+}
+
+size_t yalloc_tag_blocks(void * pool, unsigned tag)
+{
+  assert(tag < YALLOC_NUM_TAGS);
+  _unprotect_pool(pool);
+  Control * ctrl = getControl(pool);
+  size_t blocks = isTagged(ctrl) ? getTagStats(ctrl)[tag].blocks : 0;
+  _protect_pool(pool);
+  return blocks;
+}
+
+void yalloc_set_tag_quota(void * pool, unsigned tag, size_t quota)
+{
+  assert(tag < YALLOC_NUM_TAGS);
+  _unprotect_pool(pool);
+  Control * ctrl = getControl(pool);
+  assert(isTagged(ctrl));
+  getTagStats(ctrl)[tag].quota = quota < MAX_POOL_SIZE ? (uint32_t)quota : MAX_POOL_SIZE;
   _protect_pool(pool);
 }
+
+size_t yalloc_checkpoint(void * pool_)
+{
+  assert_is_pool(pool_);
+  _unprotect_pool(pool_);
+  Control * ctrl = getControl(pool_);
+  size_t checkpoint = 0;
+  if (ctrl && ctrl->undoCapacity)
+  {
+    assert(!_yalloc_defrag_in_progress(getRoot(pool_, ctrl)));
+    assert(ctrl->undoDepth < 0xFFFF);
+    if (!ctrl->undoDepth)
+    { // the log of released checkpoints may be left over if the process died in yalloc_checkpoint_release() (see there)
+      ctrl->undoUsed = 0;
+      WRITE_BARRIER();
+    }
+    ++ctrl->undoDepth;
+    checkpoint = (size_t)ctrl->undoUsed + 1; // the position in the log plus one, so 0 is never a valid checkpoint
+  }
+
+  _protect_pool(pool_);
+  return checkpoint;
+}
+
+#if USE_VALGRIND
+// Registers the used blocks with valgrind again after a rollback (which blocks are used has changed). Their content is
+// treated as defined, because it is not recorded which bytes where undefined.
+static void _valgrind_rebuild(void * pool_, Control * ctrl, Header * pool)
+{
+  VALGRIND_DESTROY_MEMPOOL(pool_);
+  VALGRIND_CREATE_MEMPOOL(pool_, 0, 0);
+  VALGRIND_MAKE_MEM_DEFINED(pool, (char*)(HDR_PTR(ctrl->last) + 1) - (char*)pool);
+  for (Header * blk = pool; !isNil(blk->next); blk = HDR_PTR(blk->next))
+  {
+    if (!isFree(blk))
+      VALGRIND_MEMPOOL_ALLOC(pool_, blk + 1, payloadSize(pool, blk));
+  }
+}
+#else
+static void _valgrind_rebuild(void * pool_, Control * ctrl, Header * pool){(void)pool_; (void)ctrl; (void)pool;}
+#endif
+
+int yalloc_rollback(void * pool_, size_t checkpoint)
+{
+  assert_is_pool(pool_);
+  _unprotect_pool(pool_);
+  Control * ctrl = getControl(pool_);
+  assert(ctrl && ctrl->undoDepth); // there must be a checkpoint
+  if (ctrl->undoUsed == UNDO_OVERFLOW)
+  {
+    _protect_pool(pool_);
+    return -1;
+  }
+
+  assert(checkpoint && checkpoint - 1 <= ctrl->undoUsed); // the checkpoint must not be behind an earlier rollback
+
+  // Restore the recorded words in reverse order, so every word ends up with the content it had at the checkpoint. An
+  // entry is dropped only after its word was written, so a rollback that is interrupted can just be done again.
+  UndoEntry * log = getUndoLog(ctrl);
+  while (ctrl->undoUsed >= checkpoint)
+  {
+    UndoEntry * e = &log[ctrl->undoUsed - 1];
+    uint16_t * w = (uint16_t*)ctrl + (size_t)e->word * 2;
+    VALGRIND_MAKE_MEM_DEFINED(w, sizeof(Header));
+    w[0] = e->old[0];
+    w[1] = e->old[1];
+    WRITE_BARRIER();
+    --ctrl->undoUsed;
+  }
+
+  Header * pool = getRoot(pool_, ctrl);
+  _valgrind_rebuild(pool_, ctrl, pool);
+  _yalloc_validate(pool, ctrl);
+  _protect_pool(pool_);
+  return 0;
+}
+
+void yalloc_checkpoint_release(void * pool_, size_t checkpoint)
+{
+  assert_is_pool(pool_);
+  _unprotect_pool(pool_);
+  Control * ctrl = getControl(pool_);
+  assert(ctrl && ctrl->undoDepth && checkpoint); // there must be a checkpoint
+  (void)checkpoint;
+  if (ctrl->undoDepth == 1)
+  { // nothing can be rolled back anymore, so the log starts over. It is emptied before the depth drops, so a process
+    // that dies in between leaves a checkpoint with an empty log and never a log without a checkpoint (which the next
+    // checkpoint would include).
+    ctrl->undoUsed = 0;
+    WRITE_BARRIER();
+  }
+  --ctrl->undoDepth;
+
+  _protect_pool(pool_);
+}
+
+void yalloc_reset(void * pool_)
+{
+  assert_is_pool(pool_);
+  _unprotect_pool(pool_);
+  Control * ctrl = getControl(pool_);
+  unsigned flags = ctrl ? ctrl->flags : 0;
+  size_t size;
+  if (isBitmap(ctrl))
+  {
+    assert(!ctrl->defragging);
+    size = ctrl->size + (size_t)ctrl->numGranules * 4;
+  }
+  else
+  {
+    Header * pool = getRoot(pool_, ctrl);
+    assert(!_yalloc_defrag_in_progress(pool));
+
+    // pools with a control block remember their end, plain pools have to walk there
+    Header * last = pool;
+    if (ctrl)
+      last = HDR_PTR(ctrl->last);
+    else
+    {
+      while (!isNil(last->next))
+        last = HDR_PTR(last->next);
+    }
+
+    size = (char*)(last + 1) - (char*)pool_;
+  }
+
+  uint32_t quotas[YALLOC_NUM_TAGS];
+  for (unsigned i = 0; i < YALLOC_NUM_TAGS; ++i)
+    quotas[i] = isTagged(ctrl) ? getTagStats(ctrl)[i].quota : 0;
+
+#if USE_VALGRIND
+  VALGRIND_DESTROY_MEMPOOL(pool_);
+  VALGRIND_MAKE_MEM_UNDEFINED(pool_, size);
+#endif
+
+  int err = yalloc_init_ex(pool_, size, flags);
+  assert(!err); // the same size and flags worked before
+  (void)err;
+
+  if (flags & YALLOC_MEMORY_IS_ZERO)
+  { // the old allocations are still in the memory
+    _unprotect_pool(pool_);
+    ctrl->zeroFrom = (uint16_t)(isBitmap(ctrl) ? ctrl->numGranules : ctrl->last / 2);
+    _protect_pool(pool_);
+  }
+
+  if (flags & YALLOC_TAGGED)
+  {
+    _unprotect_pool(pool_);
+    for (unsigned i = 0; i < YALLOC_NUM_TAGS; ++i)
+      getTagStats(ctrl)[i].quota = quotas[i];
+    _protect_pool(pool_);
+  }
+}
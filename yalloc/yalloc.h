@@ -8,6 +8,11 @@ API of the yalloc allocator.
 #define YALLOC_H
 
 #include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
 
 /**
 Maximum supported pool size. yalloc_init() will fail for larger pools.
@@ -30,6 +35,181 @@ temporarily.
  */
 int yalloc_init(void * pool, size_t size);
 
+/**
+Flag for yalloc_init_ex(): Keep the list of free blocks sorted by address.
+
+yalloc_free() inserts freed blocks at their address-ordered position instead of
+the front of the free list. Together with first fit this packs allocations
+toward the beginning of the pool, leaving bigger contiguous free ranges at the
+end (which reduces how often the pool needs to be defragmented). The pool
+finds the position of a freed block through its free neighbours, or else
+through the first free block of its address range (of 128 to 512 bytes, 2
+bytes of metadata each), so yalloc_free() walks at most 32 free blocks.
+*/
+#define YALLOC_ADDRESS_ORDERED 0x1
+
+/**
+Flag for yalloc_init_ex(): Use next fit instead of first fit allocation.
+
+yalloc_alloc() does not start its search at the front of the free list but at
+the free block behind the previous allocation (wrapping around at the end of
+the free list). This avoids scanning the same small fragments at the front of
+the free list over and over again, which speeds up FIFO-like workloads (e.g.
+message queues) where blocks are freed in roughly the order they were
+allocated. Can be combined with YALLOC_ADDRESS_ORDERED.
+*/
+#define YALLOC_NEXT_FIT 0x2
+
+/**
+Flag for yalloc_init_ex(): Use best fit instead of first fit allocation.
+
+yalloc_alloc() takes the smallest free block that fits (it stops searching at
+a block that fits exactly). This searches the whole free list for most
+allocations but keeps big free blocks available for big allocations. Can not
+be combined with YALLOC_NEXT_FIT.
+*/
+#define YALLOC_BEST_FIT 0x4
+
+/**
+Flag for yalloc_init_ex(): Switch the search policy of yalloc_alloc()
+automatically.
+
+The pool observes the length of the searches and the fragmentation of its free
+space (1 - largest free block / all free space) over windows of allocations and
+chooses the policy for the next window: Best fit when the free space is
+fragmented, next fit when searches get long and first fit otherwise. The
+initial policy is first fit (or next/best fit if YALLOC_NEXT_FIT or
+YALLOC_BEST_FIT is passed too). See yalloc_policy(), yalloc_policy_switches()
+and yalloc_defrag_suggested().
+*/
+#define YALLOC_ADAPTIVE 0x8
+
+/**
+Flag for yalloc_init_ex(): Use the bitmap engine instead of linked Headers.
+
+The pool keeps one bit per 4 byte granule in a bitmap behind the control block
+(which takes 1/33 of the pool) and finds free ranges by scanning the bitmap a
+32 bit word at a time instead of following the free list through the whole
+pool. Every block still has a 4 byte header that stores its size. All
+functions of this API work the same way for these pools (lifetime hints of
+yalloc_alloc_hint() are ignored). Can only be combined with
+YALLOC_OUT_OF_BAND and YALLOC_MEMORY_IS_ZERO.
+*/
+#define YALLOC_BITMAP 0x10
+
+/**
+Flag for yalloc_init_ex(): Keep all metadata out of the blocks (only together
+with YALLOC_BITMAP).
+
+Blocks have no header, so user data is packed back-to-back without gaps and
+allocation and deallocation only touch the dense bitmaps at the start of the
+pool, never the memory of other blocks. The end of every block is marked in a
+second bitmap, which together with a small table for defragmentation takes
+about 1/14 of the pool (instead of 1/33 for the bitmap plus 4 bytes per
+block).
+*/
+#define YALLOC_OUT_OF_BAND 0x20
+
+/**
+Flag for yalloc_init_ex(): Remember a tag for every block and count the bytes
+and blocks of every tag.
+
+Blocks get their tag from yalloc_alloc_tagged() (yalloc_alloc() uses tag 0).
+The tags take 4 bits per 8 bytes of the pool plus 12 bytes per tag for the
+statistics. See yalloc_tag_bytes(), yalloc_tag_blocks() and
+yalloc_set_tag_quota(). Can not be combined with YALLOC_BITMAP.
+*/
+#define YALLOC_TAGGED 0x40
+
+/**
+Flag for yalloc_init_ex(): The memory of the pool is zero (like static
+memory), so yalloc_calloc() does not have to clear memory that was never used.
+
+The pool remembers up to where it has ever been used and yalloc_calloc() only
+clears the part of an allocation in front of that. yalloc_defrag_commit()
+clears the memory that was used before but is free after the
+defragmentation, so this keeps working after defragmentation. Allocations with
+YALLOC_LONG_LIVED are placed at the end of free blocks and make the whole free
+block in front of them count as used. yalloc_reset() keeps the memory as it is,
+so afterwards only the free space behind a defragmentation is known to be zero
+again.
+*/
+#define YALLOC_MEMORY_IS_ZERO 0x80
+
+/**
+Number of tags of a YALLOC_TAGGED pool (tags are 0 to YALLOC_NUM_TAGS - 1).
+*/
+#define YALLOC_NUM_TAGS 16
+
+/**
+Flag for yalloc_init_ex(): Reserve an undo log with room for the given number
+of entries for yalloc_checkpoint() and yalloc_rollback().
+
+The log takes 6 bytes per entry (the number of entries is rounded up to a
+multiple of 64, at most 8128 entries are supported). An allocation records up
+to 13 entries, a deallocation up to 18 (3 more for YALLOC_TAGGED). Can not be
+combined with YALLOC_BITMAP.
+*/
+#define YALLOC_UNDO_LOG(entries) ((((unsigned)(entries) + 63u) / 64u) << 8)
+
+/**
+Creates a pool with non-default behavior inside a given buffer.
+
+With nonzero flags the pool starts with a small control block (68 bytes plus
+the address ranges of YALLOC_ADDRESS_ORDERED, the tags of YALLOC_TAGGED and the undo log of YALLOC_UNDO_LOG()) that holds the state which is needed for the
+selected behavior, which is taken from the given buffer. All other functions are used the same way as
+for pools that where created with yalloc_init().
+
+@param pool See yalloc_init().
+@param size See yalloc_init().
+@param flags Combination of YALLOC_ADDRESS_ORDERED, YALLOC_NEXT_FIT,
+YALLOC_BEST_FIT, YALLOC_ADAPTIVE, YALLOC_BITMAP, YALLOC_OUT_OF_BAND,
+YALLOC_TAGGED, YALLOC_MEMORY_IS_ZERO, YALLOC_UNDO_LOG() or 0 which is the same as calling yalloc_init().
+@return 0 on success, nonzero if the size is not supported or unknown flags
+where passed.
+*/
+int yalloc_init_ex(void * pool, size_t size, unsigned flags);
+
+/** Search policy of yalloc_alloc(): Take the first free block that fits. */
+#define YALLOC_POLICY_FIRST_FIT 0
+
+/** Search policy of yalloc_alloc(): Continue behind the previous allocation (see YALLOC_NEXT_FIT). */
+#define YALLOC_POLICY_NEXT_FIT 1
+
+/** Search policy of yalloc_alloc(): Take the smallest free block that fits (see YALLOC_BEST_FIT). */
+#define YALLOC_POLICY_BEST_FIT 2
+
+/**
+Returns the search policy that yalloc_alloc() currently uses.
+
+@param pool The starting address of an initialized pool.
+@return One of the YALLOC_POLICY_* constants. It only changes over time for
+pools that where created with YALLOC_ADAPTIVE.
+*/
+unsigned yalloc_policy(void * pool);
+
+/**
+Returns how often a YALLOC_ADAPTIVE pool switched its search policy.
+
+@param pool The starting address of an initialized pool.
+@return Number of switches (saturates at 65535), always 0 for pools that are
+not adaptive.
+*/
+unsigned yalloc_policy_switches(void * pool);
+
+/**
+Tells if a YALLOC_ADAPTIVE pool would benefit from defragmentation.
+
+This is the case if allocations failed during the last window of allocations
+although there was enough free space in total, or if the free space is highly
+fragmented. The suggestion is cleared by yalloc_defrag_commit().
+
+@param pool The starting address of an initialized pool.
+@return Nonzero if defragmentation is suggested, always 0 for pools that are not
+adaptive.
+*/
+int yalloc_defrag_suggested(void * pool);
+
 /**
 Deinitializes the buffer that is used by the pool and makes it available for other use.
 
@@ -55,6 +235,109 @@ space in total.
 */
 void * yalloc_alloc(void * pool, size_t size);
 
+/**
+Hint for yalloc_alloc_hint(): The block will be freed soon. It is carved from
+the low end of a free block (which is what yalloc_alloc() does).
+*/
+#define YALLOC_SHORT_LIVED 0x1
+
+/**
+Hint for yalloc_alloc_hint(): The block will live long. It is carved from the
+high end of a free block, so long-lived blocks do not pin fragments between the
+short-lived ones.
+*/
+#define YALLOC_LONG_LIVED 0x2
+
+/**
+Allocates a zero initialized array from a pool.
+
+This function mimics calloc(). For pools with YALLOC_MEMORY_IS_ZERO only the
+part of the memory that was used before is cleared.
+
+@param pool The starting address of an initialized pool.
+@param num Number of elements.
+@param size Size of an element.
+@return See yalloc_alloc(). \c NULL is returned as well if num * size
+overflows.
+*/
+void * yalloc_calloc(void * pool, size_t num, size_t size);
+
+/**
+Allocates a block of memory from a pool with a hint about its lifetime.
+
+Keeping short-lived and long-lived blocks apart keeps bigger contiguous free
+ranges available when the short-lived blocks are freed. YALLOC_SHORT_LIVED
+searches like yalloc_alloc() and uses the low end of the free block.
+YALLOC_LONG_LIVED looks for the highest free block that fits and uses its high
+end: In pools with YALLOC_ADDRESS_ORDERED the search walks the address ranges
+from the top and stops in the first one with a fitting block, in all other pools
+it walks the whole free list (so it takes time proportional to the number of
+free blocks, like best fit). If the free block is too small to be split then the
+whole block is used, regardless of the hint.
+
+@param pool The starting address of an initialized pool.
+@param size Number of bytes to allocate.
+@param hint YALLOC_SHORT_LIVED or YALLOC_LONG_LIVED.
+@return See yalloc_alloc().
+*/
+void * yalloc_alloc_hint(void * pool, size_t size, unsigned hint);
+
+/**
+Allocates a block of memory from a pool on behalf of a tag.
+
+The block and its size are added to the statistics of the tag until it is
+freed. The tag is ignored for pools without YALLOC_TAGGED.
+
+@param pool The starting address of an initialized pool.
+@param size Number of bytes to allocate.
+@param tag The tag of the block (less than YALLOC_NUM_TAGS).
+@return See yalloc_alloc(). \c NULL is returned as well if the allocation
+would exceed the quota of the tag.
+*/
+void * yalloc_alloc_tagged(void * pool, size_t size, unsigned tag);
+
+/**
+Returns the tag of an allocation of a YALLOC_TAGGED pool.
+
+@param pool The starting address of the initialized pool the allocation comes from.
+@param p An address that was returned from yalloc_alloc() of the same pool.
+@return The tag that was passed to yalloc_alloc_tagged() (0 for yalloc_alloc()
+and for pools without YALLOC_TAGGED).
+*/
+unsigned yalloc_tag_of(void * pool, void * p);
+
+/**
+Returns the number of bytes that are allocated with a tag.
+
+@param pool The starting address of an initialized pool.
+@param tag The tag (less than YALLOC_NUM_TAGS).
+@return Sum of the yalloc_block_size() of all allocations with the tag (always
+0 for pools without YALLOC_TAGGED).
+*/
+size_t yalloc_tag_bytes(void * pool, unsigned tag);
+
+/**
+Returns the number of allocations with a tag.
+
+@param pool The starting address of an initialized pool.
+@param tag The tag (less than YALLOC_NUM_TAGS).
+@return Number of allocations (always 0 for pools without YALLOC_TAGGED).
+*/
+size_t yalloc_tag_blocks(void * pool, unsigned tag);
+
+/**
+Limits the bytes that can be allocated with a tag.
+
+Allocations that would exceed the quota fail. Allocations that exist already
+are not affected by a quota (even if they exceed it). The quotas are kept by
+yalloc_reset().
+
+@param pool The starting address of an initialized YALLOC_TAGGED pool.
+@param tag The tag (less than YALLOC_NUM_TAGS).
+@param quota Maximum of yalloc_tag_bytes() for the tag or 0 for no limit.
+*/
+void yalloc_set_tag_quota(void * pool, unsigned tag, size_t quota);
+
 /**
 Returns an allocation to a pool.
 
@@ -67,6 +350,26 @@ The pool must not be in the "defragmenting" state when this function is called.
 */
 void yalloc_free(void * pool, void * p);
 
+/**
+Frees all allocations of a pool that have a tag.
+
+A single walk over the pool in address order turns every run of neighbouring
+blocks that are free or have the tag into one free block and rebuilds the free
+list in address order on the way, so no block has to be unlinked from the free
+list or inserted at its position. This takes time proportional to the number of
+blocks in the pool (not to the number of blocks that are freed), so it is
+cheaper than freeing the allocations one by one if the tag owns a good part of
+the blocks or if the pool keeps its free list address ordered. Tags can be used
+as epochs this way (e.g. one tag per session or per frame).
+
+The pool must not be in the "defragmenting" state when this function is called.
+
+@param pool The starting address of an initialized pool.
+@param tag The tag (less than YALLOC_NUM_TAGS). All allocations of pools
+without YALLOC_TAGGED have tag 0.
+*/
+void yalloc_free_all(void * pool, unsigned tag);
+
 /**
 Returns the maximum size of a successful allocation (assuming a completely unfragmented heap).
 
@@ -151,6 +454,114 @@ Tells if the pool is in the "defragmenting" state (after a @ref yalloc_defrag_st
 */
 int yalloc_defrag_in_progress(void * pool);
 
+/**
+A 16bit reference to memory in a pool (see yalloc_ptr_to_off()).
+*/
+typedef uint16_t YallocOffset;
+
+/**
+The YallocOffset of \c NULL. The start of a pool is never user data, so no
+address in a pool has this offset.
+*/
+#define YALLOC_NULL_OFFSET 0
+
+/**
+Turns an address in a pool into a 16bit offset.
+
+Any 32bit aligned address in an allocation (not only its start) has an offset,
+because the offset counts 32bit words from the start of the pool (which can be
+at most MAX_POOL_SIZE / 4). Objects in a pool can store offsets instead of
+pointers to each other, which saves space and keeps them valid when the pool
+is mapped at another address (see yalloc_persist.h).
+
+@param pool The starting address of an initialized pool.
+@param p A 32bit aligned address in an allocation of that pool or \c NULL.
+@return The offset of the address or YALLOC_NULL_OFFSET if it is \c NULL.
+*/
+YallocOffset yalloc_ptr_to_off(void * pool, void * p);
+
+/**
+Turns an offset from yalloc_ptr_to_off() back into an address.
+
+@param pool The starting address of an initialized pool.
+@param offset An offset in that pool or YALLOC_NULL_OFFSET.
+@return The address or \c NULL for YALLOC_NULL_OFFSET.
+*/
+void * yalloc_off_to_ptr(void * pool, YallocOffset offset);
+
+/**
+Like @ref yalloc_defrag_address() for the offset of an allocation.
+
+@param pool The starting address of the initialized pool the allocation comes from.
+@param offset The offset of an allocation in that pool (of its start) or YALLOC_NULL_OFFSET.
+@return The offset the allocation will have after @ref yalloc_defrag_commit() is called.
+*/
+YallocOffset yalloc_defrag_offset(void * pool, YallocOffset offset);
+
+/**
+Takes a checkpoint that yalloc_rollback() can return the pool to.
+
+The pool must have been created with YALLOC_UNDO_LOG(). From now on
+yalloc_alloc() and yalloc_free() record the metadata they change in the undo
+log, until the checkpoint is released with yalloc_checkpoint_release().
+Checkpoints can be nested (they have to be released in reverse order).
+yalloc_defrag_start() invalidates all checkpoints.
+
+The pool must not be in the "defragmenting" state when this function is called.
+
+@param pool The starting address of an initialized pool.
+@return The checkpoint or 0 if the pool has no undo log.
+*/
+size_t yalloc_checkpoint(void * pool);
+
+/**
+Returns a pool to the allocation state it had when a checkpoint was taken.
+
+Takes time proportional to the number of changes since the checkpoint (not to
+the size of the pool). Allocations that where made after the checkpoint become
+invalid and allocations that where freed after the checkpoint are valid again.
+Their content is only intact if the memory was not reused in the meantime.
+The statistics of YALLOC_ADAPTIVE are not rolled back. The checkpoint stays
+valid, so the pool can be rolled back to it again.
+
+@param pool The starting address of an initialized pool.
+@param checkpoint A checkpoint from yalloc_checkpoint() that was not released.
+Checkpoints that where taken after it can not be rolled back to anymore (they
+still have to be released).
+@return 0 on success, nonzero if the undo log overflowed or
+yalloc_defrag_start() was called since the checkpoint was taken (the pool is
+not changed then).
+*/
+int yalloc_rollback(void * pool, size_t checkpoint);
+
+/**
+Releases the most recent checkpoint of a pool.
+
+Nothing is recorded anymore when the last checkpoint was released and the
+whole undo log is available again for the next checkpoint.
+
+@param pool The starting address of an initialized pool.
+@param checkpoint The most recent checkpoint from yalloc_checkpoint().
+*/
+void yalloc_checkpoint_release(void * pool, size_t checkpoint);
+
+/**
+Frees all allocations of a pool at once.
+
+The pool is initialized again with the same size and flags, which releases all
+checkpoints. This takes constant time only for pools from yalloc_init_ex()
+without YALLOC_BITMAP and YALLOC_TAGGED. Otherwise it takes time proportional
+to the size of the pool: Pools from yalloc_init() walk over all blocks to find
+their end, YALLOC_BITMAP pools clear their bitmap (1/33 of the pool) and
+YALLOC_TAGGED pools clear the tags of their blocks (1/16 of the pool). Either
+way it is faster than freeing the allocations one by one.
+
+The pool must not be in the "defragmenting" state when this function is called.
+
+@param pool The starting address of an initialized pool.
+*/
+void yalloc_reset(void * pool);
+
 
 /**
 Helper function that dumps the state of the pool to stdout.
@@ -165,4 +576,8 @@ that are not interested in the internal structure of the implementation.
 void yalloc_dump(void * pool, char * name);
 
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif // YALLOC_H
@@ -0,0 +1,58 @@
+#include "yalloc.h"
+#include "yalloc_arena.h"
+
+#include <assert.h>
+
+int yalloc_arena_init(YallocArena * arena, void * pool, size_t size)
+{
+  size = (size + 3) / 4 * 4;
+  arena->pool = pool;
+  arena->region = (char*)yalloc_alloc(pool, size);
+  arena->size = arena->region ? (uint32_t)size : 0;
+  arena->used = 0;
+  return arena->region ? 0 : -1;
+}
+
+void yalloc_arena_deinit(YallocArena * arena)
+{
+  yalloc_free(arena->pool, arena->region);
+  arena->region = NULL;
+  arena->size = 0;
+  arena->used = 0;
+}
+
+void * yalloc_arena_alloc(YallocArena * arena, size_t size)
+{
+  size = (size + 3) / 4 * 4;
+  if (!size || size > arena->size - arena->used)
+    return NULL;
+
+  char * p = arena->region + arena->used;
+  arena->used += (uint32_t)size;
+  return p;
+}
+
+size_t yalloc_arena_mark(YallocArena * arena)
+{
+  return arena->used;
+}
+
+void yalloc_arena_release(YallocArena * arena, size_t mark)
+{
+  assert(mark <= arena->used); // the mark must not be behind allocations that where already released
+  arena->used = (uint32_t)mark;
+}
+
+void * yalloc_arena_defrag_address(YallocArena * arena, void * p)
+{
+  if (!p)
+    return NULL;
+
+  assert((char*)p >= arena->region && (char*)p < arena->region + arena->used); // p must be an allocation of the arena
+  return (char*)yalloc_defrag_address(arena->pool, arena->region) + ((char*)p - arena->region);
+}
+
+void yalloc_arena_defrag(YallocArena * arena)
+{
+  arena->region = (char*)yalloc_defrag_address(arena->pool, arena->region);
+}
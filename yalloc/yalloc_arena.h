@@ -0,0 +1,113 @@
+/**
+@file
+
+Optional scratch arenas for temporary allocations that die together.
+
+This is only available if build with <tt>yalloc_arena.c</tt>. An arena
+reserves one block of a pool with yalloc_alloc() and serves allocations from
+it by bumping a pointer: Allocations have no header and there is no free list
+to search, split or join. Single allocations can not be freed. Instead the
+application takes a mark with yalloc_arena_mark() and later releases everything
+that was allocated behind the mark at once with yalloc_arena_release(). The
+whole region goes back to the pool with a single yalloc_free() in
+yalloc_arena_deinit().
+
+The region of an arena takes part in defragmentation of the pool like any
+other block (the allocations inside of it keep their position relative to the
+region):
+
+ 1. yalloc_defrag_start() for the pool.
+ 2. The application updates its pointers into the arena with
+    yalloc_arena_defrag_address().
+ 3. yalloc_arena_defrag() for every arena of the pool.
+ 4. yalloc_defrag_commit() for the pool.
+*/
+
+#ifndef YALLOC_ARENA_H
+#define YALLOC_ARENA_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+State of an arena.
+
+Initialize it with yalloc_arena_init(). The members are not meant to be
+modified by the application.
+*/
+typedef struct
+{
+  void * pool; ///< Pool the region is allocated from.
+  char * region; ///< Memory the allocations are served from.
+  uint32_t size; ///< Size of the region.
+  uint32_t used; ///< Bytes at the start of the region that are allocated.
+} YallocArena;
+
+/**
+Reserves the region of an arena.
+
+@param arena The arena to initialize.
+@param pool An initialized pool.
+@param size Size of the region (rounded up to a multiple of 4).
+@return 0 on success, nonzero if the region could not be allocated.
+*/
+int yalloc_arena_init(YallocArena * arena, void * pool, size_t size);
+
+/**
+Returns the region of an arena to its pool. All allocations of the arena become
+invalid.
+*/
+void yalloc_arena_deinit(YallocArena * arena);
+
+/**
+Allocates memory from an arena.
+
+@param arena The arena.
+@param size Number of bytes (rounded up to a multiple of 4).
+@return The allocated memory or \c NULL if the size is 0 or the rest of the
+region is too small.
+*/
+void * yalloc_arena_alloc(YallocArena * arena, size_t size);
+
+/**
+Returns a mark for the current fill level of an arena.
+*/
+size_t yalloc_arena_mark(YallocArena * arena);
+
+/**
+Releases all allocations that where made after a mark was taken.
+
+Marks that where taken after that mark become invalid.
+
+@param arena The arena.
+@param mark A mark from yalloc_arena_mark() (0 releases everything).
+*/
+void yalloc_arena_release(YallocArena * arena, size_t mark);
+
+/**
+Returns the post-defragmentation-address of an allocation of an arena.
+
+Must be called between yalloc_defrag_start() and yalloc_arena_defrag().
+
+@param arena The arena the allocation was made from.
+@param p The allocation or \c NULL (which returns \c NULL).
+*/
+void * yalloc_arena_defrag_address(YallocArena * arena, void * p);
+
+/**
+Updates an arena to the post-defragmentation-address of its region.
+
+Must be called after yalloc_arena_defrag_address() was called for all
+allocations and before yalloc_defrag_commit().
+*/
+void yalloc_arena_defrag(YallocArena * arena);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // YALLOC_ARENA_H
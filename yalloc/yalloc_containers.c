@@ -0,0 +1,350 @@
+#include "yalloc.h"
+#include "yalloc_containers.h"
+
+#include <assert.h>
+#include <string.h>
+
+// smallest capacity of a vector and smallest table of a map
+#define MIN_VECTOR_CAPACITY 4
+#define MIN_MAP_SHIFT 3
+
+// biggest capacity of a vector (its size and capacity are 16 bits and its elements are one allocation)
+static size_t maxCapacity(YallocVector const * vector)
+{
+  size_t capacity = MAX_POOL_SIZE / vector->elementSize;
+  return capacity < 0xFFFF ? capacity : 0xFFFF;
+}
+
+void yalloc_vector_init(YallocVector * vector, size_t elementSize)
+{
+  assert(elementSize && elementSize <= 0xFFFF);
+  vector->data = YALLOC_NULL_OFFSET;
+  vector->size = 0;
+  vector->capacity = 0;
+  vector->elementSize = (uint16_t)elementSize;
+}
+
+void yalloc_vector_deinit(void * pool, YallocVector * vector)
+{
+  yalloc_free(pool, yalloc_off_to_ptr(pool, vector->data));
+  vector->data = YALLOC_NULL_OFFSET;
+  vector->size = 0;
+  vector->capacity = 0;
+}
+
+int yalloc_vector_reserve(void * pool, YallocVector * vector, size_t capacity)
+{
+  if (capacity <= vector->capacity)
+    return 0;
+
+  if (capacity > maxCapacity(vector))
+    return -1;
+
+  void * data = yalloc_alloc(pool, capacity * vector->elementSize);
+  if (!data)
+    return -1;
+
+  void * old = yalloc_off_to_ptr(pool, vector->data);
+  if (old)
+  {
+    memcpy(data, old, (size_t)vector->size * vector->elementSize);
+    yalloc_free(pool, old);
+  }
+
+  vector->data = yalloc_ptr_to_off(pool, data);
+  vector->capacity = (uint16_t)capacity;
+  return 0;
+}
+
+void * yalloc_vector_push(void * pool, YallocVector * vector, void const * element)
+{
+  if (vector->size == vector->capacity)
+  {
+    size_t capacity = vector->capacity ? 2 * (size_t)vector->capacity : MIN_VECTOR_CAPACITY;
+    if (capacity > maxCapacity(vector) && vector->capacity < maxCapacity(vector))
+      capacity = maxCapacity(vector); // the last step is smaller
+    if (yalloc_vector_reserve(pool, vector, capacity))
+      return NULL;
+  }
+
+  void * p = yalloc_vector_at(pool, vector, vector->size++);
+  if (element)
+    memcpy(p, element, vector->elementSize);
+  return p;
+}
+
+void yalloc_vector_pop(YallocVector * vector)
+{
+  assert(vector->size);
+  --vector->size;
+}
+
+void * yalloc_vector_at(void * pool, YallocVector const * vector, size_t index)
+{
+  assert(index < vector->size);
+  return (char*)yalloc_off_to_ptr(pool, vector->data) + index * vector->elementSize;
+}
+
+void yalloc_vector_defrag(void * pool, YallocVector * vector)
+{
+  vector->data = yalloc_defrag_offset(pool, vector->data);
+}
+
+/*
+The table of a map is one allocation: A bitmap with one bit per slot that tells
+which slots are used (padded to 32 bits) followed by the slots. Collisions are
+resolved by linear probing. Removing an entry moves the entries behind it back
+into the gap where they belong (instead of leaving a tombstone), so a lookup can
+stop at the first unused slot.
+*/
+typedef struct
+{
+  uint32_t key;
+  uint32_t value;
+} Slot;
+
+static uint32_t * usedBits(void * pool, YallocMap const * map)
+{
+  return (uint32_t*)yalloc_off_to_ptr(pool, map->table);
+}
+
+static size_t bitmapWords(unsigned shift)
+{
+  return (((size_t)1 << shift) + 31) / 32;
+}
+
+static Slot * slots(void * pool, YallocMap const * map)
+{
+  return (Slot*)(usedBits(pool, map) + bitmapWords(map->capacityShift));
+}
+
+static int isUsed(uint32_t const * bits, size_t i)
+{
+  return (bits[i / 32] >> (i % 32)) & 1;
+}
+
+static size_t home(uint32_t key, unsigned shift)
+{
+  return (uint32_t)(key * 2654435761u) >> (32 - shift); // Fibonacci hashing
+}
+
+// returns the slot of a key or the unused slot where it would be inserted
+static size_t find(uint32_t const * bits, Slot const * table, unsigned shift, uint32_t key)
+{
+  size_t mask = ((size_t)1 << shift) - 1;
+  size_t i = home(key, shift);
+  while (isUsed(bits, i) && table[i].key != key)
+    i = (i + 1) & mask;
+  return i;
+}
+
+static int grow(void * pool, YallocMap * map)
+{
+  unsigned shift = map->capacityShift ? map->capacityShift + 1u : MIN_MAP_SHIFT;
+  size_t capacity = (size_t)1 << shift;
+  size_t tableSize = bitmapWords(shift) * 4 + capacity * sizeof(Slot);
+  if (tableSize > MAX_POOL_SIZE)
+    return -1;
+
+  uint32_t * bits = (uint32_t*)yalloc_alloc(pool, tableSize);
+  if (!bits)
+    return -1;
+
+  memset(bits, 0, bitmapWords(shift) * 4);
+  Slot * table = (Slot*)(bits + bitmapWords(shift));
+  if (map->capacityShift)
+  { // rehash all entries into the new table
+    uint32_t * oldBits = usedBits(pool, map);
+    Slot * oldTable = slots(pool, map);
+    for (size_t j = 0; j < ((size_t)1 << map->capacityShift); ++j)
+    {
+      if (!isUsed(oldBits, j))
+        continue;
+
+      size_t i = find(bits, table, shift, oldTable[j].key);
+      bits[i / 32] |= 1u << (i % 32);
+      table[i] = oldTable[j];
+    }
+    yalloc_free(pool, oldBits);
+  }
+
+  map->table = yalloc_ptr_to_off(pool, bits);
+  map->capacityShift = (uint16_t)shift;
+  return 0;
+}
+
+void yalloc_map_init(YallocMap * map)
+{
+  map->table = YALLOC_NULL_OFFSET;
+  map->count = 0;
+  map->capacityShift = 0;
+}
+
+void yalloc_map_deinit(void * pool, YallocMap * map)
+{
+  yalloc_free(pool, yalloc_off_to_ptr(pool, map->table));
+  yalloc_map_init(map);
+}
+
+int yalloc_map_put(void * pool, YallocMap * map, uint32_t key, uint32_t value)
+{
+  uint32_t * value_ = yalloc_map_get(pool, map, key);
+  if (value_)
+  {
+    *value_ = value;
+    return 0;
+  }
+
+  if ((map->count + 1u) * 4 > 3u << map->capacityShift && grow(pool, map))
+    return -1;
+
+  uint32_t * bits = usedBits(pool, map);
+  Slot * table = slots(pool, map);
+  size_t i = find(bits, table, map->capacityShift, key);
+  bits[i / 32] |= 1u << (i % 32);
+  table[i].key = key;
+  table[i].value = value;
+  ++map->count;
+  return 0;
+}
+
+uint32_t * yalloc_map_get(void * pool, YallocMap const * map, uint32_t key)
+{
+  if (!map->count)
+    return NULL;
+
+  uint32_t * bits = usedBits(pool, map);
+  Slot * table = slots(pool, map);
+  size_t i = find(bits, table, map->capacityShift, key);
+  return isUsed(bits, i) ? &table[i].value : NULL;
+}
+
+int yalloc_map_remove(void * pool, YallocMap * map, uint32_t key)
+{
+  if (!map->count)
+    return 0;
+
+  uint32_t * bits = usedBits(pool, map);
+  Slot * table = slots(pool, map);
+  size_t mask = ((size_t)1 << map->capacityShift) - 1;
+  size_t gap = find(bits, table, map->capacityShift, key);
+  if (!isUsed(bits, gap))
+    return 0;
+
+  // move entries behind the gap into it unless their home slot lies between the gap and them
+  for (size_t i = (gap + 1) & mask; isUsed(bits, i); i = (i + 1) & mask)
+  {
+    size_t h = home(table[i].key, map->capacityShift);
+    if (((i - h) & mask) >= ((i - gap) & mask))
+    {
+      table[gap] = table[i];
+      gap = i;
+    }
+  }
+
+  bits[gap / 32] &= ~(1u << (gap % 32));
+  --map->count;
+  return 1;
+}
+
+uint32_t * yalloc_map_next(void * pool, YallocMap const * map, size_t * position, uint32_t * key)
+{
+  if (!map->count)
+    return NULL;
+
+  uint32_t * bits = usedBits(pool, map);
+  Slot * table = slots(pool, map);
+  for (size_t i = *position; i < ((size_t)1 << map->capacityShift); ++i)
+  {
+    if (isUsed(bits, i))
+    {
+      *position = i + 1;
+      *key = table[i].key;
+      return &table[i].value;
+    }
+  }
+
+  *position = (size_t)1 << map->capacityShift;
+  return NULL;
+}
+
+void yalloc_map_defrag(void * pool, YallocMap * map)
+{
+  map->table = yalloc_defrag_offset(pool, map->table);
+}
+
+void yalloc_list_init(YallocList * list)
+{
+  list->first = YALLOC_NULL_OFFSET;
+  list->last = YALLOC_NULL_OFFSET;
+}
+
+static YallocListNode * node_at(void * pool, YallocOffset offset)
+{
+  return (YallocListNode*)yalloc_off_to_ptr(pool, offset);
+}
+
+void yalloc_list_push_back(void * pool, YallocList * list, YallocListNode * node)
+{
+  YallocOffset offset = yalloc_ptr_to_off(pool, node);
+  node->next = YALLOC_NULL_OFFSET;
+  node->prev = list->last;
+  if (list->last != YALLOC_NULL_OFFSET)
+    node_at(pool, list->last)->next = offset;
+  else
+    list->first = offset;
+  list->last = offset;
+}
+
+void yalloc_list_push_front(void * pool, YallocList * list, YallocListNode * node)
+{
+  YallocOffset offset = yalloc_ptr_to_off(pool, node);
+  node->prev = YALLOC_NULL_OFFSET;
+  node->next = list->first;
+  if (list->first != YALLOC_NULL_OFFSET)
+    node_at(pool, list->first)->prev = offset;
+  else
+    list->last = offset;
+  list->first = offset;
+}
+
+void yalloc_list_remove(void * pool, YallocList * list, YallocListNode * node)
+{
+  if (node->prev != YALLOC_NULL_OFFSET)
+    node_at(pool, node->prev)->next = node->next;
+  else
+    list->first = node->next;
+
+  if (node->next != YALLOC_NULL_OFFSET)
+    node_at(pool, node->next)->prev = node->prev;
+  else
+    list->last = node->prev;
+
+  node->next = YALLOC_NULL_OFFSET;
+  node->prev = YALLOC_NULL_OFFSET;
+}
+
+YallocListNode * yalloc_list_first(void * pool, YallocList const * list)
+{
+  return node_at(pool, list->first);
+}
+
+YallocListNode * yalloc_list_next(void * pool, YallocListNode const * node)
+{
+  return node_at(pool, node->next);
+}
+
+void yalloc_list_defrag(void * pool, YallocList * list)
+{
+  // the elements are still at their old addresses, so the old link to the next one is read before it is updated
+  for (YallocListNode * node = node_at(pool, list->first); node;)
+  {
+    YallocListNode * next = node_at(pool, node->next);
+    node->next = yalloc_defrag_offset(pool, node->next);
+    node->prev = yalloc_defrag_offset(pool, node->prev);
+    node = next;
+  }
+
+  list->first = yalloc_defrag_offset(pool, list->first);
+  list->last = yalloc_defrag_offset(pool, list->last);
+}
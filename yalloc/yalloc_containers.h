@@ -0,0 +1,247 @@
+/**
+@file
+
+Optional containers that live in a pool and refer to their memory by offsets.
+
+This is only available if build with <tt>yalloc_containers.c</tt>. The state of
+every container is a small struct that only holds YallocOffset values (see
+yalloc_ptr_to_off()) and counts, so it can be stored anywhere, including in
+allocations of the pool itself, and keeps working when the pool is mapped at
+another address (see yalloc_persist.h and yalloc_shm.h). All functions take
+the pool as parameter.
+
+ - YallocVector: a growable array of elements of one size.
+ - YallocMap: an open addressing hash map from uint32_t keys to uint32_t values
+   (e.g. YallocOffset values of objects).
+ - YallocList: an intrusive doubly linked list of allocations that start with a
+   YallocListNode.
+
+The containers take part in defragmentation without any code for their
+internal references:
+
+ 1. yalloc_defrag_start() for the pool.
+ 2. yalloc_vector_defrag(), yalloc_map_defrag() and yalloc_list_defrag() for
+    every container of the pool (before the application updates the elements
+    of a list, because the list follows its links through the old addresses).
+ 3. The application updates its own pointers (and offsets that it stores in
+    the elements).
+ 4. yalloc_defrag_commit() for the pool.
+*/
+
+#ifndef YALLOC_CONTAINERS_H
+#define YALLOC_CONTAINERS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "yalloc.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+State of a vector.
+
+Initialize it with yalloc_vector_init(). The members are not meant to be
+modified by the application.
+*/
+typedef struct
+{
+  YallocOffset data; ///< The elements.
+  uint16_t size; ///< Number of elements.
+  uint16_t capacity; ///< Number of elements that fit into data.
+  uint16_t elementSize; ///< Size of an element.
+} YallocVector;
+
+/**
+Initializes an empty vector (which does not allocate anything yet).
+
+@param vector The vector.
+@param elementSize Size of an element (a multiple of 4 keeps the elements 32bit
+aligned).
+*/
+void yalloc_vector_init(YallocVector * vector, size_t elementSize);
+
+/**
+Frees the elements of a vector and makes it empty.
+*/
+void yalloc_vector_deinit(void * pool, YallocVector * vector);
+
+/**
+Makes sure that a vector has space for some elements without growing.
+
+@return 0 on success, nonzero if the memory could not be allocated or the
+capacity is bigger than 65535 elements or MAX_POOL_SIZE bytes (the vector is
+not changed then).
+*/
+int yalloc_vector_reserve(void * pool, YallocVector * vector, size_t capacity);
+
+/**
+Appends an element to a vector. The capacity grows to twice its size if it is
+exhausted (but not beyond the limit of yalloc_vector_reserve()).
+
+@param pool The pool of the vector.
+@param vector The vector.
+@param element The element to copy into the vector or \c NULL to leave the new
+element uninitialized.
+@return The new element or \c NULL if the vector could not grow.
+*/
+void * yalloc_vector_push(void * pool, YallocVector * vector, void const * element);
+
+/**
+Removes the last element of a vector (which must not be empty).
+*/
+void yalloc_vector_pop(YallocVector * vector);
+
+/**
+Returns an element of a vector (the address is only valid until the vector
+grows or the pool is defragmented).
+
+@param pool The pool of the vector.
+@param vector The vector.
+@param index Index of the element (less than the size of the vector).
+*/
+void * yalloc_vector_at(void * pool, YallocVector const * vector, size_t index);
+
+/**
+Updates the offset of the elements of a vector.
+
+Must be called between yalloc_defrag_start() and yalloc_defrag_commit().
+*/
+void yalloc_vector_defrag(void * pool, YallocVector * vector);
+
+/**
+State of a hash map.
+
+Initialize it with yalloc_map_init(). The members are not meant to be modified
+by the application.
+*/
+typedef struct
+{
+  YallocOffset table; ///< Bitmap of used slots followed by the slots.
+  uint16_t count; ///< Number of entries.
+  uint16_t capacityShift; ///< Number of slots is 1 << capacityShift (0 if there is no table).
+} YallocMap;
+
+/**
+Initializes an empty map (which does not allocate anything yet).
+*/
+void yalloc_map_init(YallocMap * map);
+
+/**
+Frees the table of a map and makes it empty.
+*/
+void yalloc_map_deinit(void * pool, YallocMap * map);
+
+/**
+Adds an entry to a map or replaces the value of the entry with that key. The
+table grows to twice its size if it is filled to three quarters.
+
+@return 0 on success, nonzero if the table could not grow (the map is not
+changed then).
+*/
+int yalloc_map_put(void * pool, YallocMap * map, uint32_t key, uint32_t value);
+
+/**
+Returns the value of a key (the address is only valid until the next
+yalloc_map_put() or yalloc_map_remove() or until the pool is defragmented).
+
+@return The value or \c NULL if there is no entry with the key.
+*/
+uint32_t * yalloc_map_get(void * pool, YallocMap const * map, uint32_t key);
+
+/**
+Removes the entry with a key from a map.
+
+@return Nonzero if there was an entry with the key.
+*/
+int yalloc_map_remove(void * pool, YallocMap * map, uint32_t key);
+
+/**
+Iterates over the entries of a map (in no particular order).
+
+@param pool The pool of the map.
+@param map The map.
+@param position Position of the iteration (set it to 0 before the first call).
+@param key Receives the key of the entry.
+@return The value of the entry or \c NULL if there are no more entries.
+*/
+uint32_t * yalloc_map_next(void * pool, YallocMap const * map, size_t * position, uint32_t * key);
+
+/**
+Updates the offset of the table of a map.
+
+Must be called between yalloc_defrag_start() and yalloc_defrag_commit().
+*/
+void yalloc_map_defrag(void * pool, YallocMap * map);
+
+/**
+Links of an element of a YallocList. It must be at the start of an allocation.
+*/
+typedef struct
+{
+  YallocOffset next; ///< The next element.
+  YallocOffset prev; ///< The previous element.
+} YallocListNode;
+
+/**
+State of a list.
+
+Initialize it with yalloc_list_init(). The members are not meant to be modified
+by the application.
+*/
+typedef struct
+{
+  YallocOffset first; ///< The first element.
+  YallocOffset last; ///< The last element.
+} YallocList;
+
+/**
+Initializes an empty list.
+*/
+void yalloc_list_init(YallocList * list);
+
+/**
+Appends an element to a list.
+
+@param pool The pool of the list.
+@param list The list.
+@param node An allocation of the pool that starts with a YallocListNode and is
+not in a list.
+*/
+void yalloc_list_push_back(void * pool, YallocList * list, YallocListNode * node);
+
+/**
+Prepends an element to a list (see yalloc_list_push_back()).
+*/
+void yalloc_list_push_front(void * pool, YallocList * list, YallocListNode * node);
+
+/**
+Removes an element from its list (it is not freed).
+*/
+void yalloc_list_remove(void * pool, YallocList * list, YallocListNode * node);
+
+/**
+Returns the first element of a list or \c NULL if it is empty.
+*/
+YallocListNode * yalloc_list_first(void * pool, YallocList const * list);
+
+/**
+Returns the element behind another one or \c NULL if it is the last one.
+*/
+YallocListNode * yalloc_list_next(void * pool, YallocListNode const * node);
+
+/**
+Updates the links of all elements of a list.
+
+Must be called between yalloc_defrag_start() and yalloc_defrag_commit() and
+before the elements are used otherwise.
+*/
+void yalloc_list_defrag(void * pool, YallocList * list);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // YALLOC_CONTAINERS_H
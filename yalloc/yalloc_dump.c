@@ -1,3 +1,4 @@
+#include "yalloc.h"
 #include "yalloc_internals.h"
 
 #include <stdio.h>
@@ -10,10 +11,64 @@ static void printOffset(void * pool, char * name, uint16_t offset)
     printf("  %s: %td\n", name, (char*)HDR_PTR(offset) - (char*)pool);
 }
 
-void yalloc_dump(void * pool, char * name)
+void yalloc_dump(void * pool_, char * name)
 {
   printf("---- %s ----\n", name);
-  Header * cur = (Header*)pool;
+  Control * ctrl = getControl(pool_);
+  Header * pool = getRoot(pool_, ctrl);
+  if (ctrl)
+  {
+    printf("control block: %u bytes, flags 0x%x\n", (unsigned)ctrl->size, (unsigned)ctrl->flags);
+    if (ctrl->flags & (YALLOC_NEXT_FIT | YALLOC_ADAPTIVE))
+      printOffset(pool, "rover", ctrl->rover);
+    if (ctrl->flags & YALLOC_ADAPTIVE)
+      printf("  policy: %u (%u switches, defrag suggested: %u)\n", (unsigned)ctrl->policy, (unsigned)ctrl->switches, (unsigned)ctrl->defragSuggested);
+    if (ctrl->flags & YALLOC_MEMORY_IS_ZERO)
+      printf("  zero from: %u\n", (unsigned)ctrl->zeroFrom * 4);
+    if (ctrl->flags & YALLOC_TAGGED)
+    {
+      for (unsigned i = 0; i < YALLOC_NUM_TAGS; ++i)
+      {
+        TagStats * stats = &getTagStats(ctrl)[i];
+        if (stats->blocks || stats->quota)
+          printf("  tag %u: %u bytes in %u blocks, quota %u\n", i, (unsigned)stats->bytes, (unsigned)stats->blocks, (unsigned)stats->quota);
+      }
+    }
+  }
+
+  if (ctrl && (ctrl->flags & YALLOC_BITMAP))
+  { // print the runs of used and free granules, used runs block by block
+    uint32_t * bitmap = getBitmap(ctrl);
+    BlockHeader * granules = (BlockHeader*)pool;
+    printf("  %u granules, search starts at word %u, defragmenting: %u\n", (unsigned)ctrl->numGranules, (unsigned)ctrl->searchStart, (unsigned)ctrl->defragging);
+    size_t i = 0;
+    while (i < ctrl->numGranules)
+    {
+      if (bitmap[i / 32] >> (i % 32) & 1)
+      {
+        size_t n = granules[i].size;
+        if (ctrl->flags & YALLOC_OUT_OF_BAND)
+        { // the block ends at the next end bit
+          uint32_t * ends = getEndBitmap(ctrl);
+          for (n = 1; !(ends[(i + n - 1) / 32] >> ((i + n - 1) % 32) & 1); ++n)
+            ;
+        }
+        printf("%zu: used @%p\n  %zu granules\n", i * 4, (void*)&granules[i], n);
+        i += n;
+      }
+      else
+      {
+        size_t start = i;
+        while (i < ctrl->numGranules && !(bitmap[i / 32] >> (i % 32) & 1))
+          ++i;
+        printf("%zu: free @%p\n  %zu granules\n", start * 4, (void*)&granules[start], i - start);
+      }
+    }
+    fflush(stdout);
+    return;
+  }
+
+  Header * cur = pool;
   for (;;)
   {
     printf(isFree(cur) ? "%td: free @%p\n" : "%td: used @%p\n", (char*)cur - (char*)pool, cur);
@@ -25,7 +80,14 @@ void yalloc_dump(void * pool, char * name)
       printOffset(pool, "nextFree", cur[1].next);
     }
     else
+    {
       printf("  payload includes padding: %i\n", isPadded(cur));
+      if (ctrl && (ctrl->flags & YALLOC_TAGGED) && !isNil(cur->next))
+      {
+        size_t i = HDR_OFFSET(cur) >> 2;
+        printf("  tag: %u\n", getTags(ctrl)[i / 2] >> (i % 2 * 4) & 0xFu);
+      }
+    }
 
     if (isNil(cur->next))
       break;
@@ -3,6 +3,8 @@
 
 #include <stdint.h>
 
+#include "yalloc.h"
+
 typedef struct
 {
   uint16_t prev; // low bit set if free
@@ -13,12 +15,208 @@ typedef struct
 
 #define NIL 0xFFFEu
 
+// Keeps the compiler from moving writes across it. The undo log relies on this to match the pool at every instruction,
+// so a process that dies in the middle of a function leaves a pool that can be rolled back (see yalloc_persist.h).
+#if defined(__GNUC__)
+# define WRITE_BARRIER() __asm__ __volatile__("" ::: "memory")
+#else
+# define WRITE_BARRIER() ((void)0)
+#endif
+
 // return Header-address for a prev/next
 #define HDR_PTR(offset) ((Header*)((char*)pool + (((offset) & NIL)<<1)))
 
 // return a prev/next for a Header-address
 #define HDR_OFFSET(blockPtr) ((uint16_t)(((char*)blockPtr - (char*)pool) >> 1))
 
+/*
+Pools that are created with yalloc_init_ex() and nonzero flags start with a
+Control block. The first block of the pool (the "root", whose prev-field is the
+pointer to the first free block) follows directly after it and all offsets are
+relative to the root. So the code that deals with blocks works the same for
+both kinds of pools, it just has to use the root instead of the address that
+the user passed in.
+
+The marker overlays the next-field of the first block of a plain pool. That
+field can never be CONTROL_MARKER because the first block always has a
+successor (at least the Header at the end of the pool).
+*/
+
+#define CONTROL_MARKER 0xFFFFu
+#define CONTROL_MAGIC 0x7961u
+
+/*
+Address ordered pools split the pool into address ranges (buckets) of
+2 << bucketShift bytes and remember the first free block of every range, plus a
+bitmap of the ranges that have free blocks. The ranges are at least 128 bytes
+(MIN_BUCKET_SHIFT) and there are at most MAX_FREE_LIST_BUCKETS of them (so at
+most 512 bytes for the biggest pool). Free blocks are never neighbours, so a
+range holds at most one free block per 16 bytes and finding the position of a
+block in the free list walks a bounded number of free blocks.
+*/
+#define MAX_FREE_LIST_BUCKETS 256
+#define MIN_BUCKET_SHIFT 6
+
+/*
+Parameters of YALLOC_ADAPTIVE: The policy is chosen after every ADAPT_WINDOW
+allocations. Best fit is used when the fragmentation of the free space reaches
+ADAPT_FRAG_PERCENT (and kept until it drops below half of that), next fit when
+the allocations visited ADAPT_MAX_VISITS free blocks on average. Next fit is
+kept until the free space gets fragmented, because its searches are always
+short (which is the reason it was chosen). Defragmentation is suggested from
+ADAPT_DEFRAG_PERCENT on.
+*/
+#define ADAPT_WINDOW 64
+#define ADAPT_FRAG_PERCENT 50
+#define ADAPT_DEFRAG_PERCENT 75
+#define ADAPT_MAX_VISITS 8
+
+typedef struct
+{
+  uint16_t magic; // CONTROL_MAGIC
+  uint16_t marker; // CONTROL_MARKER
+  uint16_t flags; // YALLOC_* flags passed to yalloc_init_ex()
+  uint16_t size; // size of the control block in bytes (the root follows after it)
+  uint16_t bucketShift; // offset >> bucketShift gives the bucket of a block
+  union
+  {
+    uint16_t nonEmptyBuckets[MAX_FREE_LIST_BUCKETS / 16]; // bit b % 16 of word b / 16 is set if address range b has a free block (YALLOC_ADDRESS_ORDERED only)
+    struct
+    { // state of the bitmap engine (YALLOC_BITMAP only)
+      uint16_t numGranules; // number of 4 byte granules behind the control block and the bitmap
+      uint16_t searchStart; // all words of the bitmap in front of this one are completely used
+      uint16_t defragging; // nonzero between yalloc_defrag_start() and yalloc_defrag_commit()
+    };
+  };
+  uint16_t rover; // free block where the next search starts or NIL for the front of the free list (YALLOC_NEXT_FIT and YALLOC_ADAPTIVE only)
+  uint16_t policy; // YALLOC_POLICY_* that is used by yalloc_alloc()
+  uint16_t switches; // number of policy switches (saturating, YALLOC_ADAPTIVE only)
+  uint16_t defragSuggested; // see yalloc_defrag_suggested() (YALLOC_ADAPTIVE only)
+  uint16_t windowAllocs; // allocations in the current window (YALLOC_ADAPTIVE only)
+  uint16_t windowVisits; // free-list nodes visited by the allocations of the current window (saturating, YALLOC_ADAPTIVE only)
+  uint16_t windowFragFailures; // allocations of the current window that failed although there was enough free space in total (YALLOC_ADAPTIVE only)
+  uint16_t last; // offset of the Header at the end of the pool (not used by YALLOC_BITMAP)
+  uint16_t undoCapacity; // number of entries of the undo log (see YALLOC_UNDO_LOG())
+  uint16_t undoUsed; // entries of the undo log that are in use or UNDO_OVERFLOW
+  uint16_t undoDepth; // number of checkpoints that where not released yet
+  uint16_t zeroFrom; // the pool is zero from this granule (4 bytes) behind the root on, except for the Header at its end (YALLOC_MEMORY_IS_ZERO only)
+  uint16_t numBuckets; // number of address ranges (YALLOC_ADDRESS_ORDERED only)
+} Control;
+
+/*
+Pools with YALLOC_UNDO_LOG() have the undo log between the control block and
+the root (ctrl->size covers both). While a checkpoint exists yalloc_alloc() and
+yalloc_free() record the old content of every 4 byte word of metadata before
+they change it (the Headers of the blocks and the buckets and rover of the
+control block, the other fields of the control block are not rolled back). So
+yalloc_rollback() only has to write back the recorded words in reverse order.
+When the log is full the checkpoints can no longer be rolled back, which is
+marked with UNDO_OVERFLOW until the last checkpoint is released.
+*/
+#define UNDO_OVERFLOW 0xFFFFu
+
+typedef struct
+{
+  uint16_t word; // distance of the word from the control block in 4 byte units
+  uint16_t old[2]; // content of the word when it was recorded
+} UndoEntry;
+
+// returns the undo log of a pool with YALLOC_UNDO_LOG()
+static inline UndoEntry * getUndoLog(Control * ctrl)
+{
+  return (UndoEntry*)(ctrl + 1);
+}
+
+// returns the first free block of every address range of a pool with YALLOC_ADDRESS_ORDERED (behind the undo log, padded
+// to 4 bytes). An entry is only meaningful if the bit of its range in Control::nonEmptyBuckets is set.
+static inline uint16_t * getBuckets(Control * ctrl)
+{
+  return (uint16_t*)(getUndoLog(ctrl) + ctrl->undoCapacity);
+}
+
+/*
+Pools with YALLOC_TAGGED have the TagStats of all tags behind the buckets,
+followed by the tag of every block (4 bits per block). The tag of a block is
+found by the distance of its Header from the root divided by 8, which is unique
+because blocks are at least 8 bytes apart. Only the tags of used blocks are
+meaningful.
+*/
+typedef struct
+{
+  uint32_t bytes; // payload of the used blocks with this tag
+  uint32_t quota; // limit for bytes or 0 if there is none
+  uint16_t blocks; // number of used blocks with this tag
+  uint16_t reserved;
+} TagStats;
+
+// returns the statistics of the tags of a pool with YALLOC_TAGGED
+static inline TagStats * getTagStats(Control * ctrl)
+{
+  return (TagStats*)(getBuckets(ctrl) + (ctrl->numBuckets + 1u) / 2 * 2);
+}
+
+// returns the tags of the blocks of a pool with YALLOC_TAGGED (two per byte, the lower 4 bits for the even index)
+static inline uint8_t * getTags(Control * ctrl)
+{
+  return (uint8_t*)(getTagStats(ctrl) + YALLOC_NUM_TAGS);
+}
+
+/*
+Pools with YALLOC_BITMAP do not use Headers at all. The control block is
+followed by a bitmap with one bit per 4 byte granule of the pool (set for used
+granules, the unused bits of the last word are set too) and the granules
+follow after the bitmap (ctrl->size covers the control block and all
+metadata, so getRoot() returns the first granule). Every block starts with a
+BlockHeader that occupies its first granule.
+
+Blocks of YALLOC_OUT_OF_BAND pools have no BlockHeader. Instead a second
+bitmap (behind the first one) marks the last granule of every block and a
+table of one uint16_t per bitmap word (padded to 4 bytes) follows, which
+yalloc_defrag_start() fills with the number of used granules in front of each
+word.
+*/
+typedef struct
+{
+  uint16_t size; // number of granules of the block (including the header)
+  uint16_t defragTarget; // granule the block is moved to by defragmentation (only valid while defragmenting)
+} BlockHeader;
+
+// number of 32 bit words of each bitmap of a YALLOC_BITMAP pool
+static inline size_t bitmapWords(Control * ctrl)
+{
+  return (ctrl->numGranules + 31u) / 32u;
+}
+
+// returns the bitmap of the used granules of a YALLOC_BITMAP pool
+static inline uint32_t * getBitmap(Control * ctrl)
+{
+  return (uint32_t*)(ctrl + 1);
+}
+
+// returns the bitmap that marks the last granule of every block (YALLOC_OUT_OF_BAND only)
+static inline uint32_t * getEndBitmap(Control * ctrl)
+{
+  return getBitmap(ctrl) + bitmapWords(ctrl);
+}
+
+// returns the number of used granules in front of every bitmap word (YALLOC_OUT_OF_BAND only, valid while defragmenting)
+static inline uint16_t * getRanks(Control * ctrl)
+{
+  return (uint16_t*)(getEndBitmap(ctrl) + bitmapWords(ctrl));
+}
+
+// returns the Control block of a pool or NULL if it is a plain pool
+static inline Control * getControl(void * pool)
+{
+  return ((Header*)pool)->next == CONTROL_MARKER ? (Control*)pool : (Control*)0;
+}
+
+// returns the first block of a pool (which is the base for all offsets)
+static inline Header * getRoot(void * pool, Control * ctrl)
+{
+  return ctrl ? (Header*)((char*)pool + ctrl->size) : (Header*)pool;
+}
+
 #ifndef YALLOC_INTERNAL_VALIDATE
 # ifdef NDEBUG
 #   define YALLOC_INTERNAL_VALIDATE 0
@@ -27,6 +225,46 @@ typedef struct
 #endif
 #endif
 
+/*
+When YALLOC_WORK_COUNTERS is defined the allocator counts the work it does in
+the global yalloc_work. This is only intended for tests and benchmarks that
+want to measure the cost of operations independently of timing noise.
+*/
+#ifdef YALLOC_WORK_COUNTERS
+#include <stddef.h>
+
+#define WORK_CACHE_LINE_SIZE 64
+#define WORK_CACHE_LINES 512 // a direct mapped cache of 32k
+
+typedef struct
+{
+  size_t freeListVisits; // free-list nodes inspected or relinked
+  size_t blockVisits; // blocks visited while walking the pool in address order
+  size_t bytesMoved; // bytes moved by defragmentation
+  size_t cacheMisses; // misses of a simulated cache that sees the metadata accesses of alloc and free
+  uintptr_t cacheTags[WORK_CACHE_LINES]; // line that is cached in each slot of the simulated cache
+} YallocWorkCounters;
+
+extern YallocWorkCounters yalloc_work;
+
+# define COUNT_WORK(counter, n) (yalloc_work.counter += (n))
+# define COUNT_ACCESS(p) count_access(p)
+
+// records an access of the allocator to its metadata in the simulated cache
+static inline void count_access(void const * p)
+{
+  uintptr_t line = (uintptr_t)p / WORK_CACHE_LINE_SIZE;
+  uintptr_t * tag = &yalloc_work.cacheTags[line % WORK_CACHE_LINES];
+  if (*tag != line)
+  {
+    *tag = line;
+    ++yalloc_work.cacheMisses;
+  }
+}
+#else
+# define COUNT_WORK(counter, n) ((void)0)
+# define COUNT_ACCESS(p) ((void)0)
+#endif
 
 /*
 internal_assert() is used in some places to check internal expections.
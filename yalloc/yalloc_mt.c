@@ -0,0 +1,255 @@
+#include "yalloc.h"
+#include "yalloc_mt.h"
+
+#include <assert.h>
+
+#define UNCACHED 0xFFFFu
+
+/*
+Every allocation starts with this prefix. While a block is cached or waits in a
+remote queue the owner is replaced by the next block of the list.
+
+Blocks are referenced by the distance of their prefix from the pool in 4 byte
+units (a prefix is never at the start of the pool because there is at least
+the Header of its pool block in front of it, so 0 means "none").
+*/
+typedef struct
+{
+  uint16_t owner; // slot of the thread that allocated the block (or the next block of a list)
+  uint16_t sizeClass; // index into the caches or UNCACHED
+} Prefix;
+
+static uint16_t units(YallocMt * mt, Prefix * p)
+{
+  return (uint16_t)(((char*)p - (char*)mt->pool) / 4);
+}
+
+static Prefix * prefixAt(YallocMt * mt, uint32_t u)
+{
+  return (Prefix*)((char*)mt->pool + (size_t)u * 4);
+}
+
+// returns a list of blocks to the pool (the lock must be held)
+static void free_list(YallocMt * mt, uint32_t u)
+{
+  while (u)
+  {
+    Prefix * p = prefixAt(mt, u);
+    u = p->owner;
+    yalloc_free(mt->pool, p);
+  }
+}
+
+// caches a block of the thread (returns nonzero if the cache of its size class is full afterwards)
+static int push_cached(YallocMtThread * thread, Prefix * p)
+{
+  p->owner = thread->cached[p->sizeClass];
+  thread->cached[p->sizeClass] = units(thread->mt, p);
+  return ++thread->numCached[p->sizeClass] > YALLOC_MT_CACHE_SIZE;
+}
+
+// takes the blocks that other threads freed into the caches and returns the overflow to the pool
+static void drain_remote(YallocMtThread * thread)
+{
+  YallocMt * mt = thread->mt;
+  uint32_t u = atomic_exchange_explicit(&mt->remote[thread->slot], 0, memory_order_acquire);
+  uint32_t overflow = 0;
+  while (u)
+  {
+    Prefix * p = prefixAt(mt, u);
+    u = p->owner;
+    if (thread->numCached[p->sizeClass] < YALLOC_MT_CACHE_SIZE)
+      push_cached(thread, p);
+    else
+    {
+      p->owner = (uint16_t)overflow;
+      overflow = units(mt, p);
+    }
+  }
+
+  if (overflow)
+  {
+    pthread_mutex_lock(&mt->lock);
+    free_list(mt, overflow);
+    pthread_mutex_unlock(&mt->lock);
+  }
+}
+
+// takes up to YALLOC_MT_BATCH blocks of a size class from the pool into the cache
+static void refill(YallocMtThread * thread, unsigned sizeClass)
+{
+  YallocMt * mt = thread->mt;
+  pthread_mutex_lock(&mt->lock);
+  for (int i = 0; i < YALLOC_MT_BATCH; ++i)
+  {
+    Prefix * p = (Prefix*)yalloc_alloc(mt->pool, sizeof(Prefix) + (sizeClass + 1) * 4);
+    if (!p)
+      break;
+
+    p->sizeClass = (uint16_t)sizeClass;
+    push_cached(thread, p);
+  }
+  pthread_mutex_unlock(&mt->lock);
+}
+
+int yalloc_mt_init(YallocMt * mt, void * pool)
+{
+  mt->pool = pool;
+  for (int i = 0; i < YALLOC_MT_MAX_THREADS; ++i)
+    atomic_init(&mt->remote[i], YALLOC_MT_CLOSED);
+
+  return pthread_mutex_init(&mt->lock, NULL);
+}
+
+void yalloc_mt_deinit(YallocMt * mt)
+{
+  for (int i = 0; i < YALLOC_MT_MAX_THREADS; ++i)
+    assert(atomic_load(&mt->remote[i]) == YALLOC_MT_CLOSED); // all threads must be deregistered
+
+  pthread_mutex_destroy(&mt->lock);
+}
+
+int yalloc_mt_thread_init(YallocMt * mt, YallocMtThread * thread)
+{
+  pthread_mutex_lock(&mt->lock);
+  int slot = 0;
+  while (slot < YALLOC_MT_MAX_THREADS && atomic_load_explicit(&mt->remote[slot], memory_order_relaxed) != YALLOC_MT_CLOSED)
+    ++slot;
+
+  if (slot < YALLOC_MT_MAX_THREADS)
+    atomic_store_explicit(&mt->remote[slot], 0, memory_order_relaxed);
+  pthread_mutex_unlock(&mt->lock);
+
+  if (slot == YALLOC_MT_MAX_THREADS)
+    return -1;
+
+  thread->mt = mt;
+  thread->slot = (uint16_t)slot;
+  for (int i = 0; i < YALLOC_MT_CLASSES; ++i)
+  {
+    thread->cached[i] = 0;
+    thread->numCached[i] = 0;
+  }
+  return 0;
+}
+
+void yalloc_mt_thread_deinit(YallocMtThread * thread)
+{
+  // Closing the queue and taking its blocks is one atomic step, so every other thread either pushed its block before
+  // (and it is freed here) or sees the closed queue and frees the block to the pool itself.
+  YallocMt * mt = thread->mt;
+  uint32_t remote = atomic_exchange_explicit(&mt->remote[thread->slot], YALLOC_MT_CLOSED, memory_order_acquire);
+
+  pthread_mutex_lock(&mt->lock);
+  free_list(mt, remote);
+  for (int i = 0; i < YALLOC_MT_CLASSES; ++i)
+  {
+    free_list(mt, thread->cached[i]);
+    thread->cached[i] = 0;
+    thread->numCached[i] = 0;
+  }
+  pthread_mutex_unlock(&mt->lock);
+
+  thread->mt = NULL;
+}
+
+void * yalloc_mt_alloc(YallocMtThread * thread, size_t size)
+{
+  YallocMt * mt = thread->mt;
+  if (!size)
+    return NULL;
+
+  if (size > YALLOC_MT_MAX_CACHED)
+  { // not cached
+    if (size > MAX_POOL_SIZE)
+      return NULL;
+
+    pthread_mutex_lock(&mt->lock);
+    Prefix * p = (Prefix*)yalloc_alloc(mt->pool, sizeof(Prefix) + size);
+    pthread_mutex_unlock(&mt->lock);
+    if (!p)
+      return NULL;
+
+    p->owner = thread->slot;
+    p->sizeClass = UNCACHED;
+    return p + 1;
+  }
+
+  unsigned sizeClass = (unsigned)(size - 1) / 4;
+  if (!thread->cached[sizeClass])
+  {
+    drain_remote(thread);
+    if (!thread->cached[sizeClass])
+      refill(thread, sizeClass);
+    if (!thread->cached[sizeClass])
+      return NULL;
+  }
+
+  Prefix * p = prefixAt(mt, thread->cached[sizeClass]);
+  thread->cached[sizeClass] = p->owner;
+  --thread->numCached[sizeClass];
+  p->owner = thread->slot;
+  return p + 1;
+}
+
+void yalloc_mt_free(YallocMtThread * thread, void * p_)
+{
+  if (!p_)
+    return;
+
+  YallocMt * mt = thread->mt;
+  Prefix * p = (Prefix*)p_ - 1;
+  assert(p->sizeClass == UNCACHED || p->sizeClass < YALLOC_MT_CLASSES); // p must be an allocation of the front-end
+  assert(p->owner < YALLOC_MT_MAX_THREADS);
+
+  if (p->sizeClass != UNCACHED && p->owner == thread->slot)
+  { // a block of this thread, which usually just goes into the cache
+    unsigned sizeClass = p->sizeClass;
+    if (push_cached(thread, p))
+    { // return a batch to the pool
+      pthread_mutex_lock(&mt->lock);
+      for (int i = 0; i < YALLOC_MT_BATCH; ++i)
+      {
+        Prefix * first = prefixAt(mt, thread->cached[sizeClass]);
+        thread->cached[sizeClass] = first->owner;
+        yalloc_free(mt->pool, first);
+      }
+      pthread_mutex_unlock(&mt->lock);
+      thread->numCached[sizeClass] -= YALLOC_MT_BATCH;
+    }
+    return;
+  }
+
+  if (p->sizeClass != UNCACHED)
+  { // give the block back to its owner
+    _Atomic uint32_t * queue = &mt->remote[p->owner];
+    uint32_t head = atomic_load_explicit(queue, memory_order_relaxed);
+    while (head != YALLOC_MT_CLOSED)
+    {
+      p->owner = (uint16_t)head;
+      if (atomic_compare_exchange_weak_explicit(queue, &head, units(mt, p), memory_order_release, memory_order_relaxed))
+        return;
+    }
+  }
+
+  // the block is not cached or its owner is gone
+  pthread_mutex_lock(&mt->lock);
+  yalloc_free(mt->pool, p);
+  pthread_mutex_unlock(&mt->lock);
+}
+
+void * yalloc_mt_defrag_address(YallocMt * mt, void * p)
+{
+  if (!p)
+    return NULL;
+
+  return (Prefix*)yalloc_defrag_address(mt->pool, (Prefix*)p - 1) + 1;
+}
+
+size_t yalloc_mt_count_free(YallocMt * mt)
+{
+  pthread_mutex_lock(&mt->lock);
+  size_t bytes = yalloc_count_free(mt->pool);
+  pthread_mutex_unlock(&mt->lock);
+  return bytes;
+}
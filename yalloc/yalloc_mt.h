@@ -0,0 +1,151 @@
+/**
+@file
+
+Optional thread-safe front-end for a pool.
+
+This is only available if build with <tt>yalloc_mt.c</tt> (which needs POSIX
+threads and C11 atomics). The functions of yalloc.h are not thread-safe, so a
+pool that is shared by threads needs a lock around every call. This front-end
+takes that lock far less often: Every thread registers a YallocMtThread that
+caches blocks of small sizes (up to YALLOC_MT_MAX_CACHED bytes). Allocations
+and deallocations of the thread that owns a block are served from its cache,
+only a miss refills YALLOC_MT_BATCH blocks (and a full cache returns that many)
+under the lock. A block that is freed by another thread goes back to its owner
+through a lock-free queue, which the owner drains into its cache on its next
+miss. Bigger allocations are passed through to the pool under the lock.
+
+Every allocation has a 4 byte prefix in front of it that stores the size class
+and the owner of the block.
+
+The pool itself must not be used directly while threads are registered. To
+defragment it (or to get exact numbers from yalloc_count_free()) all threads
+have to stop allocating and return their caches with
+yalloc_mt_thread_deinit(), and the pointers need to be updated with
+yalloc_mt_defrag_address() like with yalloc_defrag_address().
+*/
+
+#ifndef YALLOC_MT_H
+#define YALLOC_MT_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/// Maximum number of threads that can be registered at the same time.
+#ifndef YALLOC_MT_MAX_THREADS
+#define YALLOC_MT_MAX_THREADS 32
+#endif
+
+/// Allocations up to this size (a multiple of 4) are cached per thread.
+#ifndef YALLOC_MT_MAX_CACHED
+#define YALLOC_MT_MAX_CACHED 64
+#endif
+
+/// Number of blocks that are taken from or returned to the pool at once.
+#ifndef YALLOC_MT_BATCH
+#define YALLOC_MT_BATCH 8
+#endif
+
+/// Maximum number of cached blocks per thread and size class.
+#ifndef YALLOC_MT_CACHE_SIZE
+#define YALLOC_MT_CACHE_SIZE 32
+#endif
+
+#define YALLOC_MT_CLASSES (YALLOC_MT_MAX_CACHED / 4)
+
+/// Value of YallocMt::remote for slots without a thread.
+#define YALLOC_MT_CLOSED 0xFFFFFFFFu
+
+/**
+State of the front-end of a pool.
+
+Initialize it with yalloc_mt_init(). The members are not meant to be modified
+by the application.
+*/
+typedef struct
+{
+  void * pool; ///< The pool that is shared.
+  pthread_mutex_t lock; ///< Protects the pool.
+  _Atomic uint32_t remote[YALLOC_MT_MAX_THREADS]; ///< Blocks that other threads freed for every thread (YALLOC_MT_CLOSED for unused slots).
+} YallocMt;
+
+/**
+State of a thread that uses a YallocMt.
+
+Initialize it with yalloc_mt_thread_init(). The members are not meant to be
+modified by the application.
+*/
+typedef struct
+{
+  YallocMt * mt; ///< The front-end the thread is registered at.
+  uint16_t slot; ///< Index of the thread in YallocMt::remote (stored as owner of its blocks).
+  uint16_t cached[YALLOC_MT_CLASSES]; ///< First cached block of every size class (4 byte units from the pool, 0 if there is none).
+  uint16_t numCached[YALLOC_MT_CLASSES]; ///< Number of cached blocks of every size class.
+} YallocMtThread;
+
+/**
+Initializes the front-end of a pool.
+
+@param mt The front-end to initialize.
+@param pool An initialized pool.
+@return 0 on success, nonzero if the lock could not be created.
+*/
+int yalloc_mt_init(YallocMt * mt, void * pool);
+
+/**
+Destroys the front-end. All threads must be deregistered already.
+*/
+void yalloc_mt_deinit(YallocMt * mt);
+
+/**
+Registers the calling thread.
+
+@param mt An initialized front-end.
+@param thread State of the thread (to be used only by that thread).
+@return 0 on success, nonzero if YALLOC_MT_MAX_THREADS threads are registered
+already.
+*/
+int yalloc_mt_thread_init(YallocMt * mt, YallocMtThread * thread);
+
+/**
+Deregisters a thread and returns its cached blocks to the pool.
+
+The blocks it allocated stay valid. When other threads free them later, they
+are returned to the pool directly (or to the cache of a thread that gets the
+same slot).
+*/
+void yalloc_mt_thread_deinit(YallocMtThread * thread);
+
+/**
+Allocates memory.
+
+@param thread State of the calling thread.
+@param size Number of bytes.
+@return See yalloc_alloc().
+*/
+void * yalloc_mt_alloc(YallocMtThread * thread, size_t size);
+
+/**
+Frees memory that was allocated by any thread of the same front-end.
+
+@param thread State of the calling thread.
+@param p The memory or \c NULL (which is ignored).
+*/
+void yalloc_mt_free(YallocMtThread * thread, void * p);
+
+/**
+Returns the post-defragmentation-address of an allocation of the front-end.
+
+Must be called between yalloc_defrag_start() and yalloc_defrag_commit() of
+the pool (while no thread is registered).
+*/
+void * yalloc_mt_defrag_address(YallocMt * mt, void * p);
+
+/**
+Returns yalloc_count_free() of the pool. Blocks that are cached by threads
+count as used.
+*/
+size_t yalloc_mt_count_free(YallocMt * mt);
+
+#endif // YALLOC_MT_H
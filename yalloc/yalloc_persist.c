@@ -0,0 +1,176 @@
+#include "yalloc.h"
+#include "yalloc_persist.h"
+#include "yalloc_internals.h"
+
+#include <assert.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// writes the header to the file (the pool is written by the next flush)
+static int sync_header(YallocFile * file)
+{
+  return msync(file->header, sizeof(YallocFileHeader), MS_SYNC);
+}
+
+// rolls back the calls of a sequence that was interrupted by the death of the process, returns nonzero if that is not possible
+static int recover(YallocFileHeader * header, void * pool)
+{
+  if (header->defragging)
+    return -1;
+
+  Control * ctrl = getControl(pool);
+  if (!ctrl || !ctrl->undoDepth)
+    return 0; // there was no sequence or the pool has no log (then it can not be told if it is consistent)
+
+  if (yalloc_rollback(pool, 1))
+    return -1; // the log overflowed
+
+  while (ctrl->undoDepth)
+    yalloc_checkpoint_release(pool, 1);
+  return 0;
+}
+
+// unmaps and closes a file that could not be opened
+static int fail(void * mapping, size_t mappedSize, int fd)
+{
+  if (mapping)
+    munmap(mapping, mappedSize);
+  close(fd);
+  return -1;
+}
+
+int yalloc_open_file(YallocFile * file, char const * path, size_t size, unsigned flags)
+{
+  if (size > MAX_POOL_SIZE)
+    return -1;
+
+  int fd = open(path, O_RDWR | O_CREAT, 0600);
+  if (fd < 0)
+    return -1;
+
+  struct stat st;
+  size_t mappedSize = sizeof(YallocFileHeader) + size;
+  if (fstat(fd, &st))
+    return fail(NULL, mappedSize, fd);
+
+  // a file of the right size without magic was being created when the process died (the magic is written last), so it is created again
+  uint32_t magic = 0;
+  int created = !st.st_size || ((size_t)st.st_size == mappedSize && pread(fd, &magic, sizeof(magic), 0) == sizeof(magic) && !magic);
+  if (created && st.st_size && ftruncate(fd, 0))
+    return fail(NULL, mappedSize, fd); // the memory of the new pool must be zero again
+  if ((created && ftruncate(fd, (off_t)mappedSize)) || (!created && (size_t)st.st_size != mappedSize))
+    return fail(NULL, mappedSize, fd);
+
+  void * mapping = mmap(NULL, mappedSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (mapping == MAP_FAILED)
+    return fail(NULL, mappedSize, fd);
+
+  YallocFileHeader * header = (YallocFileHeader*)mapping;
+  void * pool = header + 1;
+  if (created && yalloc_init_ex(pool, size, flags))
+  { // the flags are not supported, leave the file empty as it was
+    int err = ftruncate(fd, 0);
+    (void)err;
+    return fail(mapping, mappedSize, fd);
+  }
+
+  if (!created && (header->magic != YALLOC_FILE_MAGIC || header->version != YALLOC_FILE_VERSION || header->poolSize != size || header->flags != flags))
+    return fail(mapping, mappedSize, fd); // the file contains something else
+
+  int result = created ? YALLOC_FILE_CREATED : header->clean ? YALLOC_FILE_CLEAN : YALLOC_FILE_UNCLEAN;
+  if (result == YALLOC_FILE_UNCLEAN && recover(header, pool))
+  { // start over with an empty pool
+    int err = yalloc_init_ex(pool, size, flags);
+    assert(!err); // the pool was created with the same size and flags
+    (void)err;
+    header->defragging = 0;
+    result = YALLOC_FILE_BROKEN;
+  }
+
+  if (created)
+  {
+    memset(header, 0, sizeof(*header));
+    header->version = YALLOC_FILE_VERSION;
+    header->poolSize = (uint32_t)size;
+    header->flags = flags;
+    WRITE_BARRIER();
+    header->magic = YALLOC_FILE_MAGIC; // the file counts as created from now on
+  }
+
+  file->header = header;
+  file->pool = pool;
+  file->mappedSize = mappedSize;
+  file->fd = fd;
+
+  // the file counts as unclean until it is closed
+  header->clean = 0;
+  if (created ? yalloc_flush_file(file) : sync_header(file))
+    return fail(mapping, mappedSize, fd);
+
+  return result;
+}
+
+size_t yalloc_file_begin(YallocFile * file)
+{
+  return yalloc_checkpoint(file->pool);
+}
+
+void yalloc_file_end(YallocFile * file, size_t checkpoint)
+{
+  if (checkpoint)
+    yalloc_checkpoint_release(file->pool, checkpoint);
+}
+
+void * yalloc_file_alloc(YallocFile * file, size_t size)
+{
+  size_t checkpoint = yalloc_file_begin(file);
+  void * p = yalloc_alloc(file->pool, size);
+  yalloc_file_end(file, checkpoint);
+  return p;
+}
+
+void yalloc_file_free(YallocFile * file, void * p)
+{
+  size_t checkpoint = yalloc_file_begin(file);
+  yalloc_free(file->pool, p);
+  yalloc_file_end(file, checkpoint);
+}
+
+void yalloc_file_defrag_start(YallocFile * file)
+{
+  file->header->defragging = 1;
+  WRITE_BARRIER();
+  yalloc_defrag_start(file->pool);
+}
+
+void yalloc_file_defrag_commit(YallocFile * file)
+{
+  yalloc_defrag_commit(file->pool);
+  WRITE_BARRIER();
+  file->header->defragging = 0;
+}
+
+int yalloc_flush_file(YallocFile * file)
+{
+  return msync(file->header, file->mappedSize, MS_SYNC);
+}
+
+int yalloc_close_file(YallocFile * file)
+{
+  // the pool must be on disk before the header says it is complete
+  int err = yalloc_flush_file(file);
+  if (!err)
+  {
+    file->header->clean = 1;
+    err = sync_header(file);
+  }
+
+  err |= munmap(file->header, file->mappedSize);
+  err |= close(file->fd);
+  file->pool = NULL;
+  file->header = NULL;
+  return err;
+}
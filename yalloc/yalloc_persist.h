@@ -0,0 +1,161 @@
+/**
+@file
+
+Optional pools in memory mapped files that survive a restart of the process.
+
+This is only available if build with <tt>yalloc_persist.c</tt> (which needs
+POSIX mmap()). All links inside of a pool are offsets relative to the pool, so
+a pool works at whatever address its file is mapped. yalloc_open_file() maps a
+file with a YallocFileHeader in front of the pool and either initializes a new
+pool or reattaches the pool of an existing file, with all of its allocations.
+The application can not keep pointers across a restart, but it can keep
+offsets relative to YallocFile::pool (e.g. to a root object in the first
+allocation).
+
+The header remembers if the file was closed with yalloc_close_file(). A pool
+that was not closed (because the process died) may be inconsistent if the
+process died during an allocator function and the application data may be
+inconsistent too, so yalloc_open_file() tells the application about it.
+
+Pools with an undo log (YALLOC_UNDO_LOG()) survive the death of the process in
+any allocator function that is called between yalloc_file_begin() and
+yalloc_file_end() (like yalloc_file_alloc() and yalloc_file_free() do):
+yalloc_open_file() rolls the pool back to its state at yalloc_file_begin(),
+which only takes time proportional to the number of changed Headers. The log
+must be big enough for the calls in between (see YALLOC_UNDO_LOG()). This
+protects against the process dying, not against losing the power or the
+operating system crashing (the changes then reach the disk in any order, only
+yalloc_flush_file() makes sure they are on the disk).
+
+Defragmentation moves the data of the blocks, which is not logged. If the
+process dies between yalloc_file_defrag_start() and
+yalloc_file_defrag_commit() (or in a sequence that overflowed the log) the pool
+can not be recovered, so yalloc_open_file() initializes it again.
+
+Memory that was added to the file by growing it is zero, so new pools can use
+YALLOC_MEMORY_IS_ZERO. The magic of the header is written last when a file is
+created, so a file of the right size without magic (the process died while
+creating it) is created again.
+*/
+
+#ifndef YALLOC_PERSIST_H
+#define YALLOC_PERSIST_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define YALLOC_FILE_MAGIC 0x706c6179u ///< "yalp" (little endian)
+#define YALLOC_FILE_VERSION 1
+
+/// yalloc_open_file() created a new pool.
+#define YALLOC_FILE_CREATED 0
+/// yalloc_open_file() reattached a pool that was closed with yalloc_close_file().
+#define YALLOC_FILE_CLEAN 1
+/// yalloc_open_file() reattached a pool that was not closed (and rolled back an interrupted operation if it had an undo log).
+#define YALLOC_FILE_UNCLEAN 2
+/// yalloc_open_file() found a pool that could not be recovered (the process died during defragmentation or the undo log overflowed), so it initialized it again.
+#define YALLOC_FILE_BROKEN 3
+
+/**
+Header at the start of a pool file. The pool follows directly after it.
+*/
+typedef struct
+{
+  uint32_t magic; ///< YALLOC_FILE_MAGIC
+  uint16_t version; ///< YALLOC_FILE_VERSION
+  uint16_t clean; ///< Nonzero if the file was closed with yalloc_close_file().
+  uint32_t poolSize; ///< Size that was passed to yalloc_init_ex().
+  uint32_t flags; ///< Flags that where passed to yalloc_init_ex().
+  uint16_t defragging; ///< Nonzero between yalloc_file_defrag_start() and yalloc_file_defrag_commit().
+  uint16_t reserved0;
+  uint32_t reserved[3];
+} YallocFileHeader;
+
+/**
+State of an open pool file.
+
+The members are not meant to be modified by the application.
+*/
+typedef struct
+{
+  void * pool; ///< The pool (behind the header).
+  YallocFileHeader * header; ///< Start of the mapping.
+  size_t mappedSize; ///< Size of the header and the pool.
+  int fd; ///< The open file.
+} YallocFile;
+
+/**
+Opens a pool file.
+
+A file that does not exist or is empty is created with the given size and
+flags and a new pool is initialized in it. Otherwise the file must contain a
+pool with the same size and flags.
+
+@param file Receives the state of the open file.
+@param path Path of the file.
+@param size Size of the pool (see yalloc_init_ex()).
+@param flags Flags of the pool (see yalloc_init_ex()).
+@return YALLOC_FILE_CREATED, YALLOC_FILE_CLEAN, YALLOC_FILE_UNCLEAN or
+YALLOC_FILE_BROKEN on success, a negative value if the file could not be
+opened or mapped or does not contain a pool with that size and flags.
+*/
+int yalloc_open_file(YallocFile * file, char const * path, size_t size, unsigned flags);
+
+/**
+Starts a sequence of allocator calls that is undone as a whole if the process
+dies before yalloc_file_end() (pools with YALLOC_UNDO_LOG() only).
+
+@return The checkpoint to pass to yalloc_file_end().
+*/
+size_t yalloc_file_begin(YallocFile * file);
+
+/**
+Ends a sequence of allocator calls that was started with yalloc_file_begin().
+*/
+void yalloc_file_end(YallocFile * file, size_t checkpoint);
+
+/**
+yalloc_alloc() between yalloc_file_begin() and yalloc_file_end().
+*/
+void * yalloc_file_alloc(YallocFile * file, size_t size);
+
+/**
+yalloc_free() between yalloc_file_begin() and yalloc_file_end().
+*/
+void yalloc_file_free(YallocFile * file, void * p);
+
+/**
+yalloc_defrag_start() that marks the file as broken until
+yalloc_file_defrag_commit().
+*/
+void yalloc_file_defrag_start(YallocFile * file);
+
+/**
+yalloc_defrag_commit() that marks the file as consistent again.
+*/
+void yalloc_file_defrag_commit(YallocFile * file);
+
+/**
+Writes the pool to the file and waits until it is written.
+
+@return 0 on success, nonzero if msync() failed.
+*/
+int yalloc_flush_file(YallocFile * file);
+
+/**
+Flushes the pool, marks the file as cleanly closed and closes it. The pool can
+not be used anymore afterwards.
+
+@return 0 on success, nonzero if writing the file failed.
+*/
+int yalloc_close_file(YallocFile * file);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // YALLOC_PERSIST_H
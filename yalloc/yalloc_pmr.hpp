@@ -0,0 +1,199 @@
+/**
+@file
+
+Optional C++17 adapters that let standard containers allocate from a pool.
+
+This header needs nothing but yalloc.c. yalloc::pool_resource is a
+std::pmr::memory_resource, so every std::pmr container can use a pool:
+
+@code
+yalloc::pool_resource resource(pool);
+std::pmr::vector<int> v(&resource);
+@endcode
+
+yalloc::allocator<T> is a stateful allocator for containers that take an
+allocator type instead (it compares equal for the same pool, so containers can
+swap and move their memory between each other).
+
+Allocations are 32bit aligned by the pool. For bigger alignments a few bytes
+more are allocated and the distance to the start of the block is stored in
+front of the aligned address, so the block can still be freed.
+
+Like the pool, both are not thread-safe. For scratch memory that is thrown away
+as a whole yalloc::scratch_resource puts a std::pmr::monotonic_buffer_resource
+on top of a pool (which gets the memory back with release()). A
+std::pmr::unsynchronized_pool_resource on top of a yalloc::pool_resource caches
+freed blocks per size (which the pool does not need, but it avoids the search
+in the free list of the pool).
+
+Failed allocations throw std::bad_alloc, as the standard requires.
+*/
+
+#ifndef YALLOC_PMR_HPP
+#define YALLOC_PMR_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory_resource>
+#include <new>
+
+#include "yalloc.h"
+
+namespace yalloc
+{
+
+namespace detail
+{
+
+/// Allocates memory with any power of two alignment from a pool (throws std::bad_alloc if it fails).
+inline void * allocate(void * pool, std::size_t bytes, std::size_t alignment)
+{
+  if (alignment <= 4)
+  {
+    void * p = yalloc_alloc(pool, bytes ? bytes : 1);
+    if (!p)
+      throw std::bad_alloc();
+    return p;
+  }
+
+  // the aligned address is at least 4 bytes behind the block, which is where the distance to the block goes
+  if (bytes > std::numeric_limits<std::size_t>::max() - alignment)
+    throw std::bad_alloc();
+
+  char * block = static_cast<char*>(yalloc_alloc(pool, bytes + alignment));
+  if (!block)
+    throw std::bad_alloc();
+
+  std::uintptr_t address = (reinterpret_cast<std::uintptr_t>(block) + 4 + alignment - 1) & ~(std::uintptr_t)(alignment - 1);
+  char * p = reinterpret_cast<char*>(address);
+  reinterpret_cast<std::uint32_t*>(p)[-1] = static_cast<std::uint32_t>(p - block);
+  return p;
+}
+
+/// Frees memory from allocate() (with the same alignment).
+inline void deallocate(void * pool, void * p, std::size_t alignment)
+{
+  if (alignment > 4)
+    p = static_cast<char*>(p) - static_cast<std::uint32_t*>(p)[-1];
+  yalloc_free(pool, p);
+}
+
+} // namespace detail
+
+/**
+A std::pmr::memory_resource that allocates from a pool.
+
+The pool must outlive the resource and everything that was allocated from it.
+*/
+class pool_resource : public std::pmr::memory_resource
+{
+public:
+  /// Uses an initialized pool.
+  explicit pool_resource(void * pool) noexcept : pool_(pool) {}
+
+  /// The pool.
+  void * pool() const noexcept { return pool_; }
+
+protected:
+  void * do_allocate(std::size_t bytes, std::size_t alignment) override
+  {
+    return detail::allocate(pool_, bytes, alignment);
+  }
+
+  void do_deallocate(void * p, std::size_t, std::size_t alignment) override
+  {
+    detail::deallocate(pool_, p, alignment);
+  }
+
+  bool do_is_equal(std::pmr::memory_resource const & other) const noexcept override
+  {
+    pool_resource const * o = dynamic_cast<pool_resource const*>(&other);
+    return o && o->pool_ == pool_;
+  }
+
+private:
+  void * pool_;
+};
+
+namespace detail
+{
+
+/// Base of scratch_resource, so its upstream resource is constructed before (and destroyed after) the monotonic resource.
+struct upstream_holder
+{
+  explicit upstream_holder(void * pool) noexcept : upstream(pool) {}
+  pool_resource upstream;
+};
+
+} // namespace detail
+
+/**
+A std::pmr::monotonic_buffer_resource on top of a pool for scratch memory.
+
+Allocations only bump a pointer in buffers that come from the pool, frees do
+nothing. release() (or the destructor) returns all buffers to the pool at once.
+*/
+class scratch_resource : private detail::upstream_holder, public std::pmr::monotonic_buffer_resource
+{
+public:
+  /**
+  Uses an initialized pool.
+
+  @param pool The pool.
+  @param initialSize Size of the first buffer (later buffers get bigger).
+  */
+  explicit scratch_resource(void * pool, std::size_t initialSize = 256)
+    : detail::upstream_holder(pool), std::pmr::monotonic_buffer_resource(initialSize, &upstream) {}
+};
+
+/**
+A stateful allocator that allocates from a pool, for containers that take an
+allocator type.
+*/
+template <class T>
+class allocator
+{
+public:
+  using value_type = T;
+
+  /// Uses an initialized pool.
+  explicit allocator(void * pool) noexcept : pool_(pool) {}
+
+  template <class U>
+  allocator(allocator<U> const & other) noexcept : pool_(other.pool()) {}
+
+  /// The pool.
+  void * pool() const noexcept { return pool_; }
+
+  T * allocate(std::size_t n)
+  {
+    if (n > std::numeric_limits<std::size_t>::max() / sizeof(T))
+      throw std::bad_alloc();
+    return static_cast<T*>(detail::allocate(pool_, n * sizeof(T), alignof(T)));
+  }
+
+  void deallocate(T * p, std::size_t) noexcept
+  {
+    detail::deallocate(pool_, p, alignof(T));
+  }
+
+private:
+  void * pool_;
+};
+
+template <class T, class U>
+bool operator==(allocator<T> const & a, allocator<U> const & b) noexcept
+{
+  return a.pool() == b.pool();
+}
+
+template <class T, class U>
+bool operator!=(allocator<T> const & a, allocator<U> const & b) noexcept
+{
+  return a.pool() != b.pool();
+}
+
+} // namespace yalloc
+
+#endif // YALLOC_PMR_HPP
@@ -0,0 +1,201 @@
+#include "yalloc.h"
+#include "yalloc_shm.h"
+#include "yalloc_internals.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// how often an attaching process looks if the creator is done before it gives up
+#define ATTACH_RETRIES 100000
+
+// closes an object that could not be opened
+static int fail(int fd)
+{
+  close(fd);
+  return -1;
+}
+
+// initializes the header and the pool of a new object and publishes them
+static int create(YallocShmHeader * header, size_t size, unsigned flags)
+{
+  if (yalloc_init_ex(header + 1, size, flags))
+    return -1;
+
+  pthread_mutexattr_t attr;
+  pthread_mutexattr_init(&attr);
+  pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+  pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+  int err = pthread_mutex_init(&header->lock, &attr);
+  pthread_mutexattr_destroy(&attr);
+  if (err)
+    return -1;
+
+  header->magic = YALLOC_SHM_MAGIC;
+  header->version = YALLOC_SHM_VERSION;
+  header->poolSize = (uint32_t)size;
+  header->flags = flags;
+  header->checkpoint = 0;
+  atomic_store_explicit(&header->ready, 1, memory_order_release);
+  return 0;
+}
+
+int yalloc_shm_open(YallocShm * shm, char const * name, size_t size, unsigned flags)
+{
+  if (size > MAX_POOL_SIZE)
+    return -1;
+
+  size_t mappedSize = sizeof(YallocShmHeader) + size;
+  int created = 1;
+  int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+  if (fd < 0 && errno == EEXIST)
+  {
+    created = 0;
+    fd = shm_open(name, O_RDWR, 0600);
+  }
+  if (fd < 0)
+    return -1;
+
+  if (created && ftruncate(fd, (off_t)mappedSize))
+  {
+    shm_unlink(name);
+    return fail(fd);
+  }
+
+  // the creator may not have set the size yet
+  struct stat st;
+  for (int i = 0; !created && (!fstat(fd, &st) && !st.st_size) && i < ATTACH_RETRIES; ++i)
+    sched_yield();
+  if (!created && (fstat(fd, &st) || (size_t)st.st_size != mappedSize))
+    return fail(fd); // the object contains something else (or the creator died)
+
+  void * mapping = mmap(NULL, mappedSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd); // the mapping keeps the object open
+  if (mapping == MAP_FAILED)
+  {
+    if (created)
+      shm_unlink(name);
+    return -1;
+  }
+
+  YallocShmHeader * header = (YallocShmHeader*)mapping;
+  if (created && create(header, size, flags))
+  { // the flags are not supported
+    shm_unlink(name);
+    munmap(mapping, mappedSize);
+    return -1;
+  }
+
+  for (int i = 0; !created && !atomic_load_explicit(&header->ready, memory_order_acquire) && i < ATTACH_RETRIES; ++i)
+    sched_yield();
+  if (!created && (!atomic_load_explicit(&header->ready, memory_order_acquire) || header->magic != YALLOC_SHM_MAGIC || header->version != YALLOC_SHM_VERSION || header->poolSize != size || header->flags != flags))
+  {
+    munmap(mapping, mappedSize);
+    return -1;
+  }
+
+  shm->header = header;
+  shm->pool = header + 1;
+  shm->mappedSize = mappedSize;
+  return created ? YALLOC_SHM_CREATED : YALLOC_SHM_ATTACHED;
+}
+
+void yalloc_shm_close(YallocShm * shm)
+{
+  munmap(shm->header, shm->mappedSize);
+  shm->pool = NULL;
+  shm->header = NULL;
+}
+
+int yalloc_shm_unlink(char const * name)
+{
+  return shm_unlink(name);
+}
+
+// undoes what a process that died with the lock did, returns nonzero if that is not possible
+static int recover(void * pool)
+{
+  Control * ctrl = getControl(pool);
+  if (!ctrl || !ctrl->undoCapacity)
+    return -1; // there is no log, so it can not be told if the pool is consistent
+
+  if (!ctrl->undoDepth)
+    return 0; // it died before its checkpoint or after releasing it, so it did not change anything
+
+  if (yalloc_rollback(pool, 1))
+    return -1; // the log overflowed
+
+  while (ctrl->undoDepth) // including the checkpoints that it took itself
+    yalloc_checkpoint_release(pool, 1);
+  return 0;
+}
+
+int yalloc_shm_lock(YallocShm * shm)
+{
+  YallocShmHeader * header = shm->header;
+  int result = YALLOC_SHM_LOCKED;
+  int err = pthread_mutex_lock(&header->lock);
+  if (err == EOWNERDEAD)
+  { // the previous holder died
+    if (recover(shm->pool))
+    { // unlocking without making the lock consistent makes every further pthread_mutex_lock() fail with ENOTRECOVERABLE
+      pthread_mutex_unlock(&header->lock);
+      return YALLOC_SHM_UNRECOVERABLE;
+    }
+
+    pthread_mutex_consistent(&header->lock);
+    result = YALLOC_SHM_RECOVERED;
+  }
+  else if (err == ENOTRECOVERABLE)
+    return YALLOC_SHM_UNRECOVERABLE;
+  else if (err)
+    return YALLOC_SHM_LOCK_FAILED;
+
+  header->checkpoint = (uint32_t)yalloc_checkpoint(shm->pool);
+  return result;
+}
+
+void yalloc_shm_unlock(YallocShm * shm)
+{
+  YallocShmHeader * header = shm->header;
+  if (header->checkpoint)
+    yalloc_checkpoint_release(shm->pool, header->checkpoint);
+  header->checkpoint = 0;
+  pthread_mutex_unlock(&header->lock);
+}
+
+void * yalloc_shm_alloc(YallocShm * shm, size_t size)
+{
+  if (yalloc_shm_lock(shm) < 0)
+    return NULL;
+
+  void * p = yalloc_alloc(shm->pool, size);
+  yalloc_shm_unlock(shm);
+  return p;
+}
+
+int yalloc_shm_free(YallocShm * shm, void * p)
+{
+  if (!p)
+    return 0;
+
+  if (yalloc_shm_lock(shm) < 0)
+    return -1;
+
+  yalloc_free(shm->pool, p);
+  yalloc_shm_unlock(shm);
+  return 0;
+}
+
+uint32_t yalloc_shm_offset(YallocShm * shm, void * p)
+{
+  return p ? (uint32_t)((char*)p - (char*)shm->pool) : YALLOC_SHM_NULL;
+}
+
+void * yalloc_shm_pointer(YallocShm * shm, uint32_t offset)
+{
+  return offset == YALLOC_SHM_NULL ? NULL : (char*)shm->pool + offset;
+}
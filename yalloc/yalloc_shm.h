@@ -0,0 +1,167 @@
+/**
+@file
+
+Optional pools in POSIX shared memory that are used by several processes.
+
+This is only available if build with <tt>yalloc_shm.c</tt> (which needs
+shm_open(), mmap() and process-shared POSIX mutexes). All links inside of a
+pool are offsets relative to the pool, so every process can map the same pool
+at its own address. yalloc_shm_open() creates a shared memory object with a
+YallocShmHeader in front of the pool or attaches to an existing one. The header
+holds a process-shared lock that yalloc_shm_alloc() and yalloc_shm_free() take
+around the pool.
+
+Pointers can not be passed between processes, offsets can:
+yalloc_shm_offset() turns an allocation into an offset that any process turns
+back into its own pointer with yalloc_shm_pointer(). So a process can pass a
+big message to another one by allocating it in the pool, writing it and
+sending its offset (e.g. through a pipe). The receiver frees it when it is
+done.
+
+The lock is robust: If a process dies while it holds the lock, the next process
+that takes it gets it anyway. Pools with an undo log (YALLOC_UNDO_LOG()) keep a
+checkpoint while the lock is held and are then rolled back to the state before
+yalloc_shm_lock() (YALLOC_SHM_RECOVERED). If the calls overflowed the log or the
+pool has no log, the pool may be inconsistent, so the lock can never be taken
+again (YALLOC_SHM_UNRECOVERABLE for every process) and the pool has to be
+created anew.
+
+Defragmentation is not supported because it would have to stop all processes to
+update their offsets.
+*/
+
+#ifndef YALLOC_SHM_H
+#define YALLOC_SHM_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define YALLOC_SHM_MAGIC 0x736c6179u ///< "yals" (little endian)
+#define YALLOC_SHM_VERSION 1
+
+/// yalloc_shm_open() created a new pool.
+#define YALLOC_SHM_CREATED 0
+/// yalloc_shm_open() attached to an existing pool.
+#define YALLOC_SHM_ATTACHED 1
+
+/// yalloc_shm_lock() took the lock.
+#define YALLOC_SHM_LOCKED 0
+/// yalloc_shm_lock() took the lock after its previous holder died and rolled back what that did.
+#define YALLOC_SHM_RECOVERED 1
+/// yalloc_shm_lock() failed because a holder of the lock died and the pool could not be rolled back.
+#define YALLOC_SHM_UNRECOVERABLE -1
+/// yalloc_shm_lock() failed for another reason (see pthread_mutex_lock()).
+#define YALLOC_SHM_LOCK_FAILED -2
+
+/// Offset of \c NULL (offset 0 is the start of the pool, which is never an allocation).
+#define YALLOC_SHM_NULL 0u
+
+/**
+Header at the start of a shared memory object. The pool follows directly after
+it.
+*/
+typedef struct
+{
+  uint32_t magic; ///< YALLOC_SHM_MAGIC
+  uint16_t version; ///< YALLOC_SHM_VERSION
+  uint16_t reserved;
+  uint32_t poolSize; ///< Size that was passed to yalloc_init_ex().
+  uint32_t flags; ///< Flags that where passed to yalloc_init_ex().
+  atomic_uint ready; ///< Set by the creator when the header and the pool are initialized.
+  uint32_t checkpoint; ///< Checkpoint of the process that holds the lock (0 if the pool has no undo log).
+  pthread_mutex_t lock; ///< Process-shared, robust lock of the pool.
+} YallocShmHeader;
+
+/**
+A mapping of a shared pool in the calling process.
+
+The members are not meant to be modified by the application.
+*/
+typedef struct
+{
+  void * pool; ///< The pool (behind the header).
+  YallocShmHeader * header; ///< Start of the mapping.
+  size_t mappedSize; ///< Size of the header and the pool.
+} YallocShm;
+
+/**
+Creates a shared pool or attaches to an existing one.
+
+If there is no shared memory object with the name it is created with the given
+size and flags and a new pool is initialized in it. Otherwise the object must
+contain a pool with the same size and flags. A process that attaches while
+another one is still creating the pool waits for it.
+
+@param shm Receives the mapping.
+@param name Name of the shared memory object (see shm_open()).
+@param size Size of the pool (see yalloc_init_ex()).
+@param flags Flags of the pool (see yalloc_init_ex()).
+@return YALLOC_SHM_CREATED or YALLOC_SHM_ATTACHED on success, a negative value
+if the object could not be created or mapped or does not contain a pool with
+that size and flags.
+*/
+int yalloc_shm_open(YallocShm * shm, char const * name, size_t size, unsigned flags);
+
+/**
+Unmaps the pool from the calling process. The pool stays in the shared memory
+object for the other processes (until yalloc_shm_unlink() and the last
+yalloc_shm_close()).
+*/
+void yalloc_shm_close(YallocShm * shm);
+
+/**
+Removes the name of a shared memory object (see shm_unlink()).
+
+@return 0 on success, nonzero otherwise.
+*/
+int yalloc_shm_unlink(char const * name);
+
+/**
+Takes the lock of the pool to call several functions of yalloc.h on
+YallocShm::pool at once.
+
+@return YALLOC_SHM_LOCKED or YALLOC_SHM_RECOVERED if the lock is held,
+YALLOC_SHM_UNRECOVERABLE or YALLOC_SHM_LOCK_FAILED if it is not.
+*/
+int yalloc_shm_lock(YallocShm * shm);
+
+/**
+Releases the lock after yalloc_shm_lock() took it.
+*/
+void yalloc_shm_unlock(YallocShm * shm);
+
+/**
+yalloc_alloc() under the lock of the pool.
+
+@return See yalloc_alloc() (also \c NULL if yalloc_shm_lock() failed).
+*/
+void * yalloc_shm_alloc(YallocShm * shm, size_t size);
+
+/**
+yalloc_free() under the lock of the pool. Any process can free any allocation.
+
+@return 0 on success (or if p is \c NULL), nonzero if yalloc_shm_lock() failed.
+*/
+int yalloc_shm_free(YallocShm * shm, void * p);
+
+/**
+Returns the offset of an allocation that other processes can pass to
+yalloc_shm_pointer().
+
+@param shm The mapping of the pool.
+@param p An allocation or \c NULL (which gives YALLOC_SHM_NULL).
+*/
+uint32_t yalloc_shm_offset(YallocShm * shm, void * p);
+
+/**
+Returns the address of an allocation in the mapping of the calling process.
+
+@param shm The mapping of the pool.
+@param offset A value of yalloc_shm_offset() (of any process) or
+YALLOC_SHM_NULL (which gives \c NULL).
+*/
+void * yalloc_shm_pointer(YallocShm * shm, uint32_t offset);
+
+#endif // YALLOC_SHM_H
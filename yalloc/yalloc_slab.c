@@ -0,0 +1,231 @@
+#include "yalloc.h"
+#include "yalloc_slab.h"
+
+#include <assert.h>
+#include <string.h>
+
+#define NO_OBJECT 0xFFFFu
+
+/*
+Every slab starts with this header, the objects follow directly after it. Free
+objects store the index of the next free object in their first two bytes.
+Objects behind numTouched where never allocated, so they are not in the free
+list (which avoids initializing the free list of a new slab).
+
+Slabs are referenced by their distance from the pool in 4 byte units (a slab is
+never at the start of the pool because there is at least the Header of its
+pool block in front of it, so 0 means "none").
+*/
+typedef struct
+{
+  uint16_t nextPartial; // next slab with free objects
+  uint16_t prevPartial; // previous slab with free objects
+  uint16_t freeHead; // index of the first free object or NO_OBJECT
+  uint16_t numUsed; // number of allocated objects
+  uint16_t numTouched; // number of objects that where allocated at least once
+  uint16_t reserved;
+} Slab;
+
+static uint16_t units(YallocSlabCache * cache, void * p)
+{
+  return (uint16_t)(((char*)p - (char*)cache->pool) / 4);
+}
+
+static Slab * slabAt(YallocSlabCache * cache, uint16_t u)
+{
+  return (Slab*)((char*)cache->pool + (size_t)u * 4);
+}
+
+static char * objectAt(YallocSlabCache * cache, Slab * slab, uint16_t index)
+{
+  return (char*)(slab + 1) + (size_t)index * cache->objectSize;
+}
+
+static int hasFree(YallocSlabCache * cache, Slab * slab)
+{
+  return slab->freeHead != NO_OBJECT || slab->numTouched < cache->objectsPerSlab;
+}
+
+static void push_partial(YallocSlabCache * cache, Slab * slab)
+{
+  slab->prevPartial = 0;
+  slab->nextPartial = cache->partial;
+  if (cache->partial)
+    slabAt(cache, cache->partial)->prevPartial = units(cache, slab);
+  cache->partial = units(cache, slab);
+}
+
+static void unlink_partial(YallocSlabCache * cache, Slab * slab)
+{
+  if (slab->prevPartial)
+    slabAt(cache, slab->prevPartial)->nextPartial = slab->nextPartial;
+  else
+    cache->partial = slab->nextPartial;
+
+  if (slab->nextPartial)
+    slabAt(cache, slab->nextPartial)->prevPartial = slab->prevPartial;
+}
+
+// returns the index of the first slab behind p (binary search)
+static size_t upper_bound(YallocSlabCache * cache, void * p)
+{
+  size_t lo = 0;
+  size_t hi = cache->numSlabs;
+  while (lo < hi)
+  {
+    size_t mid = (lo + hi) / 2;
+    if ((char*)cache->slabs[mid] <= (char*)p)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+// returns the index of the slab that contains the object p
+static size_t find_slab(YallocSlabCache * cache, void * p)
+{
+  size_t i = upper_bound(cache, p);
+  assert(i > 0); // p must be in a slab of this cache
+  --i;
+  assert((char*)p < objectAt(cache, (Slab*)cache->slabs[i], cache->objectsPerSlab));
+  return i;
+}
+
+int yalloc_slab_init(YallocSlabCache * cache, void * pool, size_t objectSize, size_t objectsPerSlab, void ** slabs, size_t maxSlabs)
+{
+  if (!objectSize || objectSize > 0xFFFC || !objectsPerSlab || objectsPerSlab >= NO_OBJECT || maxSlabs > 0xFFFF) // the rounded size must fit into 16 bits
+    return -1;
+
+  objectSize = (objectSize + 3) / 4 * 4;
+  if (sizeof(Slab) + objectSize * objectsPerSlab > MAX_POOL_SIZE)
+    return -1;
+
+  memset(cache, 0, sizeof(*cache));
+  cache->pool = pool;
+  cache->slabs = slabs;
+  cache->maxSlabs = (uint16_t)maxSlabs;
+  cache->objectSize = (uint16_t)objectSize;
+  cache->objectsPerSlab = (uint16_t)objectsPerSlab;
+  return 0;
+}
+
+void yalloc_slab_deinit(YallocSlabCache * cache)
+{
+  for (size_t i = 0; i < cache->numSlabs; ++i)
+    yalloc_free(cache->pool, cache->slabs[i]);
+
+  cache->numSlabs = 0;
+  cache->partial = 0;
+  cache->numUsed = 0;
+}
+
+void * yalloc_slab_alloc(YallocSlabCache * cache)
+{
+  if (!cache->partial)
+  { // all slabs are full
+    if (cache->numSlabs == cache->maxSlabs)
+      return NULL;
+
+    Slab * slab = (Slab*)yalloc_alloc(cache->pool, sizeof(Slab) + (size_t)cache->objectSize * cache->objectsPerSlab);
+    if (!slab)
+      return NULL;
+
+    slab->freeHead = NO_OBJECT;
+    slab->numUsed = 0;
+    slab->numTouched = 0;
+    slab->reserved = 0;
+
+    // keep the slabs sorted by address
+    size_t i = upper_bound(cache, slab);
+    memmove(&cache->slabs[i + 1], &cache->slabs[i], (cache->numSlabs - i) * sizeof(void*));
+    cache->slabs[i] = slab;
+    ++cache->numSlabs;
+
+    push_partial(cache, slab);
+  }
+
+  Slab * slab = slabAt(cache, cache->partial);
+  char * p;
+  if (slab->freeHead != NO_OBJECT)
+  { // reuse a freed object
+    p = objectAt(cache, slab, slab->freeHead);
+    memcpy(&slab->freeHead, p, sizeof(uint16_t));
+  }
+  else
+    p = objectAt(cache, slab, slab->numTouched++);
+
+  ++slab->numUsed;
+  ++cache->numUsed;
+
+  if (!hasFree(cache, slab))
+    unlink_partial(cache, slab);
+
+  return p;
+}
+
+void yalloc_slab_free(YallocSlabCache * cache, void * p)
+{
+  if (!p)
+    return;
+
+  size_t i = find_slab(cache, p);
+  Slab * slab = (Slab*)cache->slabs[i];
+  uint16_t index = (uint16_t)(((char*)p - objectAt(cache, slab, 0)) / cache->objectSize);
+  assert(objectAt(cache, slab, index) == p); // p must point to the start of an object
+
+  int wasFull = !hasFree(cache, slab);
+  memcpy(p, &slab->freeHead, sizeof(uint16_t));
+  slab->freeHead = index;
+  --slab->numUsed;
+  --cache->numUsed;
+
+  if (wasFull)
+    push_partial(cache, slab);
+
+  if (!slab->numUsed && (slab->prevPartial || slab->nextPartial))
+  { // the slab is empty and there are other slabs with free objects, so give it back to the pool
+    unlink_partial(cache, slab);
+    memmove(&cache->slabs[i], &cache->slabs[i + 1], (cache->numSlabs - i - 1) * sizeof(void*));
+    --cache->numSlabs;
+    yalloc_free(cache->pool, slab);
+  }
+}
+
+void * yalloc_slab_defrag_address(YallocSlabCache * cache, void * p)
+{
+  if (!p)
+    return NULL;
+
+  void * slab = cache->slabs[find_slab(cache, p)];
+  return (char*)yalloc_defrag_address(cache->pool, slab) + ((char*)p - (char*)slab);
+}
+
+void yalloc_slab_defrag(YallocSlabCache * cache)
+{
+  // Defragmentation keeps the address order of the blocks, so the slab array stays sorted. The list of slabs with
+  // free objects is rebuilt with the new addresses (the headers are written at the old addresses, yalloc_defrag_commit()
+  // moves them together with the objects).
+  Slab * prevSlab = NULL; // last slab with free objects (at its old address)
+  uint16_t prevUnits = 0; // its new address
+  cache->partial = 0;
+  for (size_t i = 0; i < cache->numSlabs; ++i)
+  {
+    Slab * slab = (Slab*)cache->slabs[i];
+    void * newAddr = yalloc_defrag_address(cache->pool, slab);
+    if (hasFree(cache, slab))
+    {
+      slab->prevPartial = prevUnits;
+      slab->nextPartial = 0;
+      if (prevSlab)
+        prevSlab->nextPartial = units(cache, newAddr);
+      else
+        cache->partial = units(cache, newAddr);
+
+      prevSlab = slab;
+      prevUnits = units(cache, newAddr);
+    }
+
+    cache->slabs[i] = newAddr;
+  }
+}
@@ -0,0 +1,118 @@
+/**
+@file
+
+Optional slab layer for many small objects of the same size.
+
+This is only available if build with <tt>yalloc_slab.c</tt>. A slab cache takes
+big blocks (slabs) from a pool with yalloc_alloc() and serves objects of a
+fixed size from them. Objects have no header (a pool allocation of 4 bytes
+needs 8 bytes, a slab object 4 bytes plus its share of the slab overhead) and
+allocation/deallocation do not walk the free list of the pool: Free objects of
+a slab are linked by their index and slabs with free objects are linked with
+each other, so yalloc_slab_alloc() is O(1) and yalloc_slab_free() only needs a
+binary search over the slabs to find the slab of an object.
+
+Slabs take part in defragmentation of the pool as a whole (the objects inside
+a slab keep their position relative to the slab):
+
+ 1. yalloc_defrag_start() for the pool.
+ 2. The application updates its pointers to objects with
+    yalloc_slab_defrag_address() (and its other pointers with
+    yalloc_defrag_address() as usual).
+ 3. yalloc_slab_defrag() for every slab cache of the pool.
+ 4. yalloc_defrag_commit() for the pool.
+*/
+
+#ifndef YALLOC_SLAB_H
+#define YALLOC_SLAB_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+State of a slab cache.
+
+Initialize it with yalloc_slab_init(). The members are not meant to be
+modified by the application.
+*/
+typedef struct
+{
+  void * pool; ///< Pool the slabs are allocated from.
+  void ** slabs; ///< Caller supplied array of the slabs, sorted by address.
+  uint16_t maxSlabs; ///< Capacity of slabs.
+  uint16_t numSlabs; ///< Number of slabs that are currently allocated.
+  uint16_t objectSize; ///< Size of the objects, rounded up to 4.
+  uint16_t objectsPerSlab; ///< Number of objects that fit into a slab.
+  uint16_t partial; ///< First slab with free objects (distance from the pool in 4 byte units, 0 if there is none).
+  uint16_t numUsed; ///< Number of allocated objects in all slabs.
+} YallocSlabCache;
+
+/**
+Initializes a slab cache. No memory is taken from the pool until the first
+object is allocated.
+
+@param cache The cache to initialize.
+@param pool An initialized pool.
+@param objectSize Size of the objects (1 to 65532).
+@param objectsPerSlab Number of objects per slab (1 to 65534). Bigger slabs
+have less overhead but may hold more unused memory.
+@param slabs Array that is used to remember the slabs. Its capacity limits
+the number of slabs. It must not be inside the pool (it is used during
+defragmentation).
+@param maxSlabs Capacity of slabs.
+@return 0 on success, nonzero if a parameter is not supported.
+*/
+int yalloc_slab_init(YallocSlabCache * cache, void * pool, size_t objectSize, size_t objectsPerSlab, void ** slabs, size_t maxSlabs);
+
+/**
+Returns all slabs of a cache to its pool. All objects of the cache become invalid.
+*/
+void yalloc_slab_deinit(YallocSlabCache * cache);
+
+/**
+Allocates an object.
+
+@return The object or \c NULL if all slabs are full and no new slab could be
+allocated (the pool is full or the slab array is exhausted).
+*/
+void * yalloc_slab_alloc(YallocSlabCache * cache);
+
+/**
+Returns an object to its slab.
+
+A slab that becomes empty is returned to the pool, except if it is the only
+slab with free objects (which avoids allocating and freeing slabs over and over
+again when objects are allocated and freed alternately).
+
+@param cache The cache the object was allocated from.
+@param p The object or \c NULL (which is ignored).
+*/
+void yalloc_slab_free(YallocSlabCache * cache, void * p);
+
+/**
+Returns the post-defragmentation-address of an object.
+
+Must be called between yalloc_defrag_start() and yalloc_slab_defrag().
+
+@param cache The cache the object was allocated from.
+@param p The object or \c NULL (which returns \c NULL).
+*/
+void * yalloc_slab_defrag_address(YallocSlabCache * cache, void * p);
+
+/**
+Updates the cache to the post-defragmentation-addresses of its slabs.
+
+Must be called after yalloc_slab_defrag_address() was called for all objects
+and before yalloc_defrag_commit().
+*/
+void yalloc_slab_defrag(YallocSlabCache * cache);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // YALLOC_SLAB_H
@@ -0,0 +1,181 @@
+/**
+@file
+
+Optional C++17 pool with its size and granule fixed at compile time.
+
+This header needs nothing but yalloc.c. yalloc::static_pool<Bytes, Granule>
+holds the memory of a pool of Bytes bytes and initializes the pool in it. Every
+property that the C functions check or compute at runtime is resolved by the
+compiler instead:
+
+ - the storage is a member (no buffer has to be passed around), its size is
+   checked against MAX_POOL_SIZE and rounded to 32 bits by static_assert and
+   constexpr
+ - offset_type is the smallest unsigned type that holds an offset of the pool
+   (see yalloc_ptr_to_off()) and to_offset() and from_offset() compute offsets
+   inline. Offsets count 32bit words (offset_shift) like the C functions,
+   whatever the granule is, so they can be passed to them.
+ - round() is constexpr, so sizes that are known at compile time are rounded
+   up to a multiple of Granule by the compiler. allocate<Size>() and make<T>()
+   pass the rounded size to yalloc_alloc(), which leaves it as it is.
+
+Granule is the step of the sizes that are allocated (a power of two of at
+least 4, the granule of the pool). Bigger granules round sizes coarser, so a
+freed block fits more requests of slightly different sizes. The alignment of
+allocations stays 32 bits (make<T>() refuses types that need more).
+
+@code
+yalloc::static_pool<4096> pool;
+Node * n = pool.make<Node>(1, 2);
+pool.destroy(n);
+@endcode
+
+Like the pool, a static_pool is not thread-safe. Allocations return \c nullptr
+if the pool is full, like yalloc_alloc() (see yalloc_pmr.hpp for adapters that
+throw std::bad_alloc).
+*/
+
+#ifndef YALLOC_STATIC_POOL_HPP
+#define YALLOC_STATIC_POOL_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+#include "yalloc.h"
+
+namespace yalloc
+{
+
+/**
+A pool of Bytes bytes (rounded down to a multiple of 4) whose allocation sizes
+are rounded up to multiples of Granule.
+*/
+template <std::size_t Bytes, std::size_t Granule = 4>
+class static_pool
+{
+  static_assert(Granule >= 4 && (Granule & (Granule - 1)) == 0, "the granule must be a power of two of at least 4");
+  static_assert(Bytes / 4 * 4 <= MAX_POOL_SIZE, "the pool is bigger than MAX_POOL_SIZE");
+  static_assert(Bytes / 4 * 4 >= 16, "the pool is too small for a single allocation");
+
+  static constexpr unsigned log2(std::size_t n) { return n > 1 ? 1 + log2(n / 2) : 0; }
+
+public:
+  /// Size of the pool.
+  static constexpr std::size_t size = Bytes / 4 * 4;
+
+  /// Allocation sizes are multiples of 1 << granule_shift (for callers that count sizes in granules).
+  static constexpr unsigned granule_shift = log2(Granule);
+
+  /// Offsets count 32bit words from the start of the pool.
+  static constexpr unsigned offset_shift = 2;
+
+  /// Smallest type that holds every offset of the pool.
+  using offset_type = std::conditional_t<(size >> offset_shift) <= 0xFF, std::uint8_t, YallocOffset>;
+
+  /// Rounds a size up to a multiple of Granule.
+  static constexpr std::size_t round(std::size_t bytes) noexcept
+  {
+    return (bytes + Granule - 1) & ~(Granule - 1);
+  }
+
+  /**
+  Initializes the pool.
+
+  @param flags Flags of the pool (see yalloc_init_ex()).
+  @throws std::invalid_argument if the flags are not supported (or the
+  metadata of the flags does not fit into the pool).
+  */
+  explicit static_pool(unsigned flags = 0)
+  {
+    if (yalloc_init_ex(storage_, size, flags))
+      throw std::invalid_argument("yalloc::static_pool: unsupported flags");
+  }
+
+  ~static_pool() { yalloc_deinit(storage_); }
+
+  static_pool(static_pool const &) = delete; // allocations are addresses in the storage
+  static_pool & operator=(static_pool const &) = delete;
+
+  /// The pool (for the functions of yalloc.h).
+  void * pool() noexcept { return storage_; }
+
+  /// Allocates memory (see yalloc_alloc()).
+  void * allocate(std::size_t bytes) noexcept
+  {
+    return bytes <= size ? yalloc_alloc(storage_, round(bytes)) : nullptr;
+  }
+
+  /// Allocates memory of a size that is known at compile time.
+  template <std::size_t Size>
+  void * allocate() noexcept
+  {
+    static_assert(Size && round(Size) <= size, "the allocation is empty or does not fit into the pool");
+    constexpr std::size_t rounded = round(Size);
+    return yalloc_alloc(storage_, rounded);
+  }
+
+  /// Frees memory (see yalloc_free()).
+  void deallocate(void * p) noexcept { yalloc_free(storage_, p); }
+
+  /**
+  Allocates and constructs an object.
+
+  @return The object or \c nullptr if the pool is full. If the constructor
+  throws the memory is freed again.
+  */
+  template <class T, class... Args>
+  T * make(Args &&... args)
+  {
+    static_assert(alignof(T) <= 4, "allocations are only 32bit aligned");
+    void * p = allocate<sizeof(T)>();
+    if (!p)
+      return nullptr;
+
+    try
+    {
+      return new (p) T(std::forward<Args>(args)...);
+    }
+    catch (...)
+    {
+      deallocate(p);
+      throw;
+    }
+  }
+
+  /// Destroys and frees an object from make() (\c nullptr is ignored).
+  template <class T>
+  void destroy(T * p) noexcept
+  {
+    if (p)
+    {
+      p->~T();
+      deallocate(p);
+    }
+  }
+
+  /// Turns an address in the pool into an offset (like yalloc_ptr_to_off(), but inline).
+  offset_type to_offset(void const * p) const noexcept
+  {
+    return p ? static_cast<offset_type>((static_cast<unsigned char const*>(p) - storage_) >> offset_shift) : offset_type(YALLOC_NULL_OFFSET);
+  }
+
+  /// Turns an offset back into an address (like yalloc_off_to_ptr(), but inline).
+  void * from_offset(offset_type offset) noexcept
+  {
+    return offset != YALLOC_NULL_OFFSET ? storage_ + (static_cast<std::size_t>(offset) << offset_shift) : nullptr;
+  }
+
+  /// See yalloc_count_free().
+  std::size_t count_free() noexcept { return yalloc_count_free(storage_); }
+
+private:
+  alignas(4) unsigned char storage_[size];
+};
+
+} // namespace yalloc
+
+#endif // YALLOC_STATIC_POOL_HPP
@@ -0,0 +1,149 @@
+#include "yalloc.h"
+#include "yalloc_striped.h"
+
+#include <assert.h>
+
+static atomic_uint numThreads; // threads that allocated from any striped pool so far
+static _Thread_local unsigned threadIndex; // 1 + the index of the calling thread in the order of its first allocation (0 if it did not allocate yet)
+
+static void * stripeAt(YallocStriped * striped, unsigned stripe)
+{
+  return striped->buffer + stripe * striped->stripeSize;
+}
+
+int yalloc_striped_init(YallocStriped * striped, void * buffer, size_t size, unsigned numStripes, unsigned flags)
+{
+  if (!numStripes || numStripes > YALLOC_STRIPED_MAX)
+    return -1;
+
+  size_t stripeSize = size / numStripes / 4 * 4;
+  if (stripeSize > MAX_POOL_SIZE)
+    return -1;
+
+  striped->buffer = (char*)buffer;
+  striped->stripeSize = stripeSize;
+  striped->numStripes = numStripes;
+  for (unsigned i = 0; i < numStripes; ++i)
+  {
+    if (yalloc_init_ex(stripeAt(striped, i), stripeSize, flags))
+    {
+      assert(!i); // all stripes have the same size, so only the first one can fail
+      return -1;
+    }
+
+    pthread_mutex_init(&striped->locks[i], NULL);
+    pthread_cond_init(&striped->committed[i], NULL);
+    atomic_init(&striped->defragging[i], 0);
+    striped->defrags[i] = 0;
+  }
+
+  return 0;
+}
+
+void yalloc_striped_deinit(YallocStriped * striped)
+{
+  for (unsigned i = 0; i < striped->numStripes; ++i)
+  {
+    yalloc_deinit(stripeAt(striped, i));
+    pthread_mutex_destroy(&striped->locks[i]);
+    pthread_cond_destroy(&striped->committed[i]);
+  }
+}
+
+void * yalloc_striped_alloc(YallocStriped * striped, size_t size)
+{
+  if (!threadIndex)
+    threadIndex = atomic_fetch_add(&numThreads, 1) + 1;
+
+  return yalloc_striped_alloc_on(striped, threadIndex - 1, size);
+}
+
+void * yalloc_striped_alloc_on(YallocStriped * striped, unsigned stripe, size_t size)
+{
+  for (unsigned i = 0; i < striped->numStripes; ++i)
+  {
+    unsigned s = (stripe + i) % striped->numStripes;
+    if (atomic_load_explicit(&striped->defragging[s], memory_order_relaxed))
+      continue;
+
+    pthread_mutex_lock(&striped->locks[s]);
+    void * p = NULL;
+    if (!atomic_load_explicit(&striped->defragging[s], memory_order_relaxed)) // it may have started since the check above
+      p = yalloc_alloc(stripeAt(striped, s), size);
+    pthread_mutex_unlock(&striped->locks[s]);
+    if (p)
+      return p;
+  }
+
+  return NULL;
+}
+
+void yalloc_striped_free(YallocStriped * striped, void * p)
+{
+  if (!p)
+    return;
+
+  unsigned s = yalloc_striped_stripe_of(striped, p);
+  pthread_mutex_lock(&striped->locks[s]);
+  while (atomic_load_explicit(&striped->defragging[s], memory_order_relaxed))
+  { // p is the address from before the defragmentation, so it is translated now and freed after the commit (when the block is at its new address)
+    unsigned defrags = striped->defrags[s];
+    p = yalloc_defrag_address(stripeAt(striped, s), p);
+    while (striped->defrags[s] == defrags)
+      pthread_cond_wait(&striped->committed[s], &striped->locks[s]);
+  }
+  yalloc_free(stripeAt(striped, s), p);
+  pthread_mutex_unlock(&striped->locks[s]);
+}
+
+unsigned yalloc_striped_stripe_of(YallocStriped * striped, void * p)
+{
+  assert((char*)p >= striped->buffer && (char*)p < striped->buffer + striped->numStripes * striped->stripeSize); // p must be in one of the stripes
+  return (unsigned)(((char*)p - striped->buffer) / striped->stripeSize);
+}
+
+size_t yalloc_striped_count_free(YallocStriped * striped)
+{
+  size_t bytes = 0;
+  for (unsigned i = 0; i < striped->numStripes; ++i)
+  {
+    pthread_mutex_lock(&striped->locks[i]);
+    while (atomic_load_explicit(&striped->defragging[i], memory_order_relaxed))
+      pthread_cond_wait(&striped->committed[i], &striped->locks[i]);
+    bytes += yalloc_count_free(stripeAt(striped, i));
+    pthread_mutex_unlock(&striped->locks[i]);
+  }
+  return bytes;
+}
+
+void yalloc_striped_defrag_start(YallocStriped * striped, unsigned stripe)
+{
+  assert(stripe < striped->numStripes);
+  pthread_mutex_lock(&striped->locks[stripe]);
+  assert(!atomic_load_explicit(&striped->defragging[stripe], memory_order_relaxed)); // only one defragmentation of a stripe at a time
+  atomic_store_explicit(&striped->defragging[stripe], 1, memory_order_relaxed);
+  yalloc_defrag_start(stripeAt(striped, stripe));
+  pthread_mutex_unlock(&striped->locks[stripe]);
+}
+
+void * yalloc_striped_defrag_address(YallocStriped * striped, unsigned stripe, void * p)
+{
+  if (!p || yalloc_striped_stripe_of(striped, p) != stripe)
+    return p;
+
+  pthread_mutex_lock(&striped->locks[stripe]); // frees translate their addresses meanwhile
+  void * defragP = yalloc_defrag_address(stripeAt(striped, stripe), p);
+  pthread_mutex_unlock(&striped->locks[stripe]);
+  return defragP;
+}
+
+void yalloc_striped_defrag_commit(YallocStriped * striped, unsigned stripe)
+{
+  assert(stripe < striped->numStripes);
+  pthread_mutex_lock(&striped->locks[stripe]);
+  yalloc_defrag_commit(stripeAt(striped, stripe));
+  atomic_store_explicit(&striped->defragging[stripe], 0, memory_order_relaxed);
+  ++striped->defrags[stripe];
+  pthread_cond_broadcast(&striped->committed[stripe]); // the waiting frees
+  pthread_mutex_unlock(&striped->locks[stripe]);
+}
@@ -0,0 +1,135 @@
+/**
+@file
+
+Optional lock-striped pool for buffers that are shared by many threads.
+
+This is only available if build with <tt>yalloc_striped.c</tt> (which needs
+POSIX threads and C11 atomics). A striped pool splits one buffer into stripes
+of equal size. Each stripe is an independent pool with its own lock, so
+threads that allocate from different stripes do not wait for each other (and
+the buffer can be bigger than MAX_POOL_SIZE as long as the stripes are not).
+
+yalloc_striped_alloc() uses the home stripe of the calling thread (threads get
+their home stripes round robin) and falls back to the following stripes when
+it is full. yalloc_striped_alloc_on() takes the stripe from the caller instead
+(e.g. from sched_getcpu()). yalloc_striped_free() finds the stripe of a block by
+its address, so any thread can free any block.
+
+Stripes are defragmented one at a time while the others stay in use:
+
+ 1. yalloc_striped_defrag_start() for a stripe. Allocations skip the stripe
+    until step 3. Frees of its blocks (by any thread, with the address from
+    before the defragmentation) translate the address and wait until step 3,
+    then they free the block at its new address.
+ 2. The application updates its pointers into the stripe with
+    yalloc_striped_defrag_address().
+ 3. yalloc_striped_defrag_commit() for the stripe.
+*/
+
+#ifndef YALLOC_STRIPED_H
+#define YALLOC_STRIPED_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+
+/// Maximum number of stripes of a striped pool.
+#ifndef YALLOC_STRIPED_MAX
+#define YALLOC_STRIPED_MAX 16
+#endif
+
+/**
+State of a striped pool.
+
+Initialize it with yalloc_striped_init(). The members are not meant to be
+modified by the application.
+*/
+typedef struct
+{
+  char * buffer; ///< Start of the first stripe.
+  size_t stripeSize; ///< Size of every stripe (a multiple of 4).
+  unsigned numStripes; ///< Number of stripes.
+  pthread_mutex_t locks[YALLOC_STRIPED_MAX]; ///< Protects the pool of every stripe.
+  pthread_cond_t committed[YALLOC_STRIPED_MAX]; ///< Signaled when the defragmentation of a stripe is committed.
+  atomic_int defragging[YALLOC_STRIPED_MAX]; ///< Nonzero while a stripe is defragmenting (only changes while its lock is held).
+  unsigned defrags[YALLOC_STRIPED_MAX]; ///< Number of committed defragmentations of every stripe.
+} YallocStriped;
+
+/**
+Splits a buffer into stripes and initializes a pool in each of them.
+
+@param striped The striped pool to initialize.
+@param buffer The memory for the stripes (must be 32bit aligned).
+@param size Size of the buffer.
+@param numStripes Number of stripes (1 to YALLOC_STRIPED_MAX).
+@param flags Flags for yalloc_init_ex() of every stripe.
+@return 0 on success, nonzero if the stripes are too big or too small or a
+parameter is not supported.
+*/
+int yalloc_striped_init(YallocStriped * striped, void * buffer, size_t size, unsigned numStripes, unsigned flags);
+
+/**
+Deinitializes the pools of all stripes (see yalloc_deinit()).
+*/
+void yalloc_striped_deinit(YallocStriped * striped);
+
+/**
+Allocates memory from the home stripe of the calling thread or, if it is
+full, from the stripes behind it.
+
+@return See yalloc_alloc().
+*/
+void * yalloc_striped_alloc(YallocStriped * striped, size_t size);
+
+/**
+Allocates memory from a given stripe or, if it is full, from the stripes
+behind it.
+
+@param striped The striped pool.
+@param stripe The preferred stripe (taken modulo the number of stripes).
+@param size Number of bytes.
+@return See yalloc_alloc().
+*/
+void * yalloc_striped_alloc_on(YallocStriped * striped, unsigned stripe, size_t size);
+
+/**
+Frees memory of any stripe.
+
+@param striped The striped pool.
+@param p The memory or \c NULL (which is ignored).
+*/
+void yalloc_striped_free(YallocStriped * striped, void * p);
+
+/**
+Returns the stripe that contains an allocation.
+*/
+unsigned yalloc_striped_stripe_of(YallocStriped * striped, void * p);
+
+/**
+Returns the sum of yalloc_count_free() of all stripes (waits for stripes that
+are defragmenting).
+*/
+size_t yalloc_striped_count_free(YallocStriped * striped);
+
+/**
+Starts the defragmentation of a stripe (see yalloc_defrag_start()).
+
+The other stripes stay usable. Frees into the stripe wait until
+yalloc_striped_defrag_commit() (so the thread that defragments must not free
+into the stripe before it commits).
+*/
+void yalloc_striped_defrag_start(YallocStriped * striped, unsigned stripe);
+
+/**
+Returns the post-defragmentation-address of an allocation (see
+yalloc_defrag_address()). Allocations of other stripes and \c NULL are
+returned unchanged.
+*/
+void * yalloc_striped_defrag_address(YallocStriped * striped, unsigned stripe, void * p);
+
+/**
+Finishes the defragmentation of a stripe (see yalloc_defrag_commit()).
+*/
+void yalloc_striped_defrag_commit(YallocStriped * striped, unsigned stripe);
+
+#endif // YALLOC_STRIPED_H
@@ -0,0 +1,174 @@
+#include "yalloc.h"
+#include "yalloc_trace.h"
+
+#include <string.h>
+
+void yalloc_trace_init_buffer(YallocTrace * trace, YallocTraceRecord * records, size_t capacity, uint32_t (*clock)(void))
+{
+  memset(trace, 0, sizeof(*trace));
+  trace->records = records;
+  trace->capacity = capacity;
+  trace->clock = clock;
+}
+
+void yalloc_trace_init_file(YallocTrace * trace, FILE * file, uint32_t (*clock)(void))
+{
+  memset(trace, 0, sizeof(*trace));
+  trace->file = file;
+  trace->clock = clock;
+}
+
+size_t yalloc_trace_dropped(YallocTrace const * trace)
+{
+  if (trace->file || trace->count <= trace->capacity)
+    return 0;
+
+  return trace->count - trace->capacity;
+}
+
+size_t yalloc_trace_save(YallocTrace const * trace, FILE * file)
+{
+  if (!trace->records || !trace->capacity)
+    return 0;
+
+  size_t n = trace->count < trace->capacity ? trace->count : trace->capacity;
+  size_t first = trace->count - n;
+  size_t written = 0;
+  for (size_t i = first; i < trace->count; ++i)
+  {
+    if (fwrite(&trace->records[i % trace->capacity], sizeof(YallocTraceRecord), 1, file) != 1)
+      break;
+
+    ++written;
+  }
+  return written;
+}
+
+// converts a byte count to 4 byte units, saturating at what fits into a record
+static uint16_t to_units(size_t bytes)
+{
+  size_t units = (bytes + 3) / 4;
+  return units > 0xFFFF ? 0xFFFF : (uint16_t)units;
+}
+
+static uint16_t block_units(void * pool, void * p)
+{
+  return p ? to_units((char*)p - (char*)pool) : 0;
+}
+
+static void record(YallocTrace * trace, uint16_t op, uint16_t size, uint16_t offset, uint16_t result)
+{
+  YallocTraceRecord r;
+  r.time = trace->clock ? trace->clock() : (uint32_t)trace->count;
+  r.op = op;
+  r.size = size;
+  r.offset = offset;
+  r.result = result;
+
+  if (trace->file)
+    fwrite(&r, sizeof(r), 1, trace->file);
+  else if (trace->capacity)
+    trace->records[trace->count % trace->capacity] = r;
+
+  ++trace->count;
+}
+
+int yalloc_traced_init(YallocTrace * trace, void * pool, size_t size)
+{
+  return yalloc_traced_init_ex(trace, pool, size, 0);
+}
+
+int yalloc_traced_init_ex(YallocTrace * trace, void * pool, size_t size, unsigned flags)
+{
+  int ret = yalloc_init_ex(pool, size, flags);
+  size_t units = size / 4; // rounded down like yalloc_init() does, so the replay gets a pool of the same size
+  record(trace, YALLOC_TRACE_INIT, units > 0xFFFF ? 0xFFFF : (uint16_t)units, (uint16_t)flags, ret ? 1 : 0);
+  return ret;
+}
+
+void * yalloc_traced_alloc(YallocTrace * trace, void * pool, size_t size)
+{
+  void * p = yalloc_alloc(pool, size);
+  record(trace, YALLOC_TRACE_ALLOC, to_units(size), block_units(pool, p), 0);
+  return p;
+}
+
+void yalloc_traced_free(YallocTrace * trace, void * pool, void * p)
+{
+  record(trace, YALLOC_TRACE_FREE, 0, block_units(pool, p), 0);
+  yalloc_free(pool, p);
+}
+
+void yalloc_traced_defrag_start(YallocTrace * trace, void * pool)
+{
+  yalloc_defrag_start(pool);
+  record(trace, YALLOC_TRACE_DEFRAG_START, 0, 0, 0);
+}
+
+void yalloc_traced_defrag_commit(YallocTrace * trace, void * pool)
+{
+  yalloc_defrag_commit(pool);
+  record(trace, YALLOC_TRACE_DEFRAG_COMMIT, 0, 0, 0);
+}
+
+size_t yalloc_trace_replay(YallocTraceRecord const * records, size_t n, void * pool, size_t size)
+{
+  if (!n || records[0].op != YALLOC_TRACE_INIT)
+    return 0; // the trace does not start at the creation of the pool (e.g. the ring buffer wrapped around)
+
+  for (size_t i = 0; i < n; ++i)
+  {
+    YallocTraceRecord const * r = &records[i];
+    switch (r->op)
+    {
+    case YALLOC_TRACE_INIT:
+    {
+      size_t poolSize = (size_t)r->size * 4;
+      if (i || poolSize > size)
+        return i;
+
+      if (r->flags & YALLOC_MEMORY_IS_ZERO)
+        memset(pool, 0, poolSize); // the recorded pool promised that
+
+      if ((yalloc_init_ex(pool, poolSize, r->flags) ? 1 : 0) != r->result)
+        return i;
+
+      if (r->result)
+        return i + 1; // nothing to replay when the recorded initialization failed
+
+      break;
+    }
+
+    case YALLOC_TRACE_ALLOC:
+    {
+      // the recorded size was rounded up, which makes no difference to the allocator
+      void * p = yalloc_alloc(pool, (size_t)r->size * 4);
+      if (block_units(pool, p) != r->offset)
+      { // the replay diverged
+        if (p)
+          yalloc_free(pool, p);
+
+        return i;
+      }
+      break;
+    }
+
+    case YALLOC_TRACE_FREE:
+      yalloc_free(pool, r->offset ? (char*)pool + (size_t)r->offset * 4 : NULL);
+      break;
+
+    case YALLOC_TRACE_DEFRAG_START:
+      yalloc_defrag_start(pool);
+      break;
+
+    case YALLOC_TRACE_DEFRAG_COMMIT:
+      yalloc_defrag_commit(pool);
+      break;
+
+    default:
+      return i;
+    }
+  }
+
+  return n;
+}
@@ -0,0 +1,158 @@
+/**
+@file
+
+Optional recording of pool operations for offline replay.
+
+This is only available if build with <tt>yalloc_trace.c</tt>. The functions
+in here are thin wrappers around the normal yalloc API that append a record
+for every call to a trace. A complete trace (starting with the initialization
+of the pool) can be replayed with yalloc_trace_replay() to reconstruct the
+exact state of the pool at any point, which is useful to reproduce
+fragmentation problems that where observed in the field.
+*/
+
+#ifndef YALLOC_TRACE_H
+#define YALLOC_TRACE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define YALLOC_TRACE_INIT 1
+#define YALLOC_TRACE_ALLOC 2
+#define YALLOC_TRACE_FREE 3
+#define YALLOC_TRACE_DEFRAG_START 4
+#define YALLOC_TRACE_DEFRAG_COMMIT 5
+
+/**
+A single recorded operation.
+
+Records are written in native byte order. Sizes and offsets are stored in
+units of 4 bytes (the alignment of yalloc), so 16 bits are enough to describe
+every block of a pool.
+*/
+typedef struct
+{
+  uint32_t time; ///< Value of the clock of the trace when the operation was recorded.
+  uint16_t op; ///< One of the YALLOC_TRACE_* values.
+  uint16_t size; ///< Requested size rounded up to 4 (alloc) or size of the pool rounded down to 4 (init), in 4 byte units.
+  union
+  {
+    uint16_t offset; ///< Distance of the block from the pool start in 4 byte units (alloc/free), 0 stands for \c NULL.
+    uint16_t flags; ///< Flags of yalloc_init_ex() (init, 0 for yalloc_init()).
+  };
+  uint16_t result; ///< Return value of yalloc_init_ex() for init-records, 0 otherwise.
+} YallocTraceRecord;
+
+/**
+Destination of recorded operations.
+
+Initialize it with yalloc_trace_init_buffer() or yalloc_trace_init_file(). The
+members are not meant to be modified by the application.
+*/
+typedef struct
+{
+  YallocTraceRecord * records; ///< Ring buffer (NULL when writing to a file).
+  size_t capacity; ///< Number of records that fit into the ring buffer.
+  size_t count; ///< Total number of records that where written so far.
+  FILE * file; ///< File the records are appended to (NULL when writing to a ring buffer).
+  uint32_t (*clock)(void); ///< Timestamp source, a sequence number is recorded if this is NULL.
+} YallocTrace;
+
+/**
+Initializes a trace that records to a caller supplied ring buffer.
+
+When the ring buffer is full the oldest records are overwritten. Such a trace
+can not be replayed anymore (see yalloc_trace_dropped()), so the buffer should
+be saved with yalloc_trace_save() before it wraps around.
+
+@param trace The trace to initialize.
+@param records Storage for the records.
+@param capacity Number of records that fit into @p records.
+@param clock Timestamp source or \c NULL to record a sequence number.
+*/
+void yalloc_trace_init_buffer(YallocTrace * trace, YallocTraceRecord * records, size_t capacity, uint32_t (*clock)(void));
+
+/**
+Initializes a trace that appends records to a file.
+
+@param trace The trace to initialize.
+@param file A file opened for binary writing. It is not closed by the trace.
+@param clock Timestamp source or \c NULL to record a sequence number.
+*/
+void yalloc_trace_init_file(YallocTrace * trace, FILE * file, uint32_t (*clock)(void));
+
+/**
+Tells how many records where overwritten in the ring buffer of a trace.
+
+@return Number of lost records, nonzero means the trace can not be replayed.
+*/
+size_t yalloc_trace_dropped(YallocTrace const * trace);
+
+/**
+Writes the content of the ring buffer of a trace to a file, oldest record first.
+
+@return Number of records written.
+*/
+size_t yalloc_trace_save(YallocTrace const * trace, FILE * file);
+
+/**
+Like yalloc_init() but records the operation in a trace.
+*/
+int yalloc_traced_init(YallocTrace * trace, void * pool, size_t size);
+
+/**
+Like yalloc_init_ex() but records the operation in a trace.
+
+The flags are part of the record, so the replay creates the same kind of pool.
+*/
+int yalloc_traced_init_ex(YallocTrace * trace, void * pool, size_t size, unsigned flags);
+
+/**
+Like yalloc_alloc() but records the operation in a trace.
+*/
+void * yalloc_traced_alloc(YallocTrace * trace, void * pool, size_t size);
+
+/**
+Like yalloc_free() but records the operation in a trace.
+*/
+void yalloc_traced_free(YallocTrace * trace, void * pool, void * p);
+
+/**
+Like yalloc_defrag_start() but records the operation in a trace.
+*/
+void yalloc_traced_defrag_start(YallocTrace * trace, void * pool);
+
+/**
+Like yalloc_defrag_commit() but records the operation in a trace.
+*/
+void yalloc_traced_defrag_commit(YallocTrace * trace, void * pool);
+
+/**
+Replays recorded operations into a pool.
+
+The first record must be an init-record, the pool is created with the flags
+it recorded. Replaying stops at the first record
+whose outcome differs from the recorded one (which means the trace does not
+belong to this version of yalloc or is damaged). The pool is left in the state
+after the last successfully replayed record and can be inspected with the
+normal API (or yalloc_dump()).
+
+@param records The recorded operations.
+@param n Number of records to replay.
+@param pool Buffer to initialize the pool in.
+@param size Size of @p pool, must be at least the size of the recorded pool.
+@return Number of records that where replayed successfully (so \c n means
+everything went fine).
+*/
+size_t yalloc_trace_replay(YallocTraceRecord const * records, size_t n, void * pool, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // YALLOC_TRACE_H